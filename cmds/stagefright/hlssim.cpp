@@ -0,0 +1,369 @@
+/*
+ * Copyright (C) 2015 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+// Replays a recorded bandwidth trace against a local HLS variant playlist and
+// reports how an adaptation policy of LiveSession would have fared: startup
+// delay, stalls and variant switches. Segments are assumed to be as large as
+// their variant's declared bandwidth implies; the buffer model follows
+// PlaylistFetcher (download while less than 3 target durations, at most 10
+// seconds, are buffered) and LiveSession (periodic checks, plus an immediate
+// switch down when less than a third of a target duration is buffered).
+
+//#define LOG_NDEBUG 0
+#define LOG_TAG "hlssim"
+#include <inttypes.h>
+#include <utils/Log.h>
+
+#include "httplive/AdaptationPolicy.h"
+#include "httplive/M3UParser.h"
+
+#include <media/stagefright/foundation/ABuffer.h>
+#include <media/stagefright/foundation/ADebug.h>
+#include <media/stagefright/foundation/AMessage.h>
+#include <media/stagefright/foundation/AString.h>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+using namespace android;
+
+static void usage(const char *me) {
+    fprintf(stderr, "usage: %s [-a <policy>] [-l <loops>] [-v]"
+                    " <variant playlist> <bandwidth trace>\n", me);
+    fprintf(stderr, "       -h help\n");
+    fprintf(stderr, "       -a adaptation policy, bola (default) or throughput\n");
+    fprintf(stderr, "       -l number of times to play the playlist, default 1\n");
+    fprintf(stderr, "       -v print every segment download\n");
+    fprintf(stderr, "       The playlist is a local path or a file:// URL; the\n"
+                    "       trace has one \"<duration ms> <kbps>\" pair per line\n"
+                    "       and is replayed in a loop.\n");
+
+    exit(1);
+}
+
+static sp<M3UParser> loadPlaylist(const AString &url) {
+    const char *path = url.c_str();
+    if (!strncasecmp(path, "file://", 7)) {
+        path += 7;
+    }
+
+    FILE *file = fopen(path, "rb");
+    if (file == NULL) {
+        fprintf(stderr, "unable to open %s\n", path);
+        return NULL;
+    }
+
+    fseek(file, 0, SEEK_END);
+    long size = ftell(file);
+    fseek(file, 0, SEEK_SET);
+
+    sp<ABuffer> buffer = new ABuffer(size > 0 ? size : 0);
+    size_t n = fread(buffer->data(), 1, buffer->size(), file);
+    fclose(file);
+
+    sp<M3UParser> playlist = new M3UParser(url.c_str(), buffer->data(), n);
+    if (playlist->initCheck() != OK) {
+        fprintf(stderr, "unable to parse %s\n", url.c_str());
+        return NULL;
+    }
+    return playlist;
+}
+
+struct Trace {
+    Vector<int64_t> mDurationsUs;
+    Vector<int32_t> mBandwidthsBps;
+    int64_t mTotalDurationUs;
+
+    Trace() : mTotalDurationUs(0) {}
+
+    bool load(const char *path);
+
+    // Time needed to download numBytes starting at nowUs.
+    int64_t downloadTimeUs(int64_t nowUs, double numBytes) const;
+};
+
+bool Trace::load(const char *path) {
+    FILE *file = fopen(path, "r");
+    if (file == NULL) {
+        fprintf(stderr, "unable to open %s\n", path);
+        return false;
+    }
+
+    char line[256];
+    while (fgets(line, sizeof(line), file) != NULL) {
+        long long durationMs;
+        double kbps;
+        if (line[0] == '#' || sscanf(line, "%lld %lf", &durationMs, &kbps) != 2) {
+            continue;
+        }
+        if (durationMs <= 0 || kbps <= 0) {
+            continue;
+        }
+        mDurationsUs.push(durationMs * 1000ll);
+        mBandwidthsBps.push((int32_t)(kbps * 1000));
+        mTotalDurationUs += durationMs * 1000ll;
+    }
+    fclose(file);
+
+    if (mDurationsUs.isEmpty()) {
+        fprintf(stderr, "no samples in %s\n", path);
+        return false;
+    }
+    return true;
+}
+
+int64_t Trace::downloadTimeUs(int64_t nowUs, double numBytes) const {
+    // locate nowUs within the looped trace
+    int64_t offsetUs = nowUs % mTotalDurationUs;
+    size_t i = 0;
+    while (offsetUs >= mDurationsUs.itemAt(i)) {
+        offsetUs -= mDurationsUs.itemAt(i);
+        i = (i + 1) % mDurationsUs.size();
+    }
+
+    double bitsLeft = numBytes * 8;
+    int64_t timeUs = 0;
+    for (;;) {
+        int64_t remainingUs = mDurationsUs.itemAt(i) - offsetUs;
+        double bits = mBandwidthsBps.itemAt(i) * (remainingUs / 1E6);
+        if (bits >= bitsLeft) {
+            return timeUs + (int64_t)(bitsLeft * 1E6 / mBandwidthsBps.itemAt(i));
+        }
+        bitsLeft -= bits;
+        timeUs += remainingUs;
+        offsetUs = 0;
+        i = (i + 1) % mDurationsUs.size();
+    }
+}
+
+int main(int argc, char **argv) {
+    const char *me = argv[0];
+
+    AString policyName = "bola";
+    int loops = 1;
+    bool verbose = false;
+
+    int res;
+    while ((res = getopt(argc, argv, "h?a:l:v")) >= 0) {
+        switch (res) {
+            case 'a':
+                policyName = optarg;
+                break;
+
+            case 'l':
+                loops = atoi(optarg);
+                break;
+
+            case 'v':
+                verbose = true;
+                break;
+
+            case '?':
+            case 'h':
+            default:
+                usage(me);
+        }
+    }
+
+    argc -= optind;
+    argv += optind;
+
+    if (argc != 2 || loops <= 0) {
+        usage(me);
+    }
+
+    sp<AdaptationPolicy> policy;
+    if (policyName == "bola") {
+        policy = new BolaPolicy;
+    } else if (policyName == "throughput") {
+        policy = new ThroughputPolicy;
+    } else {
+        usage(me);
+    }
+
+    AString masterURL = argv[0];
+    if (strncasecmp(masterURL.c_str(), "file://", 7)) {
+        char *path = realpath(masterURL.c_str(), NULL);
+        if (path == NULL) {
+            fprintf(stderr, "unable to open %s\n", masterURL.c_str());
+            return 1;
+        }
+        masterURL = "file://";
+        masterURL.append(path);
+        free(path);
+    }
+
+    Trace trace;
+    if (!trace.load(argv[1])) {
+        return 1;
+    }
+
+    sp<M3UParser> master = loadPlaylist(masterURL);
+    if (master == NULL) {
+        return 1;
+    }
+    if (!master->isVariantPlaylist()) {
+        fprintf(stderr, "%s is not a variant playlist\n", masterURL.c_str());
+        return 1;
+    }
+
+    // Variants in increasing bandwidth order, as LiveSession keeps them, and
+    // the one listed first to start with.
+    Vector<int32_t> bandwidthsBps;
+    AString mediaURL;
+    int32_t initialBandwidthBps = -1;
+    for (size_t i = 0; i < master->size(); ++i) {
+        AString uri;
+        sp<AMessage> meta;
+        int32_t bandwidthBps;
+        if (!master->itemAt(i, &uri, &meta)
+                || !meta->findInt32("bandwidth", &bandwidthBps)) {
+            continue;
+        }
+        if (initialBandwidthBps < 0) {
+            initialBandwidthBps = bandwidthBps;
+            mediaURL = uri;
+        }
+
+        size_t j = 0;
+        while (j < bandwidthsBps.size() && bandwidthsBps.itemAt(j) < bandwidthBps) {
+            ++j;
+        }
+        bandwidthsBps.insertAt(bandwidthBps, j);
+    }
+    if (bandwidthsBps.isEmpty()) {
+        fprintf(stderr, "no variants in %s\n", masterURL.c_str());
+        return 1;
+    }
+    policy->setVariants(bandwidthsBps);
+
+    ssize_t curIndex = 0;
+    while (bandwidthsBps.itemAt(curIndex) != initialBandwidthBps) {
+        ++curIndex;
+    }
+
+    // Segment durations are taken from the first variant; all variants are
+    // assumed to be segmented alike.
+    sp<M3UParser> media = loadPlaylist(mediaURL);
+    if (media == NULL) {
+        return 1;
+    }
+
+    int32_t targetDurationSecs = 10;
+    media->meta()->findInt32("target-duration", &targetDurationSecs);
+    const int64_t targetDurationUs = targetDurationSecs * 1000000ll;
+    int64_t maxBufferUs = 3 * targetDurationUs;
+    if (maxBufferUs > 10000000ll) {
+        maxBufferUs = 10000000ll;
+    }
+
+    sp<BandwidthEstimator> estimator = new BandwidthEstimator;
+
+    int64_t nowUs = 0;
+    int64_t bufferedUs = 0;
+    int64_t startupUs = -1;
+    int64_t stallUs = 0;
+    size_t numStalls = 0;
+    size_t numUp = 0, numDown = 0;
+    size_t numSegments = 0;
+    double bitsPlayed = 0;
+    int64_t durationPlayedUs = 0;
+    int64_t nextCheckUs = policy->checkIntervalUs();
+
+    for (int loop = 0; loop < loops; ++loop) {
+        for (size_t i = 0; i < media->size(); ++i) {
+            AString uri;
+            sp<AMessage> meta;
+            int64_t durationUs;
+            if (!media->itemAt(i, &uri, &meta)
+                    || !meta->findInt64("durationUs", &durationUs)) {
+                continue;
+            }
+
+            bool switchDown = startupUs >= 0 && bufferedUs < targetDurationUs / 3;
+            if (nowUs >= nextCheckUs || switchDown) {
+                AdaptationPolicy::Status status;
+                if (!estimator->estimateBandwidth(&status.mBandwidthBps)) {
+                    status.mBandwidthBps = -1;
+                }
+                status.mBufferedDurationUs = bufferedUs;
+                status.mCurIndex = curIndex;
+
+                ssize_t index = policy->pickVariant(status);
+                if (switchDown && index >= curIndex && curIndex > 0) {
+                    index = curIndex - 1;
+                }
+                if (index > curIndex) {
+                    ++numUp;
+                } else if (index < curIndex) {
+                    ++numDown;
+                }
+                curIndex = index;
+                nextCheckUs = nowUs + policy->checkIntervalUs();
+            }
+
+            int32_t bandwidthBps = bandwidthsBps.itemAt(curIndex);
+            double numBytes = bandwidthBps / 8.0 * (durationUs / 1E6);
+            int64_t downloadUs = trace.downloadTimeUs(nowUs, numBytes);
+            estimator->addMeasurement((size_t)numBytes, nowUs, nowUs + downloadUs);
+
+            if (startupUs >= 0) {
+                if (bufferedUs >= downloadUs) {
+                    bufferedUs -= downloadUs;
+                } else {
+                    stallUs += downloadUs - bufferedUs;
+                    ++numStalls;
+                    bufferedUs = 0;
+                }
+            }
+            nowUs += downloadUs;
+            bufferedUs += durationUs;
+
+            bitsPlayed += numBytes * 8;
+            durationPlayedUs += durationUs;
+            ++numSegments;
+
+            if (verbose) {
+                printf("%8.2f s  segment %3zu  variant %zd (%d kbps)  "
+                        "download %.2f s  buffered %.2f s\n",
+                        nowUs / 1E6, i, curIndex, bandwidthBps / 1000,
+                        downloadUs / 1E6, bufferedUs / 1E6);
+            }
+
+            if (startupUs < 0 && bufferedUs > targetDurationUs) {
+                startupUs = nowUs;
+            }
+
+            if (startupUs >= 0 && bufferedUs > maxBufferUs) {
+                // the fetcher waits for the buffer to drain
+                nowUs += bufferedUs - maxBufferUs;
+                bufferedUs = maxBufferUs;
+            }
+        }
+    }
+
+    printf("policy %s, %zu variants, %zu segments\n",
+            policy->name(), bandwidthsBps.size(), numSegments);
+    printf("startup %.2f s, %zu stalls for %.2f s\n",
+            startupUs / 1E6, numStalls, stallUs / 1E6);
+    printf("%zu switches up, %zu switches down, average %.0f kbps\n",
+            numUp, numDown,
+            durationPlayedUs > 0 ? bitsPlayed / (durationPlayedUs / 1E6) / 1000 : 0.0);
+
+    return 0;
+}
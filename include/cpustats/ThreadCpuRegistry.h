@@ -0,0 +1,59 @@
+/*
+ * Copyright (C) 2015 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef _THREAD_CPU_REGISTRY_H
+#define _THREAD_CPU_REGISTRY_H
+
+#include <sys/types.h>
+
+namespace android {
+
+// Process-wide registry attributing threads to subsystems, and sampler of their CPU usage.
+//
+// Media threads call registerThread() once from the thread itself, typically in readyToRun().
+// dump() samples every thread of the process from /proc/self/task, so threads that did not
+// register are still accounted for, under their name only. For each thread it reports, since the
+// previous dump, the CPU time, the voluntary and involuntary context switches, and the time spent
+// runnable but waiting for a CPU with its average per scheduling (lat_us), followed by totals per
+// subsystem.
+//
+// Unlike ThreadCpuUsage, this is in a shared library (libcpustats_registry) so that all libraries
+// of a process share one registry. Threads should unregister before exiting; entries of threads
+// that have exited without doing so are dropped at the next dump, or when the registry is full.
+// A thread id reused before then inherits the stale subsystem.
+
+class ThreadCpuRegistry
+{
+public:
+    // Attributes the calling thread to 'subsystem', e.g. "audioflinger" or "stagefright".
+    // The string is copied and truncated to kMaxSubsystemLength.
+    static void registerThread(const char *subsystem);
+
+    // Removes the calling thread, before it exits.
+    static void unregisterThread();
+
+    // Samples all threads of the process and writes the report to 'fd'.
+    static void dump(int fd, int indent = 0);
+
+    static const size_t kMaxSubsystemLength = 15;
+
+private:
+    ThreadCpuRegistry();    // not instantiable
+};
+
+}   // namespace android
+
+#endif //  _THREAD_CPU_REGISTRY_H
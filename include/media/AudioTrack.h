@@ -305,6 +305,22 @@ public:
             void        stop();
             bool        stopped() const;
 
+    /* Start a track so that its first frame is presented at the given CLOCK_MONOTONIC time.
+     * Silence is played until then, or if the time has already passed, the frames that should
+     * have been presented are skipped. The track must be stopped, flushed or paused.
+     * Only supported by normal mixed PCM tracks: returns INVALID_OPERATION for fast, timed,
+     * direct and offloaded tracks. The schedule does not survive a track restore.
+     */
+            status_t    startAt(int64_t presentationTimeNs);
+
+    /* Cut an active track at the given CLOCK_MONOTONIC presentation time; the frames written
+     * after that point are discarded and the track is stopped by the server, which the client
+     * observes as stopped() returning true and as write() no longer blocking. The callback
+     * thread is paused. A time of 0 cancels a pending stop time.
+     * Same restrictions as startAt().
+     */
+            status_t    stopAt(int64_t presentationTimeNs);
+
     /* Flush a stopped or paused track. All previously buffered data is discarded immediately.
      * This has the effect of draining the buffers without mixing or output.
      * Flush is intended for streaming mode, for example before switching to non-contiguous content.
@@ -344,6 +360,13 @@ public:
     /* Return current source sample rate in Hz */
             uint32_t    getSampleRate() const;
 
+    /* Group calls to setVolume(), setAuxEffectSendLevel() and setSampleRate() so that AudioFlinger
+     * applies them together at the start of one mix period, without any binder call.
+     * Calls may be nested; the changes are published by the outermost endParameterBatch().
+     */
+            void        beginParameterBatch();
+            void        endParameterBatch();
+
     /* Enables looping and sets the start and end points of looping.
      * Only supported for static buffer mode.
      *
@@ -670,6 +693,9 @@ protected:
             // increment mPosition by the delta of mServer, and return new value of mPosition
             uint32_t updateAndGetPosition_l();
 
+            // if the server completed a scheduled stop, move to STATE_STOPPED and return true
+            bool     checkScheduledStop_l();
+
     // Next 4 fields may be changed if IAudioTrack is re-created, but always != 0
     sp<IAudioTrack>         mAudioTrack;
     sp<IMemory>             mCblkMemory;
@@ -680,6 +706,7 @@ protected:
 
     float                   mVolume[2];
     float                   mSendLevel;
+    int                     mParameterBatchDepth;   // nesting of beginParameterBatch()
     mutable uint32_t        mSampleRate;            // mutable because getSampleRate() can update it.
     size_t                  mFrameCount;            // corresponds to current IAudioTrack, value is
                                                     // reported back by AudioFlinger to the client
@@ -0,0 +1,61 @@
+/*
+ * Copyright (C) 2015 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef ANDROID_EFFECTVISUALIZERAPI_H_
+#define ANDROID_EFFECTVISUALIZERAPI_H_
+
+#include <audio_effects/effect_visualizer.h>
+
+// Extensions to the visualizer effect interface declared in <audio_effects/effect_visualizer.h>
+// that are implemented by the platform visualizer (libvisualizer). Effect implementations that do
+// not know about them reject the commands and parameters with -EINVAL, so clients must be ready
+// to fall back to the basic 8-bit waveform capture.
+
+#if __cplusplus
+extern "C" {
+#endif
+
+// largest capture size accepted by the platform visualizer. Sizes above
+// VISUALIZER_CAPTURE_SIZE_MAX are only valid for the platform implementation.
+#define VISUALIZER_CAPTURE_SIZE_MAX_EXT 8192
+
+enum {
+    // Returns the FFT of the current capture window, computed once inside the effect on float
+    // samples and shared by all clients polling the same window. The reply has the capture size
+    // and uses the same 8-bit signed layout as Visualizer::getFft(): real and imaginary parts of
+    // bins 0 to N/2 - 1 interleaved, except that the imaginary part of bin 0 is replaced by the
+    // real part of the Nyquist bin.
+    VISUALIZER_CMD_CAPTURE_FFT = VISUALIZER_CMD_MEASURE + 1,
+};
+
+enum {
+    // window applied to the capture before computing the FFT (see visualizer_fft_window_e)
+    VISUALIZER_PARAM_FFT_WINDOW = VISUALIZER_PARAM_MEASUREMENT_MODE + 1,
+};
+
+typedef enum {
+    VISUALIZER_FFT_WINDOW_RECTANGULAR = 0,   // no windowing, matches the legacy FFT
+    VISUALIZER_FFT_WINDOW_HANN = 1,
+    VISUALIZER_FFT_WINDOW_HAMMING = 2,
+    VISUALIZER_FFT_WINDOW_BLACKMAN = 3,
+    VISUALIZER_FFT_WINDOW_CNT,
+} visualizer_fft_window_e;
+
+#if __cplusplus
+}  // extern "C"
+#endif
+
+#endif /*ANDROID_EFFECTVISUALIZERAPI_H_*/
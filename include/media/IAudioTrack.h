@@ -93,6 +93,14 @@ public:
 
     /* Signal the playback thread for a change in control block */
     virtual void        signal() = 0;
+
+    /* Schedule the presentation time of the first frame played after the next start(), or of
+     * the first frame not played before stopping. Times are CLOCK_MONOTONIC nanoseconds in the
+     * time base of getTimestamp(); 0 cancels. Return INVALID_OPERATION for fast, direct,
+     * offloaded and timed tracks.
+     */
+    virtual status_t    setStartTime(int64_t presentationTimeNs) = 0;
+    virtual status_t    setStopTime(int64_t presentationTimeNs) = 0;
 };
 
 // ----------------------------------------------------------------------------
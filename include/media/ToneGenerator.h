@@ -281,6 +281,9 @@ private:
     tone_type getToneForRegion(tone_type toneType);
 
     // WaveGenerator generates a single sine wave
+    // The wave is produced by blocks of kLanes samples: each lane holds the phasor of one sample of
+    // the block and all lanes advance by the same rotation of kLanes sample periods, which lets the
+    // lanes be computed in parallel.
     class WaveGenerator {
     public:
         enum gen_command {
@@ -293,22 +296,26 @@ private:
                 float volume);
         ~WaveGenerator();
 
-        void getSamples(short *outBuffer, unsigned int count,
+        void getSamples(float *outBuffer, unsigned int count,
                 unsigned int command);
 
     private:
-        static const short GEN_AMP = 32000;  // amplitude of generator
-        static const short S_Q14 = 14;  // shift for Q14
-        static const short S_Q15 = 15;  // shift for Q15
-
-        short mA1_Q14;  // Q14 coefficient
-        // delay line of full amplitude generator
-        short mS1, mS2;  // delay line S2 oldest
-        short mS2_0;  // saved value for reinitialisation
-        short mAmplitude_Q15;  // Q15 amplitude
+        static const unsigned int kLanes = 4;
+        static const float kMaxAmplitude;  // margin for amplitude fluctuation
+
+        float mRe[kLanes];  // phasors of the next kLanes samples, the sine is the imaginary part
+        float mIm[kLanes];
+        float mRe0[kLanes];  // phasors of the first kLanes samples, for reinitialisation
+        float mIm0[kLanes];
+        float mRotRe;  // rotation by kLanes sample periods
+        float mRotIm;
+        float mAmplitude;
     };
 
     KeyedVector<unsigned short, WaveGenerator *> mWaveGens;  // list of active wave generators.
+    // wave generators of each segment of the active tone descriptor, NULL terminated. Built by
+    // prepareWave() so that audioCallback() does not look up frequencies.
+    WaveGenerator *mSegmentWaveGens[TONEGEN_MAX_SEGMENTS+1][TONEGEN_MAX_WAVES+1];
 };
 
 }
@@ -18,7 +18,7 @@
 #define ANDROID_MEDIA_VISUALIZER_H
 
 #include <media/AudioEffect.h>
-#include <audio_effects/effect_visualizer.h>
+#include <media/EffectVisualizerApi.h>
 #include <utils/Thread.h>
 
 /**
@@ -39,7 +39,12 @@
  * getCaptureSize() and setCaptureSize() methods. Note that the size of the FFT
  * is half of the specified capture size but both sides of the spectrum are returned yielding in a
  * number of bytes equal to the capture size. The capture size must be a power of 2 in the range
- * returned by getMinCaptureSize() and getMaxCaptureSize().
+ * returned by getMinCaptureSize() and getMaxCaptureSize(). Capture sizes above
+ * VISUALIZER_CAPTURE_SIZE_MAX are only supported by the platform visualizer implementation, and
+ * their FFT only by the effect: getFft() returns INVALID_OPERATION when the effect cannot
+ * compute it, e.g. for a client not controlling the effect.
+ * When the effect implementation supports it, the FFT is computed inside the effect on float
+ * samples, with the window selected by setFftWindow(), and shared by all clients.
  * In addition to the polling capture mode, a callback mode is also available by installing a
  * callback function by use of the setCaptureCallBack() method. The rate at which the callback
  * is called as well as the type of data returned is specified.
@@ -75,7 +80,7 @@ public:
     virtual status_t    setEnabled(bool enabled);
 
     // maximum capture size in samples
-    static uint32_t getMaxCaptureSize() { return VISUALIZER_CAPTURE_SIZE_MAX; }
+    static uint32_t getMaxCaptureSize() { return VISUALIZER_CAPTURE_SIZE_MAX_EXT; }
     // minimum capture size in samples
     static uint32_t getMinCaptureSize() { return VISUALIZER_CAPTURE_SIZE_MIN; }
     // maximum capture rate in millihertz
@@ -97,7 +102,7 @@ public:
     status_t setCaptureCallBack(capture_cbk_t cbk, void* user, uint32_t flags, uint32_t rate);
 
     // set the capture size capture size must be a power of two in the range
-    // [VISUALIZER_CAPTURE_SIZE_MAX. VISUALIZER_CAPTURE_SIZE_MIN]
+    // [VISUALIZER_CAPTURE_SIZE_MIN, VISUALIZER_CAPTURE_SIZE_MAX_EXT]
     // must be called when the visualizer is not enabled
     status_t setCaptureSize(uint32_t size);
     uint32_t getCaptureSize() { return mCaptureSize; }
@@ -114,6 +119,11 @@ public:
     status_t setScalingMode(uint32_t mode);
     uint32_t getScalingMode() { return mScalingMode; }
 
+    // set the window applied before computing the FFT, one of visualizer_fft_window_e.
+    // Returns INVALID_OPERATION if the effect implementation does not window its FFT.
+    status_t setFftWindow(uint32_t window);
+    uint32_t getFftWindow() { return mFftWindow; }
+
     // set which measurements are done on the audio buffers processed by the effect.
     // valid measurements (mask): MEASUREMENT_MODE_PEAK_RMS
     status_t setMeasurementMode(uint32_t mode);
@@ -137,7 +147,7 @@ protected:
 
 private:
 
-    static const uint32_t CAPTURE_RATE_MAX = 20000;
+    static const uint32_t CAPTURE_RATE_MAX = 60000;
     static const uint32_t CAPTURE_RATE_DEF = 10000;
     static const uint32_t CAPTURE_SIZE_DEF = VISUALIZER_CAPTURE_SIZE_MAX;
 
@@ -156,6 +166,8 @@ private:
     };
 
     status_t doFft(uint8_t *fft, uint8_t *waveform);
+    // get the FFT computed by the effect, returns INVALID_OPERATION if not supported
+    status_t getEffectFft(uint8_t *fft);
     void periodicCapture();
     uint32_t initCaptureSize();
 
@@ -165,6 +177,8 @@ private:
     uint32_t mSampleRate;
     uint32_t mScalingMode;
     uint32_t mMeasurementMode;
+    uint32_t mFftWindow;
+    bool mEffectFftSupported;   // false once the effect rejected VISUALIZER_CMD_CAPTURE_FFT
     capture_cbk_t mCaptureCallBack;
     void *mCaptureCbkUser;
     sp<CaptureThread> mCaptureThread;
@@ -162,7 +162,11 @@ enum media_parameter_keys {
     KEY_PARAMETER_PLAYBACK_RATE_PERMILLE = 1300,                // set only
 
     // Set a Parcel containing the value of a parcelled Java AudioAttribute instance
-    KEY_PARAMETER_AUDIO_ATTRIBUTES = 1400                       // set only
+    KEY_PARAMETER_AUDIO_ATTRIBUTES = 1400,                      // set only
+
+    // Set a Parcel containing a String16 mime type, to allocate a decoder for it
+    // ahead of prepareAsync, if the player pools its decoders.
+    KEY_PARAMETER_PREWARM_DECODER = 1500                        // set only
 };
 
 // Keep INVOKE_ID_* in sync with MediaPlayer.java.
@@ -0,0 +1,90 @@
+/*
+ * Copyright (C) 2015 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef ANDROID_AUDIO_MULTI_PIPE_H
+#define ANDROID_AUDIO_MULTI_PIPE_H
+
+#include "NBAIO.h"
+
+namespace android {
+
+// MultiPipe is similar to Pipe except:
+//  - write() cannot overrun the flow-controlled readers; instead it returns a short actual count if
+//    the slowest of them has not made enough room.  write() never blocks.
+//  - each reader chooses at enrollment whether it is flow-controlled or lossy.  A lossy reader
+//    is ignored by the writer, and loses data on overrun like a PipeReader.
+//  - the number of readers enrolled at the same time is limited to kMaxReaders.
+// With no flow-controlled reader enrolled, write() accepts and discards all frames as a Pipe would.
+// It is safe for only a single writer thread, and each MultiPipeReader for only a single thread,
+// but readers can be enrolled and removed by any thread without a lock.
+class MultiPipe : public NBAIO_Sink {
+
+    friend class MultiPipeReader;
+
+public:
+    static const size_t kMaxReaders = 4;
+
+    // maxFrames will be rounded up to a power of 2, and all slots are available. Must be >= 2.
+    MultiPipe(size_t maxFrames, const NBAIO_Format& format);
+    virtual ~MultiPipe();
+
+    // NBAIO_Port interface
+
+    //virtual ssize_t negotiate(const NBAIO_Format offers[], size_t numOffers,
+    //                          NBAIO_Format counterOffers[], size_t& numCounterOffers);
+    //virtual NBAIO_Format format() const;
+
+    // NBAIO_Sink interface
+
+    //virtual size_t framesWritten() const;
+    //virtual size_t framesUnderrun() const;
+    //virtual size_t underruns() const;
+
+    // Space left before the slowest flow-controlled reader, or mMaxFrames if there is none.
+    virtual ssize_t availableToWrite() const;
+    virtual ssize_t write(const void *buffer, size_t count);
+    //virtual ssize_t writeVia(writeVia_t via, size_t total, void *user, size_t block);
+
+            size_t  maxFrames() const { return mMaxFrames; }
+
+private:
+    enum {
+        SLOT_FREE = 0,      // available for enrollment
+        SLOT_CLAIMED = 1,   // owned by a reader that has not published its front yet
+        SLOT_LOSSY = 2,     // enrolled reader that the writer ignores
+        SLOT_BLOCKING = 3,  // enrolled reader that the writer must not overrun
+    };
+
+    struct Slot {
+        volatile int32_t mState;    // SLOT_*, changed with android_atomic_cmpxchg or release_store
+        volatile int32_t mFront;    // written by the reader with android_atomic_release_store,
+                                    // read by the writer with android_atomic_acquire_load
+    };
+
+    // Called by MultiPipeReader: returns the index of an enrolled slot, or -1 if all are in use.
+    int     enroll(bool lossy);
+    void    unenroll(int slot);
+
+    const size_t    mMaxFrames;     // always a power of 2
+    void * const    mBuffer;
+    // mRear and each flow-controlled mFront will never be separated by more than mMaxFrames.
+    volatile int32_t mRear;         // written by android_atomic_release_store
+    Slot            mSlots[kMaxReaders];
+};
+
+}   // namespace android
+
+#endif  // ANDROID_AUDIO_MULTI_PIPE_H
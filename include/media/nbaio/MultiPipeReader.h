@@ -0,0 +1,66 @@
+/*
+ * Copyright (C) 2015 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef ANDROID_AUDIO_MULTI_PIPE_READER_H
+#define ANDROID_AUDIO_MULTI_PIPE_READER_H
+
+#include "MultiPipe.h"
+
+namespace android {
+
+// MultiPipeReader is safe for only a single thread
+class MultiPipeReader : public NBAIO_Source {
+
+public:
+
+    // Construct a MultiPipeReader and enroll it with a MultiPipe.  Any data already in the pipe
+    // is not visible to the reader.  If lossy is false, the writer waits for this reader before
+    // reusing the space it has not read yet; otherwise the reader loses data on overrun.
+    // Check initCheck() as enrollment fails if kMaxReaders readers are already enrolled.
+    MultiPipeReader(MultiPipe& pipe, bool lossy = false);
+    virtual ~MultiPipeReader();
+
+            status_t initCheck() const { return mSlot >= 0 ? NO_ERROR : NO_INIT; }
+
+    // NBAIO_Port interface
+
+    //virtual ssize_t negotiate(const NBAIO_Format offers[], size_t numOffers,
+    //                          NBAIO_Format counterOffers[], size_t& numCounterOffers);
+    //virtual NBAIO_Format format() const;
+
+    // NBAIO_Source interface
+
+    //virtual size_t framesRead() const;
+    virtual size_t framesOverrun() { return mFramesOverrun; }
+    virtual size_t overruns()  { return mOverruns; }
+
+    virtual ssize_t availableToRead();
+
+    virtual ssize_t read(void *buffer, size_t count, int64_t readPTS);
+
+    // NBAIO_Source end
+
+private:
+    MultiPipe&  mPipe;
+    const int   mSlot;          // index in mPipe.mSlots, or -1 if enrollment failed
+    int32_t     mFront;         // follows behind mPipe.mRear, published to the slot after read()
+    size_t      mFramesOverrun; // for a lossy reader only
+    size_t      mOverruns;
+};
+
+}   // namespace android
+
+#endif  // ANDROID_AUDIO_MULTI_PIPE_READER_H
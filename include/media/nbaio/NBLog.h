@@ -19,14 +19,14 @@
 #ifndef ANDROID_MEDIA_NBLOG_H
 #define ANDROID_MEDIA_NBLOG_H
 
+#include <string.h>
 #include <binder/IMemory.h>
 #include <utils/Mutex.h>
+#include <utils/String8.h>
 #include <media/nbaio/roundup.h>
 
 namespace android {
 
-class String8;
-
 class NBLog {
 
 public:
@@ -34,12 +34,32 @@ public:
 class Writer;
 class Reader;
 
+// Describes a binary event, see Writer::logEvent(). Declare one static Format per call site:
+//      static const NBLog::Format kCycle("cycle %d ns");
+// The format string must stay valid for the life of the process, is at most 253 characters,
+// and only supports 32-bit integer conversions (d, i, u, x, X, c) with optional flags and width.
+// The phase is the Chrome trace event phase used by the offline decoder:
+// 'i' for an instant event, 'B' and 'E' for the beginning and end of a duration.
+struct Format {
+    Format(const char *fmt, char phase = 'i') : mFmt(fmt), mPhase(phase), mId(-1) { }
+
+    const char * const      mFmt;
+    const char              mPhase;
+    mutable volatile int32_t mId;   // process-wide id, assigned on first use, -1 until then
+};
+
+// maximum number of distinct Formats per process, and of arguments per binary event
+static const size_t kMaxFormats = 256;
+static const size_t kMaxEventArgs = 8;
+
 private:
 
 enum Event {
     EVENT_RESERVED,
     EVENT_STRING,               // ASCII string, not NUL-terminated
     EVENT_TIMESTAMP,            // clock_gettime(CLOCK_MONOTONIC)
+    EVENT_FORMAT,               // uint8_t id, char phase, format string not NUL-terminated
+    EVENT_BINARY,               // uint8_t id, int64_t CLOCK_MONOTONIC ns, int32_t args[]
 };
 
 // ---------------------------------------------------------------------------
@@ -128,6 +148,20 @@ public:
     virtual void    logTimestamp();
     virtual void    logTimestamp(const struct timespec& ts);
 
+    // Log a binary event: the format id, a timestamp and the raw arguments are stored, and the
+    // formatting is deferred to the reader. The format itself is logged the first time it is
+    // used, and again when it may have been overwritten, so this is cheap enough for fast
+    // threads. At most kMaxEventArgs arguments are kept.
+    virtual void    logEvent(const Format& format, const int32_t *args, size_t count);
+            void    logEvent(const Format& format)
+                        { logEvent(format, (const int32_t *) NULL, 0); }
+            void    logEvent(const Format& format, int32_t a0)
+                        { logEvent(format, &a0, 1); }
+            void    logEvent(const Format& format, int32_t a0, int32_t a1)
+                        { const int32_t args[2] = {a0, a1}; logEvent(format, args, 2); }
+            void    logEvent(const Format& format, int32_t a0, int32_t a1, int32_t a2)
+                        { const int32_t args[3] = {a0, a1, a2}; logEvent(format, args, 3); }
+
     virtual bool    isEnabled() const;
 
     // return value for all of these is the previous isEnabled()
@@ -146,6 +180,8 @@ private:
     const sp<IMemory> mIMemory; // ref-counted version
     int32_t         mRear;      // my private copy of mShared->mRear
     bool            mEnabled;   // whether to actually log
+    // value of mRear when each format was last logged, or mRear - mSize if never logged
+    int32_t         mFormatRear[kMaxFormats];
 };
 
 // ---------------------------------------------------------------------------
@@ -161,6 +197,8 @@ public:
     virtual void    logvf(const char *fmt, va_list ap);
     virtual void    logTimestamp();
     virtual void    logTimestamp(const struct timespec& ts);
+    virtual void    logEvent(const Format& format, const int32_t *args, size_t count);
+    using Writer::logEvent;
 
     virtual bool    isEnabled() const;
     virtual bool    setEnabled(bool enabled);
@@ -181,10 +219,40 @@ public:
 
     virtual ~Reader() { }
 
-    void    dump(int fd, size_t indent = 0);
+    // Print and consume the entries logged since the previous dump.
+    // With trace true, only the binary events are printed, one per line as
+    //      <CLOCK_MONOTONIC ns> TAB <phase> TAB <format id> TAB <format> TAB <expanded text>
+    // which is the input of the host decoder in frameworks/av/tools/nblog_trace.
+    void    dump(int fd, size_t indent = 0, bool trace = false);
+
+    // Print the count, the interval histogram and the first argument statistics of each binary
+    // event format, accumulated over all previous dumps.
+    void    dumpStats(int fd, size_t indent = 0);
+
     bool    isIMemory(const sp<IMemory>& iMemory) const;
 
 private:
+    // aggregated view of the binary events of one format
+    struct FormatStats {
+        FormatStats() : mCount(0), mPrevNs(0), mArgCount(0), mArgMin(0), mArgMax(0), mArgSum(0)
+                { memset(mIntervals, 0, sizeof(mIntervals)); }
+
+        // intervals between consecutive events: bucket i counts intervals in [2^i, 2^(i+1)) us,
+        // and the last bucket everything above
+        static const size_t kIntervalBuckets = 20;
+
+        uint64_t    mCount;
+        int64_t     mPrevNs;
+        uint32_t    mIntervals[kIntervalBuckets];
+        uint64_t    mArgCount;      // statistics of the first argument
+        int32_t     mArgMin;
+        int32_t     mArgMax;
+        int64_t     mArgSum;
+    };
+
+    void    dumpEvent(const uint8_t *data, size_t length, Event event, bool trace);
+    void    expand(String8& out, uint8_t id, const int32_t *args, size_t count) const;
+
     const size_t    mSize;      // circular buffer size in bytes, must be a power of 2
     const Shared* const mShared; // raw pointer to shared memory
     const sp<IMemory> mIMemory; // ref-counted version
@@ -192,6 +260,11 @@ private:
     int     mFd;                // file descriptor
     int     mIndent;            // indentation level
 
+    // format strings and phases received in EVENT_FORMAT entries, kept across dumps
+    String8     mFormats[kMaxFormats];
+    char        mPhases[kMaxFormats];
+    FormatStats mStats[kMaxFormats];
+
     void    dumpLine(const String8& timestamp, String8& body);
 
     static const size_t kSquashTimestamp = 5; // squash this many or more adjacent timestamps
@@ -0,0 +1,39 @@
+/*
+ * Copyright (C) 2015 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef AUDIO_TRACK_PARAMETER_STATE_H
+#define AUDIO_TRACK_PARAMETER_STATE_H
+
+#include <audio_utils/minifloat.h>
+
+namespace android {
+
+// Represents the playback parameters of an AudioTrack that the client changed as one batch, so
+// that the server applies them together at the start of the same mix period.  As this state is
+// too large to be updated atomically without a mutex, and mutexes aren't allowed here, the state
+// is wrapped by a SingleStateQueue.  Successive batches not yet observed by the server coalesce.
+struct AudioTrackParameterState {
+    // do not define constructors, destructors, or virtual methods
+
+    gain_minifloat_packed_t mVolumeLR;
+    uint32_t    mSampleRate;    // 0 == default
+    uint16_t    mSendLevel;     // Fixed point U4.12 so 0x1000 means 1.0
+    uint16_t    mPad;           // unused
+};
+
+}   // namespace android
+
+#endif  // AUDIO_TRACK_PARAMETER_STATE_H
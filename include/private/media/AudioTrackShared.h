@@ -27,6 +27,7 @@
 #include <media/nbaio/roundup.h>
 #include <media/SingleStateQueue.h>
 #include <private/media/StaticAudioTrackState.h>
+#include <private/media/AudioTrackParameterState.h>
 
 namespace android {
 
@@ -40,7 +41,8 @@ namespace android {
 #define CBLK_DISABLED   0x08 // output track disabled by AudioFlinger due to underrun,
                              // need to re-start.  Unlike CBLK_UNDERRUN, this is not set
                              // immediately, but only after a long string of underruns.
-// 0x10 unused
+#define CBLK_STOP_DONE 0x10 // set by server when a stop scheduled with setStopTime() completes,
+                            // cleared by client
 #define CBLK_LOOP_CYCLE 0x20 // set by server each time a loop cycle other than final one completes
 #define CBLK_LOOP_FINAL 0x40 // set by server when the final loop cycle completes
 #define CBLK_BUFFER_END 0x80 // set by server when the position reaches end of buffer if not looping
@@ -72,6 +74,8 @@ struct AudioTrackSharedStatic {
                                         // "for entertainment purposes only"
 };
 
+typedef SingleStateQueue<AudioTrackParameterState> AudioTrackParameterSingleStateQueue;
+
 // ----------------------------------------------------------------------------
 
 // Important: do not add any virtual methods, including ~
@@ -136,6 +140,11 @@ public:
                 } u;
 
                 // Cache line boundary (32 bytes)
+
+                // AudioTrack only: batches of mVolumeLR, mSampleRate and mSendLevel updates.
+                // Once the client has pushed a batch, the server becomes the only writer of these
+                // three fields and copies each new batch into them at the start of a mix period.
+                AudioTrackParameterSingleStateQueue::Shared mParameterQueue;
 };
 
 // ----------------------------------------------------------------------------
@@ -269,28 +278,36 @@ private:
 class AudioTrackClientProxy : public ClientProxy {
 public:
     AudioTrackClientProxy(audio_track_cblk_t* cblk, void *buffers, size_t frameCount,
-            size_t frameSize, bool clientInServer = false)
-        : ClientProxy(cblk, buffers, frameCount, frameSize, true /*isOut*/,
-          clientInServer) { }
+            size_t frameSize, bool clientInServer = false);
     virtual ~AudioTrackClientProxy() { }
 
     // No barriers on the following operations, so the ordering of loads/stores
     // with respect to other parameters is UNPREDICTABLE. That's considered safe.
+    // Within a parameter batch the new values are only published by setParameterBatch(false),
+    // and the server applies them all at the start of the same mix period.
 
     // caller must limit to 0.0 <= sendLevel <= 1.0
     void        setSendLevel(float sendLevel) {
-        mCblk->mSendLevel = uint16_t(sendLevel * 0x1000);
+        mParameters.mSendLevel = uint16_t(sendLevel * 0x1000);
+        updateParameters();
     }
 
     // set stereo gains
     void        setVolumeLR(gain_minifloat_packed_t volumeLR) {
-        mCblk->mVolumeLR = volumeLR;
+        mParameters.mVolumeLR = volumeLR;
+        updateParameters();
     }
 
     void        setSampleRate(uint32_t sampleRate) {
-        mCblk->mSampleRate = sampleRate;
+        mParameters.mSampleRate = sampleRate;
+        updateParameters();
     }
 
+    // Start (true) or end (false) a parameter batch. While a batch is open, setSendLevel(),
+    // setVolumeLR() and setSampleRate() only stage the new values. Ending the batch publishes
+    // them to the server as a single update, which never blocks.
+    void        setParameterBatch(bool batch);
+
     virtual void flush();
 
     virtual uint32_t    getUnderrunFrames() const {
@@ -302,6 +319,15 @@ public:
     bool        getStreamEndDone() const;
 
     status_t    waitStreamEndDone(const struct timespec *requested);
+
+private:
+    // write the parameters to the control block, or stage them if a batch is open
+    void        updateParameters();
+
+    AudioTrackParameterSingleStateQueue::Mutator    mParameterMutator;
+    AudioTrackParameterState    mParameters;        // most recent values set by the client
+    bool                        mParameterBatch;    // a batch is open
+    bool                        mParameterQueued;   // at least one batch has been pushed
 };
 
 class StaticAudioTrackClientProxy : public AudioTrackClientProxy {
@@ -394,7 +420,8 @@ class AudioTrackServerProxy : public ServerProxy {
 public:
     AudioTrackServerProxy(audio_track_cblk_t* cblk, void *buffers, size_t frameCount,
             size_t frameSize, bool clientInServer = false, uint32_t sampleRate = 0)
-        : ServerProxy(cblk, buffers, frameCount, frameSize, true /*isOut*/, clientInServer) {
+        : ServerProxy(cblk, buffers, frameCount, frameSize, true /*isOut*/, clientInServer),
+          mParameterObserver(&cblk->mParameterQueue) {
         mCblk->mSampleRate = sampleRate;
     }
 protected:
@@ -406,6 +433,11 @@ public:
     uint16_t    getSendLevel_U4_12() const { return mCblk->mSendLevel; }
     gain_minifloat_packed_t getVolumeLR() const { return mCblk->mVolumeLR; }
 
+    // Apply the most recent parameter batch pushed by the client, if any, so that the getters
+    // above return the new values.  Call once at the start of each mix period, from the thread
+    // that prepares the track.  Returns true if a new batch was applied.
+    bool        pollParameters();
+
     // estimated total number of filled frames available to server to read,
     // which may include non-contiguous frames
     virtual size_t      framesReady();
@@ -429,6 +461,9 @@ public:
 
     // Return the total number of frames that AudioFlinger has obtained and released
     virtual size_t      framesReleased() const { return mCblk->mServer; }
+
+private:
+    AudioTrackParameterSingleStateQueue::Observer   mParameterObserver;
 };
 
 class StaticAudioTrackServerProxy : public AudioTrackServerProxy {
@@ -11,3 +11,16 @@ LOCAL_MODULE := libcpustats
 LOCAL_CFLAGS := -std=gnu++11 -Werror
 
 include $(BUILD_STATIC_LIBRARY)
+
+include $(CLEAR_VARS)
+
+# shared so that all libraries of a process use the same registry
+LOCAL_SRC_FILES := ThreadCpuRegistry.cpp
+
+LOCAL_SHARED_LIBRARIES := liblog libutils
+
+LOCAL_MODULE := libcpustats_registry
+
+LOCAL_CFLAGS := -std=gnu++11 -Werror
+
+include $(BUILD_SHARED_LIBRARY)
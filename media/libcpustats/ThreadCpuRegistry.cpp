@@ -0,0 +1,389 @@
+/*
+ * Copyright (C) 2015 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#define LOG_TAG "ThreadCpuRegistry"
+//#define LOG_NDEBUG 0
+
+#include <dirent.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/syscall.h>
+#include <time.h>
+#include <unistd.h>
+
+#include <utils/Log.h>
+#include <utils/String8.h>
+
+#include <cpustats/ThreadCpuRegistry.h>
+
+namespace android {
+
+namespace {
+
+const size_t kMaxThreads = 512;     // registered or sampled threads
+const size_t kMaxSubsystems = 32;   // subsystems in the totals
+
+struct Registration {
+    pid_t   mTid;
+    char    mSubsystem[ThreadCpuRegistry::kMaxSubsystemLength + 1];
+};
+
+struct Sample {
+    pid_t       mTid;
+    char        mName[16];          // as in /proc/self/task/<tid>/comm
+    long long   mCpuNs;
+    long long   mWaitNs;            // time runnable but not running, -1 if unknown
+    long long   mTimeslices;        // number of times scheduled in, -1 if unknown
+    long long   mVoluntary;         // voluntary context switches
+    long long   mInvoluntary;       // involuntary context switches
+};
+
+struct Totals {
+    const char  *mSubsystem;
+    int         mThreads;
+    long long   mCpuNs;
+    long long   mWaitNs;
+    long long   mTimeslices;
+    long long   mVoluntary;
+    long long   mInvoluntary;
+};
+
+// all protected by sLock
+pthread_mutex_t sLock = PTHREAD_MUTEX_INITIALIZER;
+Registration sRegistrations[kMaxThreads];
+size_t sRegistrationCount;
+Sample sSamples[2][kMaxThreads];    // current and previous sample, alternating
+size_t sSampleCount[2];
+int sCurrent;
+struct timespec sSampleTs[2];
+
+pid_t currentTid()
+{
+    return (pid_t) syscall(__NR_gettid);
+}
+
+bool threadExists(pid_t tid)
+{
+    return syscall(__NR_tgkill, getpid(), tid, 0) == 0 || errno != ESRCH;
+}
+
+// Drops the registrations of threads that have exited without unregistering, called with sLock
+// held when the table is full.
+void pruneRegistrations()
+{
+    for (size_t i = sRegistrationCount; i > 0; ) {
+        i--;
+        if (!threadExists(sRegistrations[i].mTid)) {
+            sRegistrations[i] = sRegistrations[--sRegistrationCount];
+        }
+    }
+}
+
+// Reads a small /proc file into 'buffer' as a NUL terminated string.
+bool readFile(const char *path, char *buffer, size_t size)
+{
+    int fd = open(path, O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+        return false;
+    }
+    ssize_t actual = read(fd, buffer, size - 1);
+    close(fd);
+    if (actual <= 0) {
+        return false;
+    }
+    buffer[actual] = '\0';
+    return true;
+}
+
+bool readSample(pid_t tid, Sample *sample)
+{
+    char path[64];
+    char buffer[4096];  // for status, the other files are much shorter
+
+    sample->mTid = tid;
+    snprintf(path, sizeof(path), "/proc/self/task/%d/comm", tid);
+    if (!readFile(path, buffer, sizeof(sample->mName))) {
+        return false;
+    }
+    strlcpy(sample->mName, buffer, sizeof(sample->mName));
+    char *newline = strchr(sample->mName, '\n');
+    if (newline != NULL) {
+        *newline = '\0';
+    }
+
+    // schedstat is only present with CONFIG_SCHEDSTATS, stat is the fallback for the CPU time
+    snprintf(path, sizeof(path), "/proc/self/task/%d/schedstat", tid);
+    if (readFile(path, buffer, sizeof(buffer)) &&
+            sscanf(buffer, "%lld %lld %lld",
+                    &sample->mCpuNs, &sample->mWaitNs, &sample->mTimeslices) == 3) {
+        // done
+    } else {
+        snprintf(path, sizeof(path), "/proc/self/task/%d/stat", tid);
+        if (!readFile(path, buffer, sizeof(buffer))) {
+            return false;
+        }
+        // the name in parentheses may contain spaces, fields are counted after it
+        const char *fields = strrchr(buffer, ')');
+        unsigned long long utime, stime;
+        if (fields == NULL || sscanf(fields + 1,
+                " %*c %*d %*d %*d %*d %*d %*u %*u %*u %*u %*u %llu %llu",
+                &utime, &stime) != 2) {
+            return false;
+        }
+        long ticks = sysconf(_SC_CLK_TCK);
+        sample->mCpuNs = (long long) (utime + stime) * (1000000000LL / (ticks > 0 ? ticks : 100));
+        sample->mWaitNs = -1;
+        sample->mTimeslices = -1;
+    }
+
+    sample->mVoluntary = 0;
+    sample->mInvoluntary = 0;
+    snprintf(path, sizeof(path), "/proc/self/task/%d/status", tid);
+    if (readFile(path, buffer, sizeof(buffer))) {
+        const char *line = strstr(buffer, "\nvoluntary_ctxt_switches:");
+        if (line != NULL) {
+            sample->mVoluntary = strtoll(strchr(line, ':') + 1, NULL, 10);
+        }
+        line = strstr(buffer, "\nnonvoluntary_ctxt_switches:");
+        if (line != NULL) {
+            sample->mInvoluntary = strtoll(strchr(line, ':') + 1, NULL, 10);
+        }
+    }
+    return true;
+}
+
+const Sample *findSample(const Sample *samples, size_t count, pid_t tid)
+{
+    for (size_t i = 0; i < count; i++) {
+        if (samples[i].mTid == tid) {
+            return &samples[i];
+        }
+    }
+    return NULL;
+}
+
+const char *findSubsystem(pid_t tid)
+{
+    for (size_t i = 0; i < sRegistrationCount; i++) {
+        if (sRegistrations[i].mTid == tid) {
+            return sRegistrations[i].mSubsystem;
+        }
+    }
+    return NULL;
+}
+
+void appendLine(String8 *report, int indent, const char *format, ...)
+{
+    report->appendFormat("%*s", indent, "");
+    va_list args;
+    va_start(args, format);
+    report->appendFormatV(format, args);
+    va_end(args);
+}
+
+}   // namespace
+
+/*static*/
+void ThreadCpuRegistry::registerThread(const char *subsystem)
+{
+    pid_t tid = currentTid();
+    pthread_mutex_lock(&sLock);
+    size_t i;
+    for (i = 0; i < sRegistrationCount; i++) {
+        if (sRegistrations[i].mTid == tid) {
+            break;
+        }
+    }
+    if (i == sRegistrationCount) {
+        if (sRegistrationCount == kMaxThreads) {
+            pruneRegistrations();
+            i = sRegistrationCount;
+        }
+        if (sRegistrationCount < kMaxThreads) {
+            sRegistrationCount++;
+        } else {
+            i = kMaxThreads;
+        }
+    }
+    if (i < kMaxThreads) {
+        sRegistrations[i].mTid = tid;
+        strlcpy(sRegistrations[i].mSubsystem, subsystem, sizeof(sRegistrations[i].mSubsystem));
+    }
+    pthread_mutex_unlock(&sLock);
+    ALOGW_IF(i == kMaxThreads, "registerThread(%s) too many threads, tid %d not registered",
+            subsystem, tid);
+}
+
+/*static*/
+void ThreadCpuRegistry::unregisterThread()
+{
+    pid_t tid = currentTid();
+    pthread_mutex_lock(&sLock);
+    for (size_t i = 0; i < sRegistrationCount; i++) {
+        if (sRegistrations[i].mTid == tid) {
+            sRegistrations[i] = sRegistrations[--sRegistrationCount];
+            break;
+        }
+    }
+    pthread_mutex_unlock(&sLock);
+}
+
+/*static*/
+void ThreadCpuRegistry::dump(int fd, int indent)
+{
+    String8 report;
+
+    // sLock is not held while reading /proc nor while writing to fd, which may block for as
+    // long as the reader wants: the threads registering and unregistering must not wait for that
+    DIR *dir = opendir("/proc/self/task");
+    if (dir == NULL) {
+        appendLine(&report, indent, "Thread CPU usage: cannot open /proc/self/task, errno %d\n",
+                errno);
+        write(fd, report.string(), report.size());
+        return;
+    }
+    Sample *walked = new Sample[kMaxThreads];
+    size_t count = 0;
+    struct dirent *entry;
+    while ((entry = readdir(dir)) != NULL && count < kMaxThreads) {
+        pid_t tid = atoi(entry->d_name);
+        if (tid > 0 && readSample(tid, &walked[count])) {
+            count++;
+        }
+    }
+    closedir(dir);
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+
+    pthread_mutex_lock(&sLock);
+
+    const int previous = sCurrent;
+    const int current = sCurrent ^ 1;
+    Sample *samples = sSamples[current];
+    memcpy(samples, walked, count * sizeof(Sample));
+    delete[] walked;
+    sSampleCount[current] = count;
+    sSampleTs[current] = ts;
+
+    // drop the registrations of threads that have exited
+    for (size_t i = sRegistrationCount; i > 0; ) {
+        i--;
+        if (findSample(samples, count, sRegistrations[i].mTid) == NULL) {
+            sRegistrations[i] = sRegistrations[--sRegistrationCount];
+        }
+    }
+
+    const bool havePrevious = sSampleCount[previous] > 0;
+    long long elapsedNs = 0;
+    if (havePrevious) {
+        elapsedNs = (sSampleTs[current].tv_sec - sSampleTs[previous].tv_sec) * 1000000000LL +
+                (sSampleTs[current].tv_nsec - sSampleTs[previous].tv_nsec);
+        appendLine(&report, indent, "Thread CPU usage over the last %.3f s "
+                "(* = thread started since, totals since start):\n", elapsedNs * 1e-9);
+    } else {
+        appendLine(&report, indent, "Thread CPU usage since thread start (first sample):\n");
+    }
+    appendLine(&report, indent, "  %-15s %6s %-15s %9s %6s %8s %8s %9s %9s\n", "subsystem", "tid",
+            "name", "cpu_ms", "cpu_%", "vcsw", "ivcsw", "runq_ms", "lat_us");
+
+    Totals totals[kMaxSubsystems];
+    size_t totalsCount = 0;
+    for (size_t i = 0; i < count; i++) {
+        const Sample& cur = samples[i];
+        const Sample *prev = havePrevious ?
+                findSample(sSamples[previous], sSampleCount[previous], cur.mTid) : NULL;
+        Sample delta = cur;
+        if (prev != NULL) {
+            delta.mCpuNs -= prev->mCpuNs;
+            delta.mVoluntary -= prev->mVoluntary;
+            delta.mInvoluntary -= prev->mInvoluntary;
+            if (cur.mWaitNs >= 0 && prev->mWaitNs >= 0) {
+                delta.mWaitNs -= prev->mWaitNs;
+                delta.mTimeslices -= prev->mTimeslices;
+            }
+        }
+        const char *subsystem = findSubsystem(cur.mTid);
+        // idle unregistered threads are left out to keep the report short
+        if (subsystem == NULL && prev != NULL && delta.mCpuNs == 0) {
+            continue;
+        }
+
+        char cpuPercent[8] = "-";
+        if (havePrevious && elapsedNs > 0) {
+            snprintf(cpuPercent, sizeof(cpuPercent), "%.1f", delta.mCpuNs * 100.0 / elapsedNs);
+        }
+        char waitMs[16] = "-";
+        char waitPerSlice[16] = "-";
+        if (delta.mWaitNs >= 0) {
+            snprintf(waitMs, sizeof(waitMs), "%.1f", delta.mWaitNs * 1e-6);
+            if (delta.mTimeslices > 0) {
+                snprintf(waitPerSlice, sizeof(waitPerSlice), "%.0f",
+                        delta.mWaitNs * 1e-3 / delta.mTimeslices);
+            }
+        }
+        appendLine(&report, indent, "%c %-15s %6d %-15s %9.1f %6s %8lld %8lld %9s %9s\n",
+                havePrevious && prev == NULL ? '*' : ' ', subsystem != NULL ? subsystem : "-",
+                cur.mTid, cur.mName, delta.mCpuNs * 1e-6, cpuPercent, delta.mVoluntary,
+                delta.mInvoluntary, waitMs, waitPerSlice);
+
+        const char *key = subsystem != NULL ? subsystem : "-";
+        size_t j;
+        for (j = 0; j < totalsCount && strcmp(totals[j].mSubsystem, key) != 0; j++) {
+        }
+        if (j == totalsCount) {
+            if (totalsCount == kMaxSubsystems) {
+                continue;
+            }
+            memset(&totals[j], 0, sizeof(totals[j]));
+            totals[j].mSubsystem = key;
+            totalsCount++;
+        }
+        totals[j].mThreads++;
+        totals[j].mCpuNs += delta.mCpuNs;
+        totals[j].mVoluntary += delta.mVoluntary;
+        totals[j].mInvoluntary += delta.mInvoluntary;
+        if (delta.mWaitNs >= 0) {
+            totals[j].mWaitNs += delta.mWaitNs;
+            totals[j].mTimeslices += delta.mTimeslices;
+        }
+    }
+
+    appendLine(&report, indent, "  Per subsystem (- = unregistered threads):\n");
+    appendLine(&report, indent, "  %-15s %7s %9s %6s %8s %8s %9s %9s\n", "subsystem", "threads",
+            "cpu_ms", "cpu_%", "vcsw", "ivcsw", "runq_ms", "lat_us");
+    for (size_t j = 0; j < totalsCount; j++) {
+        const Totals& t = totals[j];
+        char cpuPercent[8] = "-";
+        if (havePrevious && elapsedNs > 0) {
+            snprintf(cpuPercent, sizeof(cpuPercent), "%.1f", t.mCpuNs * 100.0 / elapsedNs);
+        }
+        appendLine(&report, indent, "  %-15s %7d %9.1f %6s %8lld %8lld %9.1f %9.0f\n", t.mSubsystem,
+                t.mThreads, t.mCpuNs * 1e-6, cpuPercent, t.mVoluntary, t.mInvoluntary,
+                t.mWaitNs * 1e-6, t.mTimeslices > 0 ? t.mWaitNs * 1e-3 / t.mTimeslices : 0.0);
+    }
+
+    sCurrent = current;
+    pthread_mutex_unlock(&sLock);
+
+    write(fd, report.string(), report.size());
+}
+
+}   // namespace android
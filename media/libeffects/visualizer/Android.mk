@@ -4,7 +4,8 @@ LOCAL_PATH:= $(call my-dir)
 include $(CLEAR_VARS)
 
 LOCAL_SRC_FILES:= \
-	EffectVisualizer.cpp
+	EffectVisualizer.cpp \
+	VisualizerFft.cpp
 
 LOCAL_CFLAGS+= -O2 -fvisibility=hidden
 
@@ -17,7 +18,8 @@ LOCAL_MODULE_RELATIVE_PATH := soundfx
 LOCAL_MODULE:= libvisualizer
 
 LOCAL_C_INCLUDES := \
-	$(call include-path-for, audio-effects)
+	$(call include-path-for, audio-effects) \
+	frameworks/av/include
 
 
 include $(BUILD_SHARED_LIBRARY)
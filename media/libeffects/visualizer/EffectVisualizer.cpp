@@ -19,12 +19,15 @@
 #include <log/log.h>
 #include <assert.h>
 #include <inttypes.h>
+#include <pthread.h>
 #include <stdlib.h>
 #include <string.h>
 #include <new>
 #include <time.h>
 #include <math.h>
-#include <audio_effects/effect_visualizer.h>
+#include <media/EffectVisualizerApi.h>
+
+#include "VisualizerFft.h"
 
 
 extern "C" {
@@ -79,6 +82,26 @@ struct VisualizerContext {
     uint32_t mLatency;
     struct timespec mBufferUpdateTime;
     uint8_t mCaptureBuf[CAPTURE_BUF_SIZE];
+    // float copy of the capture, allocated on first FFT request. The FFT is computed from it at
+    // most once per capture window and the result is cached for other clients polling the same
+    // window.
+    // mFloatLock protects mCaptureBufFloat against the command thread: process() only tries to
+    // lock it and skips the float copy of a buffer when it fails, it never blocks.
+    pthread_mutex_t mFloatLock;
+    float *mCaptureBufFloat;
+    // FFT input and output, allocated along with mCaptureBufFloat for the maximum capture size
+    float *mFftIn;
+    float *mFftRe;
+    float *mFftIm;
+    uint32_t mFftWindow;
+    VisualizerFft mFft;
+    uint32_t mProcessCount;         // incremented each time new audio is captured
+    bool mFftCacheValid;
+    uint32_t mFftCacheProcessCount;
+    uint32_t mFftCacheStart;
+    uint32_t mFftCacheSize;
+    uint32_t mFftCacheWindow;
+    uint8_t mFftCache[VISUALIZER_CAPTURE_SIZE_MAX_EXT];
     // for measurements
     uint8_t mChannelCount; // to avoid recomputing it every time a buffer is processed
     uint32_t mMeasurementMode;
@@ -115,6 +138,110 @@ void Visualizer_reset(VisualizerContext *pContext)
     pContext->mBufferUpdateTime.tv_sec = 0;
     pContext->mLatency = 0;
     memset(pContext->mCaptureBuf, 0x80, CAPTURE_BUF_SIZE);
+    pthread_mutex_lock(&pContext->mFloatLock);
+    if (pContext->mCaptureBufFloat != NULL) {
+        memset(pContext->mCaptureBufFloat, 0, CAPTURE_BUF_SIZE * sizeof(float));
+    }
+    pthread_mutex_unlock(&pContext->mFloatLock);
+    pContext->mFftCacheValid = false;
+}
+
+//----------------------------------------------------------------------------
+// Visualizer_getCaptureStart()
+//----------------------------------------------------------------------------
+// Purpose: Locate the start of the most recent capture window in the capture buffer,
+//  compensating for the output latency.
+//
+// Inputs:
+//  pContext:   effect engine context
+//  captureSize: number of samples in the capture window
+//
+// Outputs:
+//  pStart:     index of the first sample of the window in the capture buffer
+//
+// Returns false if the framework stopped playing audio and silence must be returned.
+//----------------------------------------------------------------------------
+
+bool Visualizer_getCaptureStart(VisualizerContext *pContext, uint32_t captureSize,
+        uint32_t *pStart)
+{
+    const uint32_t deltaMs = Visualizer_getDeltaTimeMsFromUpdatedTime(pContext);
+
+    // if audio framework has stopped playing audio although the effect is still
+    // active we must clear the capture buffer to return silence
+    if ((pContext->mLastCaptureIdx == pContext->mCaptureIdx) &&
+            (pContext->mBufferUpdateTime.tv_sec != 0) &&
+            (deltaMs > MAX_STALL_TIME_MS)) {
+        ALOGV("capture going to idle");
+        pContext->mBufferUpdateTime.tv_sec = 0;
+        return false;
+    }
+    int32_t latencyMs = pContext->mLatency;
+    latencyMs -= deltaMs;
+    if (latencyMs < 0) {
+        latencyMs = 0;
+    }
+    const uint32_t deltaSmpl =
+        pContext->mConfig.inputCfg.samplingRate * latencyMs / 1000;
+    int32_t capturePoint = pContext->mCaptureIdx - captureSize - deltaSmpl;
+    if (capturePoint < 0) {
+        capturePoint += CAPTURE_BUF_SIZE;
+    }
+    *pStart = capturePoint;
+    return true;
+}
+
+//----------------------------------------------------------------------------
+// Visualizer_computeFft()
+//----------------------------------------------------------------------------
+// Purpose: Compute the FFT of the capture window starting at start and convert it
+//  to the 8-bit layout returned by Visualizer::getFft().
+//
+// Inputs:
+//  pContext:   effect engine context
+//  start:      index of the first sample of the window in the float capture buffer
+//  captureSize: number of samples in the window
+//
+// Outputs:
+//  pFft:       captureSize bytes
+//
+//----------------------------------------------------------------------------
+
+int Visualizer_computeFft(VisualizerContext *pContext, uint32_t start, uint32_t captureSize,
+        uint8_t *pFft)
+{
+    int status = VisualizerFft_configure(&pContext->mFft, captureSize, pContext->mFftWindow);
+    if (status != 0) {
+        return status;
+    }
+    const uint32_t half = captureSize >> 1;
+    float *in = pContext->mFftIn;
+    float *re = pContext->mFftRe;
+    float *im = pContext->mFftIm;
+
+    uint32_t size = captureSize;
+    if (start + size > CAPTURE_BUF_SIZE) {
+        size = CAPTURE_BUF_SIZE - start;
+    }
+    pthread_mutex_lock(&pContext->mFloatLock);
+    memcpy(in, pContext->mCaptureBufFloat + start, size * sizeof(float));
+    memcpy(in + size, pContext->mCaptureBufFloat, (captureSize - size) * sizeof(float));
+    pthread_mutex_unlock(&pContext->mFloatLock);
+
+    VisualizerFft_process(&pContext->mFft, in, re, im);
+
+    // The float capture is in units of 8-bit samples / 128. The legacy fixed-point FFT returns
+    // X[k] * 8 / N for 8-bit samples, halving values until they fit in 8 bits.
+    const float scale = 1024.0f / captureSize;
+    for (uint32_t k = 0; k < half; k++) {
+        int32_t r = (int32_t)(re[k] * scale);
+        int32_t i = (int32_t)((k == 0 ? re[half] : im[k]) * scale);
+        while (r > 127 || r < -128) r >>= 1;
+        while (i > 127 || i < -128) i >>= 1;
+        pFft[2 * k] = (uint8_t)r;
+        pFft[2 * k + 1] = (uint8_t)i;
+    }
+    return 0;
 }
 
 //----------------------------------------------------------------------------
@@ -205,6 +332,8 @@ int Visualizer_init(VisualizerContext *pContext)
     // visualization initialization
     pContext->mCaptureSize = VISUALIZER_CAPTURE_SIZE_MAX;
     pContext->mScalingMode = VISUALIZER_SCALING_MODE_NORMALIZED;
+    pContext->mFftWindow = VISUALIZER_FFT_WINDOW_RECTANGULAR;
+    pContext->mProcessCount = 0;
 
     // measurement initialization
     pContext->mChannelCount =
@@ -246,10 +375,18 @@ int VisualizerLib_Create(const effect_uuid_t *uuid,
 
     pContext->mItfe = &gVisualizerInterface;
     pContext->mState = VISUALIZER_STATE_UNINITIALIZED;
+    pthread_mutex_init(&pContext->mFloatLock, NULL);
+    pContext->mCaptureBufFloat = NULL;
+    pContext->mFftIn = NULL;
+    pContext->mFftRe = NULL;
+    pContext->mFftIm = NULL;
+    VisualizerFft_init(&pContext->mFft);
 
     ret = Visualizer_init(pContext);
     if (ret < 0) {
         ALOGW("VisualizerLib_Create() init failed");
+        VisualizerFft_release(&pContext->mFft);
+        pthread_mutex_destroy(&pContext->mFloatLock);
         delete pContext;
         return ret;
     }
@@ -272,6 +409,12 @@ int VisualizerLib_Release(effect_handle_t handle) {
         return -EINVAL;
     }
     pContext->mState = VISUALIZER_STATE_UNINITIALIZED;
+    VisualizerFft_release(&pContext->mFft);
+    delete[] pContext->mCaptureBufFloat;
+    delete[] pContext->mFftIn;
+    delete[] pContext->mFftRe;
+    delete[] pContext->mFftIm;
+    pthread_mutex_destroy(&pContext->mFloatLock);
     delete pContext;
 
     return 0;
@@ -375,6 +518,13 @@ int Visualizer_process(
     uint32_t captIdx;
     uint32_t inIdx;
     uint8_t *buf = pContext->mCaptureBuf;
+    float *bufFloat = NULL;
+    const bool floatLocked = pthread_mutex_trylock(&pContext->mFloatLock) == 0;
+    if (floatLocked) {
+        bufFloat = pContext->mCaptureBufFloat;
+    }
+    // same scaling as the 8-bit capture, normalized to [-1, 1) and without quantization
+    const float floatScale = 1.0f / (float)(1 << (shift + 7));
     for (inIdx = 0, captIdx = pContext->mCaptureIdx;
          inIdx < inBuffer->frameCount;
          inIdx++, captIdx++) {
@@ -383,9 +533,16 @@ int Visualizer_process(
             captIdx = 0;
         }
         int32_t smp = inBuffer->s16[2 * inIdx] + inBuffer->s16[2 * inIdx + 1];
+        if (bufFloat != NULL) {
+            bufFloat[captIdx] = smp * floatScale;
+        }
         smp = smp >> shift;
         buf[captIdx] = ((uint8_t)smp)^0x80;
     }
+    if (floatLocked) {
+        pthread_mutex_unlock(&pContext->mFloatLock);
+    }
+    pContext->mProcessCount++;
 
     // XXX the following two should really be atomic, though it probably doesn't
     // matter much for visualization purposes
@@ -503,6 +660,12 @@ int Visualizer_command(effect_handle_t self, uint32_t cmdCode, uint32_t cmdSize,
             p->vsize = sizeof(uint32_t);
             *replySize += sizeof(uint32_t);
             break;
+        case VISUALIZER_PARAM_FFT_WINDOW:
+            ALOGV("get mFftWindow = %" PRIu32, pContext->mFftWindow);
+            *((uint32_t *)p->data + 1) = pContext->mFftWindow;
+            p->vsize = sizeof(uint32_t);
+            *replySize += sizeof(uint32_t);
+            break;
         default:
             p->status = -EINVAL;
         }
@@ -520,10 +683,16 @@ int Visualizer_command(effect_handle_t self, uint32_t cmdCode, uint32_t cmdSize,
             break;
         }
         switch (*(uint32_t *)p->data) {
-        case VISUALIZER_PARAM_CAPTURE_SIZE:
-            pContext->mCaptureSize = *((uint32_t *)p->data + 1);
+        case VISUALIZER_PARAM_CAPTURE_SIZE: {
+            uint32_t size = *((uint32_t *)p->data + 1);
+            if (size < VISUALIZER_CAPTURE_SIZE_MIN || size > VISUALIZER_CAPTURE_SIZE_MAX_EXT ||
+                    (size & (size - 1)) != 0) {
+                *(int32_t *)pReplyData = -EINVAL;
+                break;
+            }
+            pContext->mCaptureSize = size;
             ALOGV("set mCaptureSize = %" PRIu32, pContext->mCaptureSize);
-            break;
+            } break;
         case VISUALIZER_PARAM_SCALING_MODE:
             pContext->mScalingMode = *((uint32_t *)p->data + 1);
             ALOGV("set mScalingMode = %" PRIu32, pContext->mScalingMode);
@@ -536,6 +705,15 @@ int Visualizer_command(effect_handle_t self, uint32_t cmdCode, uint32_t cmdSize,
             pContext->mMeasurementMode = *((uint32_t *)p->data + 1);
             ALOGV("set mMeasurementMode = %" PRIu32, pContext->mMeasurementMode);
             break;
+        case VISUALIZER_PARAM_FFT_WINDOW: {
+            uint32_t window = *((uint32_t *)p->data + 1);
+            if (window >= VISUALIZER_FFT_WINDOW_CNT) {
+                *(int32_t *)pReplyData = -EINVAL;
+                break;
+            }
+            pContext->mFftWindow = window;
+            ALOGV("set mFftWindow = %" PRIu32, pContext->mFftWindow);
+            } break;
         default:
             *(int32_t *)pReplyData = -EINVAL;
         }
@@ -554,33 +732,14 @@ int Visualizer_command(effect_handle_t self, uint32_t cmdCode, uint32_t cmdSize,
             return -EINVAL;
         }
         if (pContext->mState == VISUALIZER_STATE_ACTIVE) {
-            const uint32_t deltaMs = Visualizer_getDeltaTimeMsFromUpdatedTime(pContext);
-
-            // if audio framework has stopped playing audio although the effect is still
-            // active we must clear the capture buffer to return silence
-            if ((pContext->mLastCaptureIdx == pContext->mCaptureIdx) &&
-                    (pContext->mBufferUpdateTime.tv_sec != 0) &&
-                    (deltaMs > MAX_STALL_TIME_MS)) {
-                    ALOGV("capture going to idle");
-                    pContext->mBufferUpdateTime.tv_sec = 0;
-                    memset(pReplyData, 0x80, captureSize);
+            uint32_t capturePoint;
+            if (!Visualizer_getCaptureStart(pContext, captureSize, &capturePoint)) {
+                memset(pReplyData, 0x80, captureSize);
             } else {
-                int32_t latencyMs = pContext->mLatency;
-                latencyMs -= deltaMs;
-                if (latencyMs < 0) {
-                    latencyMs = 0;
-                }
-                const uint32_t deltaSmpl =
-                    pContext->mConfig.inputCfg.samplingRate * latencyMs / 1000;
-                int32_t capturePoint = pContext->mCaptureIdx - captureSize - deltaSmpl;
-
-                if (capturePoint < 0) {
-                    uint32_t size = -capturePoint;
-                    if (size > captureSize) {
-                        size = captureSize;
-                    }
+                if (capturePoint + captureSize > CAPTURE_BUF_SIZE) {
+                    uint32_t size = CAPTURE_BUF_SIZE - capturePoint;
                     memcpy(pReplyData,
-                           pContext->mCaptureBuf + CAPTURE_BUF_SIZE + capturePoint,
+                           pContext->mCaptureBuf + capturePoint,
                            size);
                     pReplyData = (char *)pReplyData + size;
                     captureSize -= size;
@@ -598,6 +757,64 @@ int Visualizer_command(effect_handle_t self, uint32_t cmdCode, uint32_t cmdSize,
 
         } break;
 
+    case VISUALIZER_CMD_CAPTURE_FFT: {
+        uint32_t captureSize = pContext->mCaptureSize;
+        if (pReplyData == NULL || *replySize != captureSize) {
+            ALOGV("VISUALIZER_CMD_CAPTURE_FFT() error *replySize %" PRIu32
+                    " captureSize %" PRIu32, *replySize, captureSize);
+            return -EINVAL;
+        }
+        if (pContext->mCaptureBufFloat == NULL) {
+            // the float capture starts being filled from now on: the first windows
+            // are partially silent
+            const uint32_t half = VISUALIZER_CAPTURE_SIZE_MAX_EXT >> 1;
+            float *bufFloat = new (std::nothrow) float[CAPTURE_BUF_SIZE];
+            float *fftIn = new (std::nothrow) float[VISUALIZER_CAPTURE_SIZE_MAX_EXT];
+            float *fftRe = new (std::nothrow) float[half + 1];
+            float *fftIm = new (std::nothrow) float[half + 1];
+            if (bufFloat == NULL || fftIn == NULL || fftRe == NULL || fftIm == NULL) {
+                delete[] bufFloat;
+                delete[] fftIn;
+                delete[] fftRe;
+                delete[] fftIm;
+                return -ENOMEM;
+            }
+            memset(bufFloat, 0, CAPTURE_BUF_SIZE * sizeof(float));
+            pContext->mFftIn = fftIn;
+            pContext->mFftRe = fftRe;
+            pContext->mFftIm = fftIm;
+            pthread_mutex_lock(&pContext->mFloatLock);
+            pContext->mCaptureBufFloat = bufFloat;
+            pthread_mutex_unlock(&pContext->mFloatLock);
+            pContext->mFftCacheValid = false;
+        }
+        uint32_t capturePoint;
+        if (pContext->mState != VISUALIZER_STATE_ACTIVE ||
+                !Visualizer_getCaptureStart(pContext, captureSize, &capturePoint)) {
+            memset(pReplyData, 0, captureSize);
+            pContext->mLastCaptureIdx = pContext->mCaptureIdx;
+            break;
+        }
+        if (!pContext->mFftCacheValid ||
+                pContext->mFftCacheProcessCount != pContext->mProcessCount ||
+                pContext->mFftCacheStart != capturePoint ||
+                pContext->mFftCacheSize != captureSize ||
+                pContext->mFftCacheWindow != pContext->mFftWindow) {
+            int ret = Visualizer_computeFft(pContext, capturePoint, captureSize,
+                    pContext->mFftCache);
+            if (ret != 0) {
+                return ret;
+            }
+            pContext->mFftCacheValid = true;
+            pContext->mFftCacheProcessCount = pContext->mProcessCount;
+            pContext->mFftCacheStart = capturePoint;
+            pContext->mFftCacheSize = captureSize;
+            pContext->mFftCacheWindow = pContext->mFftWindow;
+        }
+        memcpy(pReplyData, pContext->mFftCache, captureSize);
+        pContext->mLastCaptureIdx = pContext->mCaptureIdx;
+        } break;
+
     case VISUALIZER_CMD_MEASURE: {
         uint16_t peakU16 = 0;
         float sumRmsSquared = 0.0f;
@@ -0,0 +1,214 @@
+/*
+ * Copyright (C) 2015 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#define LOG_TAG "VisualizerFft"
+//#define LOG_NDEBUG 0
+#include <log/log.h>
+#include <errno.h>
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+#include <media/EffectVisualizerApi.h>
+
+#include "VisualizerFft.h"
+
+#if defined(__ARM_NEON__)
+#define USE_NEON (true)
+#include <arm_neon.h>
+#else
+#define USE_NEON (false)
+#endif
+
+void VisualizerFft_init(VisualizerFft *fft)
+{
+    memset(fft, 0, sizeof(*fft));
+}
+
+void VisualizerFft_release(VisualizerFft *fft)
+{
+    free(fft->mWindow);
+    free(fft->mStageRe);
+    free(fft->mStageIm);
+    free(fft->mSplitRe);
+    free(fft->mSplitIm);
+    free(fft->mBitRev);
+    free(fft->mRe);
+    free(fft->mIm);
+    VisualizerFft_init(fft);
+}
+
+int VisualizerFft_configure(VisualizerFft *fft, uint32_t size, uint32_t windowType)
+{
+    if (size < 4 || (size & (size - 1)) != 0 || windowType >= VISUALIZER_FFT_WINDOW_CNT) {
+        return -EINVAL;
+    }
+    if (fft->mSize == size && fft->mWindowType == windowType) {
+        return 0;
+    }
+    VisualizerFft_release(fft);
+
+    const uint32_t half = size >> 1;
+    fft->mStageRe = (float *)malloc(half * sizeof(float));
+    fft->mStageIm = (float *)malloc(half * sizeof(float));
+    fft->mSplitRe = (float *)malloc(half * sizeof(float));
+    fft->mSplitIm = (float *)malloc(half * sizeof(float));
+    fft->mBitRev = (uint32_t *)malloc(half * sizeof(uint32_t));
+    fft->mRe = (float *)malloc(half * sizeof(float));
+    fft->mIm = (float *)malloc(half * sizeof(float));
+    if (windowType != VISUALIZER_FFT_WINDOW_RECTANGULAR) {
+        fft->mWindow = (float *)malloc(size * sizeof(float));
+    }
+    if (fft->mStageRe == NULL || fft->mStageIm == NULL || fft->mSplitRe == NULL ||
+            fft->mSplitIm == NULL || fft->mBitRev == NULL || fft->mRe == NULL ||
+            fft->mIm == NULL ||
+            (windowType != VISUALIZER_FFT_WINDOW_RECTANGULAR && fft->mWindow == NULL)) {
+        ALOGE("VisualizerFft_configure() cannot allocate tables for size %u", size);
+        VisualizerFft_release(fft);
+        return -ENOMEM;
+    }
+
+    // twiddles of the stage with half span h start at index h - 1
+    for (uint32_t h = 1; h < half; h <<= 1) {
+        for (uint32_t j = 0; j < h; j++) {
+            const double phase = -M_PI * j / h;
+            fft->mStageRe[h - 1 + j] = (float)cos(phase);
+            fft->mStageIm[h - 1 + j] = (float)sin(phase);
+        }
+    }
+    for (uint32_t k = 0; k < half; k++) {
+        const double phase = -2 * M_PI * k / size;
+        fft->mSplitRe[k] = (float)cos(phase);
+        fft->mSplitIm[k] = (float)sin(phase);
+    }
+    uint32_t bits = 0;
+    while ((1u << bits) < half) {
+        bits++;
+    }
+    for (uint32_t k = 0; k < half; k++) {
+        uint32_t rev = 0;
+        for (uint32_t b = 0; b < bits; b++) {
+            rev |= ((k >> b) & 1) << (bits - 1 - b);
+        }
+        fft->mBitRev[k] = rev;
+    }
+    if (fft->mWindow != NULL) {
+        for (uint32_t n = 0; n < size; n++) {
+            const double x = 2 * M_PI * n / size;
+            double w;
+            switch (windowType) {
+            case VISUALIZER_FFT_WINDOW_HANN:
+                w = 0.5 - 0.5 * cos(x);
+                break;
+            case VISUALIZER_FFT_WINDOW_HAMMING:
+                w = 0.54 - 0.46 * cos(x);
+                break;
+            case VISUALIZER_FFT_WINDOW_BLACKMAN:
+            default:
+                w = 0.42 - 0.5 * cos(x) + 0.08 * cos(2 * x);
+                break;
+            }
+            fft->mWindow[n] = (float)w;
+        }
+    }
+
+    fft->mSize = size;
+    fft->mWindowType = windowType;
+    ALOGV("VisualizerFft_configure() size %u window %u", size, windowType);
+    return 0;
+}
+
+// one radix-2 stage with half span h over the whole work buffer
+static inline void VisualizerFft_stage(float *re, float *im, uint32_t n,
+        const float *twRe, const float *twIm, uint32_t h)
+{
+    for (uint32_t r = 0; r < n; r += h << 1) {
+        float *aRe = re + r;
+        float *aIm = im + r;
+        float *bRe = aRe + h;
+        float *bIm = aIm + h;
+        uint32_t j = 0;
+#if USE_NEON
+        for (; j + 4 <= h; j += 4) {
+            float32x4_t wr = vld1q_f32(twRe + j);
+            float32x4_t wi = vld1q_f32(twIm + j);
+            float32x4_t xr = vld1q_f32(bRe + j);
+            float32x4_t xi = vld1q_f32(bIm + j);
+            float32x4_t tr = vmlsq_f32(vmulq_f32(xr, wr), xi, wi);
+            float32x4_t ti = vmlaq_f32(vmulq_f32(xr, wi), xi, wr);
+            float32x4_t ar = vld1q_f32(aRe + j);
+            float32x4_t ai = vld1q_f32(aIm + j);
+            vst1q_f32(bRe + j, vsubq_f32(ar, tr));
+            vst1q_f32(bIm + j, vsubq_f32(ai, ti));
+            vst1q_f32(aRe + j, vaddq_f32(ar, tr));
+            vst1q_f32(aIm + j, vaddq_f32(ai, ti));
+        }
+#endif
+        for (; j < h; j++) {
+            const float tr = bRe[j] * twRe[j] - bIm[j] * twIm[j];
+            const float ti = bRe[j] * twIm[j] + bIm[j] * twRe[j];
+            bRe[j] = aRe[j] - tr;
+            bIm[j] = aIm[j] - ti;
+            aRe[j] += tr;
+            aIm[j] += ti;
+        }
+    }
+}
+
+void VisualizerFft_process(VisualizerFft *fft, const float *in, float *outRe, float *outIm)
+{
+    const uint32_t half = fft->mSize >> 1;
+    float *re = fft->mRe;
+    float *im = fft->mIm;
+
+    // pack even samples as real and odd samples as imaginary parts, in bit reversed order
+    if (fft->mWindow != NULL) {
+        const float *w = fft->mWindow;
+        for (uint32_t k = 0; k < half; k++) {
+            const uint32_t n = fft->mBitRev[k] << 1;
+            re[k] = in[n] * w[n];
+            im[k] = in[n + 1] * w[n + 1];
+        }
+    } else {
+        for (uint32_t k = 0; k < half; k++) {
+            const uint32_t n = fft->mBitRev[k] << 1;
+            re[k] = in[n];
+            im[k] = in[n + 1];
+        }
+    }
+
+    for (uint32_t h = 1; h < half; h <<= 1) {
+        VisualizerFft_stage(re, im, half, fft->mStageRe + h - 1, fft->mStageIm + h - 1, h);
+    }
+
+    // split the half size complex spectrum Z into the spectrum X of the real input:
+    // X[k] = E[k] + W^k O[k] with E = (Z[k] + Z*[N/2-k]) / 2 and O = (Z[k] - Z*[N/2-k]) / 2i
+    outRe[0] = re[0] + im[0];
+    outIm[0] = 0;
+    outRe[half] = re[0] - im[0];
+    outIm[half] = 0;
+    for (uint32_t k = 1; k < half; k++) {
+        const float cr = re[half - k];
+        const float ci = -im[half - k];
+        const float er = 0.5f * (re[k] + cr);
+        const float ei = 0.5f * (im[k] + ci);
+        const float orr = 0.5f * (im[k] - ci);
+        const float oi = -0.5f * (re[k] - cr);
+        const float wr = fft->mSplitRe[k];
+        const float wi = fft->mSplitIm[k];
+        outRe[k] = er + wr * orr - wi * oi;
+        outIm[k] = ei + wr * oi + wi * orr;
+    }
+}
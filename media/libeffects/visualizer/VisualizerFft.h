@@ -0,0 +1,53 @@
+/*
+ * Copyright (C) 2015 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef ANDROID_VISUALIZER_FFT_H_
+#define ANDROID_VISUALIZER_FFT_H_
+
+#include <stdint.h>
+
+// Real-input float FFT used by the visualizer effect.
+//
+// A real FFT of N points is computed as a complex FFT of N/2 points on the even/odd interleaved
+// input, followed by a split pass that recovers the N/2 + 1 non redundant bins. Twiddle factors
+// are stored per stage so that the butterflies of a stage read them contiguously; on ARM the
+// butterflies are done four at a time with NEON.
+
+struct VisualizerFft {
+    uint32_t mSize;         // number of real input samples, power of 2, 0 when not configured
+    uint32_t mWindowType;   // visualizer_fft_window_e
+    float *mWindow;         // mSize window coefficients, NULL for a rectangular window
+    float *mStageRe;        // per stage twiddles of the N/2 point complex FFT (N/2 - 1 entries)
+    float *mStageIm;
+    float *mSplitRe;        // twiddles of the real split pass (N/2 entries)
+    float *mSplitIm;
+    uint32_t *mBitRev;      // bit reversal permutation of the N/2 point complex FFT
+    float *mRe;             // work buffers (N/2 entries each)
+    float *mIm;
+};
+
+void VisualizerFft_init(VisualizerFft *fft);
+
+// (Re)builds the tables for a new size or window. Returns 0 or -ENOMEM / -EINVAL.
+int VisualizerFft_configure(VisualizerFft *fft, uint32_t size, uint32_t windowType);
+
+void VisualizerFft_release(VisualizerFft *fft);
+
+// Computes the spectrum of mSize real samples. outRe and outIm receive mSize / 2 + 1 bins
+// (DC to Nyquist included). The input is not modified.
+void VisualizerFft_process(VisualizerFft *fft, const float *in, float *outRe, float *outIm);
+
+#endif // ANDROID_VISUALIZER_FFT_H_
@@ -58,6 +58,7 @@ LOCAL_SRC_FILES:= \
     Visualizer.cpp \
     MemoryLeakTrackUtil.cpp \
     SoundPool.cpp \
+    SoundPoolSampleCache.cpp \
     SoundPoolThread.cpp \
     StringArray.cpp
 
@@ -384,6 +384,7 @@ status_t AudioTrack::set(
     mVolume[AUDIO_INTERLEAVE_LEFT] = 1.0f;
     mVolume[AUDIO_INTERLEAVE_RIGHT] = 1.0f;
     mSendLevel = 0.0f;
+    mParameterBatchDepth = 0;
     // mFrameCount is initialized in createTrack_l
     mReqFrameCount = frameCount;
     mNotificationFramesReq = notificationFrames;
@@ -448,6 +449,9 @@ status_t AudioTrack::start()
 {
     AutoMutex lock(mLock);
 
+    // a track stopped at its stop time can be started again
+    checkScheduledStop_l();
+
     if (mState == STATE_ACTIVE) {
         return INVALID_OPERATION;
     }
@@ -475,7 +479,7 @@ status_t AudioTrack::start()
         mRefreshRemaining = true;
     }
     mNewPosition = mPosition + mUpdatePeriod;
-    int32_t flags = android_atomic_and(~CBLK_DISABLED, &mCblk->mFlags);
+    int32_t flags = android_atomic_and(~(CBLK_DISABLED | CBLK_STOP_DONE), &mCblk->mFlags);
 
     sp<AudioTrackThread> t = mAudioTrackThread;
     if (t != 0) {
@@ -556,10 +560,59 @@ void AudioTrack::stop()
     }
 }
 
+status_t AudioTrack::startAt(int64_t presentationTimeNs)
+{
+    if (presentationTimeNs <= 0) {
+        return BAD_VALUE;
+    }
+    {
+        AutoMutex lock(mLock);
+        if (mState == STATE_ACTIVE) {
+            return INVALID_OPERATION;
+        }
+        if (mIsTimed || isOffloadedOrDirect_l() || (mFlags & AUDIO_OUTPUT_FLAG_FAST)) {
+            return INVALID_OPERATION;
+        }
+        status_t status = mAudioTrack->setStartTime(presentationTimeNs);
+        if (status != NO_ERROR) {
+            return status;
+        }
+    }
+    return start();
+}
+
+status_t AudioTrack::stopAt(int64_t presentationTimeNs)
+{
+    if (presentationTimeNs < 0) {
+        return BAD_VALUE;
+    }
+    AutoMutex lock(mLock);
+    if (mIsTimed || isOffloadedOrDirect_l() || (mFlags & AUDIO_OUTPUT_FLAG_FAST)) {
+        return INVALID_OPERATION;
+    }
+    return mAudioTrack->setStopTime(presentationTimeNs);
+}
+
 bool AudioTrack::stopped() const
 {
     AutoMutex lock(mLock);
-    return mState != STATE_ACTIVE;
+    return mState != STATE_ACTIVE || (mCblk->mFlags & CBLK_STOP_DONE);
+}
+
+bool AudioTrack::checkScheduledStop_l()
+{
+    if (!(android_atomic_and(~CBLK_STOP_DONE, &mCblk->mFlags) & CBLK_STOP_DONE)
+            || mState != STATE_ACTIVE) {
+        return false;
+    }
+    ALOGV("scheduled stop of track %p completed", this);
+
+    // the server track is stopped already, do the client side of stop()
+    mState = STATE_STOPPED;
+    mReleased = 0;
+    mMarkerReached = false;
+    mProxy->interrupt();
+    return true;
 }
 
 void AudioTrack::flush()
@@ -693,6 +746,29 @@ status_t AudioTrack::setSampleRate(uint32_t rate)
     return NO_ERROR;
 }
 
+void AudioTrack::beginParameterBatch()
+{
+    AutoMutex lock(mLock);
+    if (mParameterBatchDepth++ == 0) {
+        mProxy->setParameterBatch(true);
+    }
+}
+
+void AudioTrack::endParameterBatch()
+{
+    AutoMutex lock(mLock);
+    if (mParameterBatchDepth <= 0) {
+        ALOGW("endParameterBatch() without beginParameterBatch()");
+        return;
+    }
+    if (--mParameterBatchDepth == 0) {
+        mProxy->setParameterBatch(false);
+        if (isOffloaded_l()) {
+            mAudioTrack->signal();
+        }
+    }
+}
+
 uint32_t AudioTrack::getSampleRate() const
 {
     if (mIsTimed) {
@@ -1222,6 +1298,10 @@ status_t AudioTrack::createTrack_l()
     mProxy->setSendLevel(mSendLevel);
     mProxy->setSampleRate(mSampleRate);
     mProxy->setMinimum(mNotificationFramesAct);
+    // a re-created IAudioTrack inherits a batch that is still open
+    if (mParameterBatchDepth > 0) {
+        mProxy->setParameterBatch(true);
+    }
 
     mDeathNotifier = new DeathNotifier(this);
     mAudioTrack->asBinder()->linkToDeath(mDeathNotifier, this);
@@ -1309,6 +1389,8 @@ status_t AudioTrack::obtainBuffer(Buffer* audioBuffer, const struct timespec *re
             proxy = mProxy;
             iMem = mCblkMemory;
 
+            checkScheduledStop_l();
+
             if (mState == STATE_STOPPING) {
                 status = -EINTR;
                 buffer.mFrameCount = 0;
@@ -1544,6 +1626,9 @@ nsecs_t AudioTrack::processAudioBuffer()
         }
     }
 
+    // the callback thread pauses below if the track was stopped at its stop time
+    checkScheduledStop_l();
+
     bool waitStreamEnd = mState == STATE_STOPPING;
     bool active = mState == STATE_ACTIVE;
 
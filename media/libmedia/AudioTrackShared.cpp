@@ -30,6 +30,7 @@ audio_track_cblk_t::audio_track_cblk_t()
     mVolumeLR(GAIN_MINIFLOAT_PACKED_UNITY), mSampleRate(0), mSendLevel(0), mFlags(0)
 {
     memset(&u, 0, sizeof(u));
+    memset(&mParameterQueue, 0, sizeof(mParameterQueue));
 }
 
 // ---------------------------------------------------------------------------
@@ -346,6 +347,46 @@ size_t ClientProxy::getFramesFilled() {
 
 // ---------------------------------------------------------------------------
 
+AudioTrackClientProxy::AudioTrackClientProxy(audio_track_cblk_t* cblk, void *buffers,
+        size_t frameCount, size_t frameSize, bool clientInServer)
+    : ClientProxy(cblk, buffers, frameCount, frameSize, true /*isOut*/, clientInServer),
+      mParameterMutator(&cblk->mParameterQueue), mParameterBatch(false), mParameterQueued(false)
+{
+    mParameters.mVolumeLR = cblk->mVolumeLR;
+    mParameters.mSampleRate = cblk->mSampleRate;
+    mParameters.mSendLevel = cblk->mSendLevel;
+    mParameters.mPad = 0;
+}
+
+void AudioTrackClientProxy::setParameterBatch(bool batch)
+{
+    if (mParameterBatch == batch) {
+        return;
+    }
+    mParameterBatch = batch;
+    if (!batch) {
+        // from now on the server owns the parameter fields of the control block
+        mParameterQueued = true;
+        updateParameters();
+    }
+}
+
+void AudioTrackClientProxy::updateParameters()
+{
+    if (mParameterBatch) {
+        return;
+    }
+    if (mParameterQueued) {
+        // Once a batch has been pushed, single updates also go through the queue. Otherwise a
+        // batch not yet observed by the server could overwrite a more recent direct update.
+        (void) mParameterMutator.push(mParameters);
+        return;
+    }
+    mCblk->mVolumeLR = mParameters.mVolumeLR;
+    mCblk->mSampleRate = mParameters.mSampleRate;
+    mCblk->mSendLevel = mParameters.mSendLevel;
+}
+
 void AudioTrackClientProxy::flush()
 {
     mCblk->u.mStreaming.mFlush++;
@@ -685,6 +726,20 @@ size_t AudioTrackServerProxy::framesReady()
     return filled;
 }
 
+bool AudioTrackServerProxy::pollParameters()
+{
+    AudioTrackParameterState parameters;
+    if (!mParameterObserver.poll(parameters)) {
+        return false;
+    }
+    // the values come from shared memory, so callers of the getters keep validating them
+    audio_track_cblk_t* cblk = mCblk;
+    cblk->mVolumeLR = parameters.mVolumeLR;
+    cblk->mSampleRate = parameters.mSampleRate;
+    cblk->mSendLevel = parameters.mSendLevel;
+    return true;
+}
+
 bool  AudioTrackServerProxy::setStreamEndDone() {
     audio_track_cblk_t* cblk = mCblk;
     bool old =
@@ -42,6 +42,8 @@ enum {
     SET_PARAMETERS,
     GET_TIMESTAMP,
     SIGNAL,
+    SET_START_TIME,
+    SET_STOP_TIME,
 };
 
 class BpAudioTrack : public BpInterface<IAudioTrack>
@@ -195,6 +197,28 @@ public:
         data.writeInterfaceToken(IAudioTrack::getInterfaceDescriptor());
         remote()->transact(SIGNAL, data, &reply);
     }
+
+    virtual status_t setStartTime(int64_t presentationTimeNs) {
+        Parcel data, reply;
+        data.writeInterfaceToken(IAudioTrack::getInterfaceDescriptor());
+        data.writeInt64(presentationTimeNs);
+        status_t status = remote()->transact(SET_START_TIME, data, &reply);
+        if (status == NO_ERROR) {
+            status = reply.readInt32();
+        }
+        return status;
+    }
+
+    virtual status_t setStopTime(int64_t presentationTimeNs) {
+        Parcel data, reply;
+        data.writeInterfaceToken(IAudioTrack::getInterfaceDescriptor());
+        data.writeInt64(presentationTimeNs);
+        status_t status = remote()->transact(SET_STOP_TIME, data, &reply);
+        if (status == NO_ERROR) {
+            status = reply.readInt32();
+        }
+        return status;
+    }
 };
 
 IMPLEMENT_META_INTERFACE(AudioTrack, "android.media.IAudioTrack");
@@ -287,6 +311,16 @@ status_t BnAudioTrack::onTransact(
             signal();
             return NO_ERROR;
         } break;
+        case SET_START_TIME: {
+            CHECK_INTERFACE(IAudioTrack, data, reply);
+            reply->writeInt32(setStartTime(data.readInt64()));
+            return NO_ERROR;
+        } break;
+        case SET_STOP_TIME: {
+            CHECK_INTERFACE(IAudioTrack, data, reply);
+            reply->writeInt32(setStopTime(data.readInt64()));
+            return NO_ERROR;
+        } break;
         default:
             return BBinder::onTransact(code, data, reply, flags);
     }
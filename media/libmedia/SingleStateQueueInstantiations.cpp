@@ -16,6 +16,7 @@
 
 #include <media/SingleStateQueue.h>
 #include <private/media/StaticAudioTrackState.h>
+#include <private/media/AudioTrackParameterState.h>
 #include <media/AudioTimestamp.h>
 
 // FIXME hack for gcc
@@ -24,5 +25,7 @@ namespace android {
 
 template class SingleStateQueue<StaticAudioTrackState>; // typedef StaticAudioTrackSingleStateQueue
 template class SingleStateQueue<AudioTimestamp>;        // typedef AudioTimestampSingleStateQueue
+template class SingleStateQueue<AudioTrackParameterState>;
+                                            // typedef AudioTrackParameterSingleStateQueue
 
 }
@@ -28,6 +28,7 @@
 #include <media/mediaplayer.h>
 #include <media/SoundPool.h>
 #include "SoundPoolThread.h"
+#include "SoundPoolSampleCache.h"
 #include <media/AudioPolicyHelper.h>
 
 namespace android
@@ -203,32 +204,32 @@ SoundChannel* SoundPool::findNextChannel(int channelID)
     return NULL;
 }
 
-int SoundPool::load(const char* path, int priority __unused)
+int SoundPool::load(const char* path, int priority)
 {
     ALOGV("load: path=%s, priority=%d", path, priority);
     Mutex::Autolock lock(&mLock);
     sp<Sample> sample = new Sample(++mNextSampleID, path);
     mSamples.add(sample->sampleID(), sample);
-    doLoad(sample);
+    doLoad(sample, priority);
     return sample->sampleID();
 }
 
-int SoundPool::load(int fd, int64_t offset, int64_t length, int priority __unused)
+int SoundPool::load(int fd, int64_t offset, int64_t length, int priority)
 {
     ALOGV("load: fd=%d, offset=%" PRId64 ", length=%" PRId64 ", priority=%d",
             fd, offset, length, priority);
     Mutex::Autolock lock(&mLock);
     sp<Sample> sample = new Sample(++mNextSampleID, fd, offset, length);
     mSamples.add(sample->sampleID(), sample);
-    doLoad(sample);
+    doLoad(sample, priority);
     return sample->sampleID();
 }
 
-void SoundPool::doLoad(sp<Sample>& sample)
+void SoundPool::doLoad(sp<Sample>& sample, int priority)
 {
     ALOGV("doLoad: loading sample sampleID=%d", sample->sampleID());
     sample->startLoad();
-    mDecodeThread->loadSample(sample->sampleID());
+    mDecodeThread->loadSample(sample->sampleID(), priority);
 }
 
 bool SoundPool::unload(int sampleID)
@@ -262,7 +263,7 @@ int SoundPool::play(int sampleID, float leftVolume, float rightVolume,
     dump();
 
     // allocate a channel
-    channel = allocateChannel_l(priority);
+    channel = allocateChannel_l(priority, sampleID);
 
     // no channel allocated - return 0
     if (!channel) {
@@ -277,7 +278,7 @@ int SoundPool::play(int sampleID, float leftVolume, float rightVolume,
     return channelID;
 }
 
-SoundChannel* SoundPool::allocateChannel_l(int priority)
+SoundChannel* SoundPool::allocateChannel_l(int priority, int sampleID)
 {
     List<SoundChannel*>::iterator iter;
     SoundChannel* channel = NULL;
@@ -286,6 +287,15 @@ SoundChannel* SoundPool::allocateChannel_l(int priority)
     if (!mChannels.empty()) {
         iter = mChannels.begin();
         if (priority >= (*iter)->priority()) {
+            // among the idle channels at the front, prefer one whose track last played this
+            // sample so that its track can be reused
+            for (List<SoundChannel*>::iterator idle = iter;
+                    idle != mChannels.end() && (*idle)->priority() == IDLE_PRIORITY; ++idle) {
+                if ((*idle)->prevSampleID() == sampleID) {
+                    iter = idle;
+                    break;
+                }
+            }
             channel = *iter;
             mChannels.erase(iter);
             ALOGV("Allocated active channel");
@@ -497,28 +507,53 @@ status_t Sample::doLoad()
     int numChannels;
     audio_format_t format;
     status_t status;
-    mHeap = new MemoryHeapBase(kDefaultHeapSize);
+    SoundPoolSampleCache::Key cacheKey;
+    bool cacheable;
+    SoundPoolSampleCache::Entry cached;
 
-    ALOGV("Start decode");
+    // the key is obtained before decoding as the decoder consumes the file descriptor
     if (mUrl) {
-        status = MediaPlayer::decode(
-                NULL /* httpService */,
-                mUrl,
-                &sampleRate,
-                &numChannels,
-                &format,
-                mHeap,
-                &mSize);
+        cacheable = SoundPoolSampleCache::keyForPath(mUrl, &cacheKey);
     } else {
-        status = MediaPlayer::decode(mFd, mOffset, mLength, &sampleRate, &numChannels, &format,
-                                     mHeap, &mSize);
-        ALOGV("close(%d)", mFd);
-        ::close(mFd);
-        mFd = -1;
-    }
-    if (status != NO_ERROR) {
-        ALOGE("Unable to load sample: %s", mUrl);
-        goto error;
+        cacheable = SoundPoolSampleCache::keyForFd(mFd, mOffset, mLength, &cacheKey);
+    }
+    if (cacheable && SoundPoolSampleCache::lookup(cacheKey, &cached)) {
+        ALOGV("Using cached PCM for sample %d", mSampleID);
+        if (mFd >= 0) {
+            ALOGV("close(%d)", mFd);
+            ::close(mFd);
+            mFd = -1;
+        }
+        mHeap = cached.mHeap;
+        mSize = cached.mSize;
+        sampleRate = cached.mSampleRate;
+        numChannels = cached.mNumChannels;
+        format = cached.mFormat;
+        status = NO_ERROR;
+    } else {
+        mHeap = new MemoryHeapBase(kDefaultHeapSize);
+
+        ALOGV("Start decode");
+        if (mUrl) {
+            status = MediaPlayer::decode(
+                    NULL /* httpService */,
+                    mUrl,
+                    &sampleRate,
+                    &numChannels,
+                    &format,
+                    mHeap,
+                    &mSize);
+        } else {
+            status = MediaPlayer::decode(mFd, mOffset, mLength, &sampleRate, &numChannels,
+                                         &format, mHeap, &mSize);
+            ALOGV("close(%d)", mFd);
+            ::close(mFd);
+            mFd = -1;
+        }
+        if (status != NO_ERROR) {
+            ALOGE("Unable to load sample: %s", mUrl);
+            goto error;
+        }
     }
     ALOGV("pointer = %p, size = %zu, sampleRate = %u, numChannels = %d",
           mHeap->getBase(), mSize, sampleRate, numChannels);
@@ -535,7 +570,19 @@ status_t Sample::doLoad()
         goto error;
     }
 
-    mData = new MemoryBase(mHeap, 0, mSize);
+    if (cached.mHeap != 0) {
+        mData = new MemoryBase(mHeap, cached.mOffset, mSize);
+    } else {
+        mData = new MemoryBase(mHeap, 0, mSize);
+        if (cacheable) {
+            cached.mHeap = mHeap;
+            cached.mSize = mSize;
+            cached.mSampleRate = sampleRate;
+            cached.mNumChannels = numChannels;
+            cached.mFormat = format;
+            SoundPoolSampleCache::insert(cacheKey, cached);
+        }
+    }
     mSampleRate = sampleRate;
     mNumChannels = numChannels;
     mFormat = format;
@@ -616,18 +663,37 @@ void SoundChannel::play(const sp<Sample>& sample, int nextChannelID, float leftV
 
         // do not create a new audio track if current track is compatible with sample parameters
 #ifdef USE_SHARED_MEM_BUFFER
-        newTrack = new AudioTrack(streamType, sampleRate, sample->format(),
-                channelMask, sample->getIMemory(), AUDIO_OUTPUT_FLAG_FAST, callback, userData);
+        // the track of the previous play has the same format and shared buffer if it played the
+        // same sample, so only the rate may differ. stop() leaves a static track at its end, the
+        // setLoop(0, frameCount, loop) below rewinds it.
+        // A fast track is mixed by the FastMixer without resampling, so its rate can't change:
+        // setSampleRate() would succeed but the sample would still play at the original rate.
+        if (mAudioTrack != 0 && mPrevSampleID == sample->sampleID() &&
+                (sampleRate == mAudioTrack->getSampleRate() ||
+                 (mAudioTrack->getFlags() & AUDIO_OUTPUT_FLAG_FAST) == 0) &&
+                mAudioTrack->setSampleRate(sampleRate) == NO_ERROR) {
+            ALOGV("reusing track %p for sample %d", mAudioTrack.get(), sample->sampleID());
+            newTrack = mAudioTrack;
+            toggle = mToggle;
+        } else {
+            newTrack = new AudioTrack(streamType, sampleRate, sample->format(),
+                    channelMask, sample->getIMemory(), AUDIO_OUTPUT_FLAG_FAST, callback,
+                    userData);
+        }
 #else
         newTrack = new AudioTrack(streamType, sampleRate, sample->format(),
                 channelMask, frameCount, AUDIO_OUTPUT_FLAG_FAST, callback, userData,
                 bufferFrames);
 #endif
-        oldTrack = mAudioTrack;
-        status = newTrack->initCheck();
-        if (status != NO_ERROR) {
-            ALOGE("Error creating AudioTrack");
-            goto exit;
+        if (newTrack != mAudioTrack) {
+            oldTrack = mAudioTrack;
+            status = newTrack->initCheck();
+            if (status != NO_ERROR) {
+                ALOGE("Error creating AudioTrack");
+                goto exit;
+            }
+        } else {
+            status = NO_ERROR;
         }
         ALOGV("setVolume %p", newTrack.get());
         newTrack->setVolume(leftVolume, rightVolume);
@@ -777,6 +843,7 @@ bool SoundChannel::doStop_l()
         setVolume_l(0, 0);
         ALOGV("stop");
         mAudioTrack->stop();
+        mPrevSampleID = mSample->sampleID();
         mSample.clear();
         mState = IDLE;
         mPriority = IDLE_PRIORITY;
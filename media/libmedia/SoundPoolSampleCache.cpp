@@ -0,0 +1,286 @@
+/*
+ * Copyright (C) 2015 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+//#define LOG_NDEBUG 0
+#define LOG_TAG "SoundPoolSampleCache"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <inttypes.h>
+#include <limits.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <cutils/properties.h>
+#include <utils/Errors.h>
+#include <utils/Log.h>
+
+#include "SoundPoolSampleCache.h"
+
+namespace android {
+
+namespace {
+
+const uint32_t kMagic = 0x4d435053;     // "SPCM"
+const uint32_t kVersion = 2;
+
+// layout of a cache file, followed by the PCM
+struct Header {
+    uint32_t    mMagic;
+    uint32_t    mVersion;
+    SoundPoolSampleCache::Key mKey;
+    uint32_t    mSampleRate;
+    uint32_t    mNumChannels;
+    uint32_t    mFormat;
+    uint32_t    mSize;
+};
+
+// Whether a cache file or directory can be trusted: it is owned by our uid, and nobody else
+// can write it.
+bool isPrivate(const struct stat& st)
+{
+    return st.st_uid == getuid() && (st.st_mode & (S_IWGRP | S_IWOTH)) == 0;
+}
+
+// Gets the cache subdirectory of our uid, creating it if 'create' is set.
+bool getCacheDir(char *dir, size_t size, bool create)
+{
+    char root[PROPERTY_VALUE_MAX];
+    if (property_get("media.soundpool.cache_dir", root, "") <= 0) {
+        return false;
+    }
+    snprintf(dir, size, "%s/%u", root, getuid());
+    if (create && mkdir(dir, 0700) != 0 && errno != EEXIST) {
+        ALOGW("getCacheDir() cannot create %s: %s", dir, strerror(errno));
+        return false;
+    }
+    struct stat st;
+    if (lstat(dir, &st) != 0) {
+        return false;
+    }
+    if (!S_ISDIR(st.st_mode) || !isPrivate(st)) {
+        ALOGW("getCacheDir() ignoring %s, not a private directory", dir);
+        return false;
+    }
+    return true;
+}
+
+void getCachePath(const char *dir, const SoundPoolSampleCache::Key& key, char *path, size_t size)
+{
+    // FNV-1a of the key, which the header of the file holds in full
+    const uint8_t *bytes = (const uint8_t *) &key;
+    uint64_t h = 14695981039346656037ull;
+    for (size_t i = 0; i < sizeof(key); i++) {
+        h = (h ^ bytes[i]) * 1099511628211ull;
+    }
+    snprintf(path, size, "%s/%016" PRIx64 ".pcm", dir, h);
+}
+
+} // namespace
+
+Mutex SoundPoolSampleCache::gLock;
+KeyedVector<SoundPoolSampleCache::Key, SoundPoolSampleCache::MemoryEntry>
+        SoundPoolSampleCache::gEntries;
+
+/*static*/
+bool SoundPoolSampleCache::keyForFd(int fd, int64_t offset, int64_t length, Key *key)
+{
+    struct stat st;
+    if (fd < 0 || offset < 0 || length <= 0 || fstat(fd, &st) != 0 || !S_ISREG(st.st_mode) ||
+            offset > st.st_size || length > st.st_size - offset) {
+        return false;
+    }
+    memset(key, 0, sizeof(*key));
+    key->mDevice = st.st_dev;
+    key->mInode = st.st_ino;
+    key->mFileSize = st.st_size;
+    key->mModifiedSec = st.st_mtime;
+    key->mChangedSec = st.st_ctime;
+    key->mOffset = offset;
+    key->mLength = length;
+    return true;
+}
+
+/*static*/
+bool SoundPoolSampleCache::keyForPath(const char *path, Key *key)
+{
+    int fd = open(path, O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+        return false;
+    }
+    struct stat st;
+    bool ok = fstat(fd, &st) == 0 && keyForFd(fd, 0, st.st_size, key);
+    close(fd);
+    return ok;
+}
+
+/*static*/
+bool SoundPoolSampleCache::lookup(const Key& key, Entry *entry)
+{
+    {
+        Mutex::Autolock _l(gLock);
+        ssize_t index = gEntries.indexOfKey(key);
+        if (index >= 0) {
+            const MemoryEntry& cached = gEntries.valueAt(index);
+            entry->mHeap = cached.mHeap.promote();
+            if (entry->mHeap != 0) {
+                entry->mOffset = cached.mOffset;
+                entry->mSize = cached.mSize;
+                entry->mSampleRate = cached.mSampleRate;
+                entry->mNumChannels = cached.mNumChannels;
+                entry->mFormat = cached.mFormat;
+                ALOGV("lookup() found in memory");
+                return true;
+            }
+            gEntries.removeItemsAt(index);
+        }
+    }
+
+    // the file is mapped without the lock held, a concurrent load of the same source at worst
+    // maps it twice
+    if (!lookupFile(key, entry)) {
+        return false;
+    }
+    Mutex::Autolock _l(gLock);
+    register_l(key, *entry);
+    return true;
+}
+
+/*static*/
+bool SoundPoolSampleCache::lookupFile(const Key& key, Entry *entry)
+{
+    char dir[PATH_MAX];
+    if (!getCacheDir(dir, sizeof(dir), false /*create*/)) {
+        return false;
+    }
+    char path[PATH_MAX];
+    getCachePath(dir, key, path, sizeof(path));
+    int fd = open(path, O_RDONLY | O_CLOEXEC | O_NOFOLLOW);
+    if (fd < 0) {
+        return false;
+    }
+    Header header;
+    struct stat st;
+    if (fstat(fd, &st) != 0 || !S_ISREG(st.st_mode) || !isPrivate(st) ||
+            st.st_size < (off_t) sizeof(Header) ||
+            pread(fd, &header, sizeof(header), 0) != (ssize_t) sizeof(header) ||
+            header.mMagic != kMagic || header.mVersion != kVersion || !(header.mKey == key) ||
+            header.mSize == 0 || (off_t) header.mSize != st.st_size - (off_t) sizeof(Header)) {
+        ALOGW("lookupFile() ignoring malformed %s", path);
+        close(fd);
+        return false;
+    }
+    // MemoryHeapBase keeps its own duplicate of the descriptor
+    sp<MemoryHeapBase> heap = new MemoryHeapBase(fd, st.st_size, MemoryHeapBase::READ_ONLY);
+    close(fd);
+    if (heap->getHeapID() < 0 || heap->getBase() == MAP_FAILED) {
+        ALOGW("lookupFile() cannot map %s", path);
+        return false;
+    }
+    entry->mHeap = heap;
+    entry->mOffset = sizeof(Header);
+    entry->mSize = header.mSize;
+    entry->mSampleRate = header.mSampleRate;
+    entry->mNumChannels = header.mNumChannels;
+    entry->mFormat = (audio_format_t) header.mFormat;
+    ALOGV("lookupFile() mapped %s, %zu bytes", path, entry->mSize);
+    return true;
+}
+
+/*static*/
+void SoundPoolSampleCache::insert(const Key& key, const Entry& entry)
+{
+    {
+        Mutex::Autolock _l(gLock);
+        register_l(key, entry);
+    }
+    store(key, entry);
+}
+
+/*static*/
+void SoundPoolSampleCache::register_l(const Key& key, const Entry& entry)
+{
+    // drop the entries of heaps that are gone
+    for (size_t i = gEntries.size(); i > 0; ) {
+        i--;
+        if (gEntries.valueAt(i).mHeap.promote() == 0) {
+            gEntries.removeItemsAt(i);
+        }
+    }
+    MemoryEntry cached;
+    cached.mHeap = entry.mHeap;
+    cached.mOffset = entry.mOffset;
+    cached.mSize = entry.mSize;
+    cached.mSampleRate = entry.mSampleRate;
+    cached.mNumChannels = entry.mNumChannels;
+    cached.mFormat = entry.mFormat;
+    gEntries.add(key, cached);
+}
+
+/*static*/
+void SoundPoolSampleCache::store(const Key& key, const Entry& entry)
+{
+    char dir[PATH_MAX];
+    if (entry.mSize > 0xFFFFFFFF || !getCacheDir(dir, sizeof(dir), true /*create*/)) {
+        return;
+    }
+    char path[PATH_MAX];
+    getCachePath(dir, key, path, sizeof(path));
+    if (access(path, F_OK) == 0) {
+        return;
+    }
+
+    Header header;
+    memset(&header, 0, sizeof(header));
+    header.mMagic = kMagic;
+    header.mVersion = kVersion;
+    header.mKey = key;
+    header.mSampleRate = entry.mSampleRate;
+    header.mNumChannels = entry.mNumChannels;
+    header.mFormat = entry.mFormat;
+    header.mSize = entry.mSize;
+    const uint8_t *data = (const uint8_t *) entry.mHeap->getBase() + entry.mOffset;
+
+    // write to a temporary file first so that another process of the uid never maps a partial file
+    char tmpPath[PATH_MAX];
+    snprintf(tmpPath, sizeof(tmpPath), "%s.%d.tmp", path, getpid());
+    status_t status = NO_ERROR;
+    int fd = open(tmpPath, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC | O_NOFOLLOW, 0600);
+    if (fd < 0) {
+        status = -errno;
+    } else {
+        errno = 0;
+        if (write(fd, &header, sizeof(header)) != (ssize_t) sizeof(header) ||
+                write(fd, data, entry.mSize) != (ssize_t) entry.mSize) {
+            status = errno != 0 ? -errno : NOT_ENOUGH_DATA;
+        }
+        if (close(fd) != 0 && status == NO_ERROR) {
+            status = -errno;
+        }
+        if (status == NO_ERROR && rename(tmpPath, path) != 0) {
+            status = -errno;
+        }
+        if (status != NO_ERROR) {
+            unlink(tmpPath);
+        }
+    }
+    ALOGW_IF(status != NO_ERROR, "store() could not write %s: %d", path, status);
+}
+
+} // end namespace android
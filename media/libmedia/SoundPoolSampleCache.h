@@ -0,0 +1,100 @@
+/*
+ * Copyright (C) 2015 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef SOUNDPOOLSAMPLECACHE_H_
+#define SOUNDPOOLSAMPLECACHE_H_
+
+#include <stdint.h>
+#include <string.h>
+#include <sys/types.h>
+#include <system/audio.h>
+#include <utils/KeyedVector.h>
+#include <utils/threads.h>
+#include <binder/MemoryHeapBase.h>
+
+namespace android {
+
+// Decoded PCM of SoundPool samples, indexed by the identity of the encoded source file.
+//
+// Entries are shared by all SoundPools of a process for as long as one of them holds the heap.
+// When the property media.soundpool.cache_dir names a directory writable by the process, the
+// decoded PCM is also stored in a subdirectory private to the uid of the process, one file per
+// source, and later loads by that uid map these files read-only instead of decoding again.
+// Files and subdirectories not owned by the uid, or writable by others, are ignored, so a process
+// only ever maps PCM decoded by its own uid. The mappings are backed by the page cache, so the
+// processes of a uid loading the same clip share its memory, and so does the audio server when the
+// heap is used as the shared buffer of a static AudioTrack.
+class SoundPoolSampleCache {
+public:
+    struct Entry {
+        Entry() : mOffset(0), mSize(0), mSampleRate(0), mNumChannels(0),
+                mFormat(AUDIO_FORMAT_INVALID) {}
+        sp<MemoryHeapBase>  mHeap;
+        size_t              mOffset;    // of the PCM within mHeap
+        size_t              mSize;
+        uint32_t            mSampleRate;
+        int                 mNumChannels;
+        audio_format_t      mFormat;
+    };
+
+    // Key of an encoded source: the file it is read from, the status change time of the file, and
+    // the range of the source in the file. Only the file status is read, not its content.
+    // All the fields are 64 bits wide so that there is no padding to compare.
+    struct Key {
+        uint64_t    mDevice;
+        uint64_t    mInode;
+        int64_t     mFileSize;
+        int64_t     mModifiedSec;
+        int64_t     mChangedSec;
+        int64_t     mOffset;
+        int64_t     mLength;
+
+        bool operator<(const Key& other) const { return memcmp(this, &other, sizeof(Key)) < 0; }
+        bool operator==(const Key& other) const { return memcmp(this, &other, sizeof(Key)) == 0; }
+    };
+
+    // Returns false if the source is not a regular file, e.g. a network URL, in which case the
+    // sample is not cached.
+    static bool keyForFd(int fd, int64_t offset, int64_t length, Key *key);
+    static bool keyForPath(const char *path, Key *key);
+
+    // Fills 'entry' and returns true if the PCM for 'key' is in memory or on disk.
+    static bool lookup(const Key& key, Entry *entry);
+
+    // Registers freshly decoded PCM, and stores it on disk if a cache directory is configured.
+    static void insert(const Key& key, const Entry& entry);
+
+private:
+    struct MemoryEntry {
+        wp<MemoryHeapBase>  mHeap;
+        size_t              mOffset;
+        size_t              mSize;
+        uint32_t            mSampleRate;
+        int                 mNumChannels;
+        audio_format_t      mFormat;
+    };
+
+    static bool lookupFile(const Key& key, Entry *entry);
+    static void store(const Key& key, const Entry& entry);
+    static void register_l(const Key& key, const Entry& entry);
+
+    static Mutex                                    gLock;
+    static KeyedVector<Key, MemoryEntry>            gEntries;
+};
+
+} // end namespace android
+
+#endif /*SOUNDPOOLSAMPLECACHE_H_*/
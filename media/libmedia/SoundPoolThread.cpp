@@ -18,53 +18,68 @@
 #define LOG_TAG "SoundPoolThread"
 #include "utils/Log.h"
 
+#include <unistd.h>
+
 #include "SoundPoolThread.h"
 
 namespace android {
 
 void SoundPoolThread::write(SoundPoolMsg msg) {
     Mutex::Autolock lock(&mLock);
-    while (mMsgQueue.size() >= maxMessages) {
-        mCondition.wait(mLock);
-    }
 
     // if thread is quitting, don't add to queue
     if (mRunning) {
-        mMsgQueue.push(msg);
+        // after the messages of higher or equal priority
+        size_t index = mMsgQueue.size();
+        while (index > 0 && mMsgQueue[index - 1].mPriority < msg.mPriority) {
+            index--;
+        }
+        mMsgQueue.insertAt(msg, index);
         mCondition.signal();
     }
 }
 
 const SoundPoolMsg SoundPoolThread::read() {
     Mutex::Autolock lock(&mLock);
-    while (mMsgQueue.size() == 0) {
+    while (mRunning && mMsgQueue.size() == 0) {
         mCondition.wait(mLock);
     }
+    if (!mRunning) {
+        return SoundPoolMsg(SoundPoolMsg::KILL, 0);
+    }
     SoundPoolMsg msg = mMsgQueue[0];
     mMsgQueue.removeAt(0);
-    mCondition.signal();
     return msg;
 }
 
 void SoundPoolThread::quit() {
     Mutex::Autolock lock(&mLock);
-    if (mRunning) {
-        mRunning = false;
-        mMsgQueue.clear();
-        mMsgQueue.push(SoundPoolMsg(SoundPoolMsg::KILL, 0));
-        mCondition.signal();
+    mRunning = false;
+    mMsgQueue.clear();
+    mCondition.broadcast();
+    // wait for the loads in progress
+    while (mNumThreads > 0) {
         mCondition.wait(mLock);
     }
     ALOGV("return from quit");
 }
 
 SoundPoolThread::SoundPoolThread(SoundPool* soundPool) :
-    mSoundPool(soundPool)
+    mSoundPool(soundPool), mRunning(true), mNumThreads(0)
 {
-    mMsgQueue.setCapacity(maxMessages);
-    if (createThreadEtc(beginThread, this, "SoundPoolThread")) {
-        mRunning = true;
+    long numCpus = sysconf(_SC_NPROCESSORS_ONLN);
+    int numThreads = numCpus < 1 ? 1 : numCpus > kMaxThreads ? kMaxThreads : (int) numCpus;
+
+    // the threads wait for the lock until they are all accounted for
+    Mutex::Autolock lock(&mLock);
+    for (int i = 0; i < numThreads; i++) {
+        if (!createThreadEtc(beginThread, this, "SoundPoolThread")) {
+            break;
+        }
+        mNumThreads++;
     }
+    ALOGV("%d decode threads", mNumThreads);
+    mRunning = mNumThreads > 0;
 }
 
 SoundPoolThread::~SoundPoolThread()
@@ -84,9 +99,13 @@ int SoundPoolThread::run() {
         SoundPoolMsg msg = read();
         ALOGV("Got message m=%d, mData=%d", msg.mMessageType, msg.mData);
         switch (msg.mMessageType) {
-        case SoundPoolMsg::KILL:
+        case SoundPoolMsg::KILL: {
             ALOGV("goodbye");
+            Mutex::Autolock lock(&mLock);
+            mNumThreads--;
+            mCondition.broadcast();
             return NO_ERROR;
+        }
         case SoundPoolMsg::LOAD_SAMPLE:
             doLoadSample(msg.mData);
             break;
@@ -98,12 +117,17 @@ int SoundPoolThread::run() {
     }
 }
 
-void SoundPoolThread::loadSample(int sampleID) {
-    write(SoundPoolMsg(SoundPoolMsg::LOAD_SAMPLE, sampleID));
+void SoundPoolThread::loadSample(int sampleID, int priority) {
+    write(SoundPoolMsg(SoundPoolMsg::LOAD_SAMPLE, sampleID, priority));
 }
 
 void SoundPoolThread::doLoadSample(int sampleID) {
-    sp <Sample> sample = mSoundPool->findSample(sampleID);
+    sp <Sample> sample;
+    {
+        // samples are added and removed by the application threads
+        Mutex::Autolock lock(&mSoundPool->mLock);
+        sample = mSoundPool->findSample(sampleID);
+    }
     status_t status = -1;
     if (sample != 0) {
         status = sample->doLoad();
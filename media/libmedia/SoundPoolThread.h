@@ -28,26 +28,31 @@ namespace android {
 class SoundPoolMsg {
 public:
     enum MessageType { INVALID, KILL, LOAD_SAMPLE };
-    SoundPoolMsg() : mMessageType(INVALID), mData(0) {}
-    SoundPoolMsg(MessageType MessageType, int data) :
-        mMessageType(MessageType), mData(data) {}
+    SoundPoolMsg() : mMessageType(INVALID), mData(0), mPriority(0) {}
+    SoundPoolMsg(MessageType MessageType, int data, int priority = 0) :
+        mMessageType(MessageType), mData(data), mPriority(priority) {}
     uint16_t         mMessageType;
     uint16_t         mData;
+    int              mPriority;
 };
 
 /*
- * This class handles background requests from the SoundPool
+ * This class handles background requests from the SoundPool.
+ * Samples are decoded by a small pool of threads, highest load priority first and in request
+ * order for equal priorities.
  */
 class SoundPoolThread {
 public:
     SoundPoolThread(SoundPool* SoundPool);
     ~SoundPoolThread();
-    void loadSample(int sampleID);
+    void loadSample(int sampleID, int priority);
     void quit();
     void write(SoundPoolMsg msg);
 
 private:
-    static const size_t maxMessages = 5;
+    // upper bound of the number of decode threads, the actual number is also limited by the
+    // number of cores
+    static const int kMaxThreads = 4;
 
     static int beginThread(void* arg);
     int run();
@@ -56,9 +61,10 @@ private:
 
     Mutex                   mLock;
     Condition               mCondition;
-    Vector<SoundPoolMsg>    mMsgQueue;
+    Vector<SoundPoolMsg>    mMsgQueue;      // ordered by decreasing priority
     SoundPool*              mSoundPool;
     bool                    mRunning;
+    int                     mNumThreads;    // decode threads still running
 };
 
 } // end namespace android
@@ -22,6 +22,13 @@
 #include <cutils/properties.h>
 #include "media/ToneGenerator.h"
 
+#if defined(__ARM_NEON__)
+#define USE_NEON (true)
+#include <arm_neon.h>
+#else
+#define USE_NEON (false)
+#endif
+
 
 namespace android {
 
@@ -1042,13 +1049,13 @@ void ToneGenerator::stopTone() {
 ////////////////////////////////////////////////////////////////////////////////
 bool ToneGenerator::initAudioTrack() {
 
-    // Open audio track in mono, PCM 16bit, default sampling rate, default buffer size
+    // Open audio track in mono, PCM float, default sampling rate, default buffer size
     mpAudioTrack = new AudioTrack();
     ALOGV("Create Track: %p", mpAudioTrack.get());
 
     mpAudioTrack->set(mStreamType,
                       0,    // sampleRate
-                      AUDIO_FORMAT_PCM_16_BIT,
+                      AUDIO_FORMAT_PCM_FLOAT,
                       AUDIO_CHANNEL_OUT_MONO,
                       0,    // frameCount
                       AUDIO_OUTPUT_FLAG_FAST,
@@ -1104,8 +1111,8 @@ void ToneGenerator::audioCallback(int event, void* user, void *info) {
 
     AudioTrack::Buffer *buffer = static_cast<AudioTrack::Buffer *>(info);
     ToneGenerator *lpToneGen = static_cast<ToneGenerator *>(user);
-    short *lpOut = buffer->i16;
-    unsigned int lNumSmp = buffer->size/sizeof(short);
+    float *lpOut = static_cast<float *>(buffer->raw);
+    unsigned int lNumSmp = buffer->size/sizeof(float);
     const ToneDescriptor *lpToneDesc = lpToneGen->mpToneDesc;
 
     if (buffer->size == 0) return;
@@ -1175,13 +1182,10 @@ void ToneGenerator::audioCallback(int event, void* user, void *info) {
             // If segment,  ON -> OFF transition : ramp volume down
             if (lpToneDesc->segments[lpToneGen->mCurSegment].waveFreq[0] != 0) {
                 lWaveCmd = WaveGenerator::WAVEGEN_STOP;
-                unsigned int lFreqIdx = 0;
-                unsigned short lFrequency = lpToneDesc->segments[lpToneGen->mCurSegment].waveFreq[lFreqIdx];
+                WaveGenerator **lppWaveGen = lpToneGen->mSegmentWaveGens[lpToneGen->mCurSegment];
 
-                while (lFrequency != 0) {
-                    WaveGenerator *lpWaveGen = lpToneGen->mWaveGens.valueFor(lFrequency);
-                    lpWaveGen->getSamples(lpOut, lGenSmp, lWaveCmd);
-                    lFrequency = lpToneDesc->segments[lpToneGen->mCurSegment].waveFreq[++lFreqIdx];
+                while (*lppWaveGen != NULL) {
+                    (*lppWaveGen++)->getSamples(lpOut, lGenSmp, lWaveCmd);
                 }
                 ALOGV("ON->OFF, lGenSmp: %d, lReqSmp: %d", lGenSmp, lReqSmp);
             }
@@ -1261,13 +1265,10 @@ void ToneGenerator::audioCallback(int event, void* user, void *info) {
 
         if (lGenSmp) {
             // If samples must be generated, call all active wave generators and acumulate waves in lpOut
-            unsigned int lFreqIdx = 0;
-            unsigned short lFrequency = lpToneDesc->segments[lpToneGen->mCurSegment].waveFreq[lFreqIdx];
+            WaveGenerator **lppWaveGen = lpToneGen->mSegmentWaveGens[lpToneGen->mCurSegment];
 
-            while (lFrequency != 0) {
-                WaveGenerator *lpWaveGen = lpToneGen->mWaveGens.valueFor(lFrequency);
-                lpWaveGen->getSamples(lpOut, lGenSmp, lWaveCmd);
-                lFrequency = lpToneDesc->segments[lpToneGen->mCurSegment].waveFreq[++lFreqIdx];
+            while (*lppWaveGen != NULL) {
+                (*lppWaveGen++)->getSamples(lpOut, lGenSmp, lWaveCmd);
             }
         }
 
@@ -1367,6 +1368,7 @@ bool ToneGenerator::prepareWave() {
         ALOGV("prepareWave, duration limited to %d ms", mDurationMs);
     }
 
+    memset(mSegmentWaveGens, 0, sizeof(mSegmentWaveGens));
     while (mpToneDesc->segments[segmentIdx].duration) {
         // Get total number of sine waves: needed to adapt sine wave gain.
         unsigned int lNumWaves = numWaves(segmentIdx);
@@ -1374,13 +1376,15 @@ bool ToneGenerator::prepareWave() {
         unsigned int frequency = mpToneDesc->segments[segmentIdx].waveFreq[freqIdx];
         while (frequency) {
             // Instantiate a wave generator if  ot already done for this frequency
-            if (mWaveGens.indexOfKey(frequency) == NAME_NOT_FOUND) {
+            ssize_t index = mWaveGens.indexOfKey(frequency);
+            if (index == NAME_NOT_FOUND) {
                 ToneGenerator::WaveGenerator *lpWaveGen =
                         new ToneGenerator::WaveGenerator((unsigned short)mSamplingRate,
                                 frequency,
                                 TONEGEN_GAIN/lNumWaves);
-                mWaveGens.add(frequency, lpWaveGen);
+                index = mWaveGens.add(frequency, lpWaveGen);
             }
+            mSegmentWaveGens[segmentIdx][freqIdx] = mWaveGens.valueAt(index);
             frequency = mpNewToneDesc->segments[segmentIdx].waveFreq[++freqIdx];
         }
         segmentIdx++;
@@ -1485,6 +1489,9 @@ ToneGenerator::tone_type ToneGenerator::getToneForRegion(tone_type toneType) {
 
 //---------------------------------- public methods ----------------------------
 
+// same peak level as the former Q15 generator limited to 32500
+const float ToneGenerator::WaveGenerator::kMaxAmplitude = 0.968f;
+
 ////////////////////////////////////////////////////////////////////////////////
 //
 //    Method:        WaveGenerator::WaveGenerator()
@@ -1502,27 +1509,23 @@ ToneGenerator::tone_type ToneGenerator::getToneForRegion(tone_type toneType) {
 ////////////////////////////////////////////////////////////////////////////////
 ToneGenerator::WaveGenerator::WaveGenerator(unsigned short samplingRate,
         unsigned short frequency, float volume) {
-    double d0;
     double F_div_Fs;  // frequency / samplingRate
 
     F_div_Fs = frequency / (double)samplingRate;
-    d0 = - (float)GEN_AMP * sin(2 * M_PI * F_div_Fs);
-    mS2_0 = (short)d0;
-    mS1 = 0;
-    mS2 = mS2_0;
+    for (unsigned int lane = 0; lane < kLanes; lane++) {
+        mRe0[lane] = mRe[lane] = (float)cos(2 * M_PI * F_div_Fs * lane);
+        mIm0[lane] = mIm[lane] = (float)sin(2 * M_PI * F_div_Fs * lane);
+    }
+    mRotRe = (float)cos(2 * M_PI * F_div_Fs * kLanes);
+    mRotIm = (float)sin(2 * M_PI * F_div_Fs * kLanes);
 
-    mAmplitude_Q15 = (short)(32767. * 32767. * volume / GEN_AMP);
+    mAmplitude = volume;
     // take some margin for amplitude fluctuation
-    if (mAmplitude_Q15 > 32500)
-        mAmplitude_Q15 = 32500;
-
-    d0 = 32768.0 * cos(2 * M_PI * F_div_Fs);  // Q14*2*cos()
-    if (d0 > 32767)
-        d0 = 32767;
-    mA1_Q14 = (short) d0;
+    if (mAmplitude > kMaxAmplitude)
+        mAmplitude = kMaxAmplitude;
 
-    ALOGV("WaveGenerator init, mA1_Q14: %d, mS2_0: %d, mAmplitude_Q15: %d",
-            mA1_Q14, mS2_0, mAmplitude_Q15);
+    ALOGV("WaveGenerator init, mRotRe: %f, mRotIm: %f, mAmplitude: %f",
+            mRotRe, mRotIm, mAmplitude);
 }
 
 ////////////////////////////////////////////////////////////////////////////////
@@ -1557,54 +1560,83 @@ ToneGenerator::WaveGenerator::~WaveGenerator() {
 //        none
 //
 ////////////////////////////////////////////////////////////////////////////////
-void ToneGenerator::WaveGenerator::getSamples(short *outBuffer,
+void ToneGenerator::WaveGenerator::getSamples(float *outBuffer,
         unsigned int count, unsigned int command) {
-    long lS1, lS2;
-    long lA1, lAmplitude;
-    long Sample;  // current sample
+    float lRe[kLanes], lIm[kLanes], lAmp[kLanes];
+    float lDec;
 
+    if (count == 0) {
+        return;
+    }
     // init local
     if (command == WAVEGEN_START) {
-        lS1 = (long)0;
-        lS2 = (long)mS2_0;
+        memcpy(lRe, mRe0, sizeof(lRe));
+        memcpy(lIm, mIm0, sizeof(lIm));
     } else {
-        lS1 = (long)mS1;
-        lS2 = (long)mS2;
+        memcpy(lRe, mRe, sizeof(lRe));
+        memcpy(lIm, mIm, sizeof(lIm));
+    }
+    // linear ramp down to 0 over the block when stopping
+    lDec = command == WAVEGEN_STOP ? mAmplitude / count : 0;
+    for (unsigned int lane = 0; lane < kLanes; lane++) {
+        lAmp[lane] = mAmplitude - lDec * lane;
     }
-    lA1 = (long)mA1_Q14;
-    lAmplitude = (long)mAmplitude_Q15;
 
-    if (command == WAVEGEN_STOP) {
-        lAmplitude <<= 16;
-        if (count == 0) {
-            return;
-        }
-        long dec = lAmplitude/count;
-        // loop generation
-        while (count--) {
-            Sample = ((lA1 * lS1) >> S_Q14) - lS2;
-            // shift delay
-            lS2 = lS1;
-            lS1 = Sample;
-            Sample = ((lAmplitude>>16) * Sample) >> S_Q15;
-            *(outBuffer++) += (short)Sample;  // put result in buffer
-            lAmplitude -= dec;
+    // loop generation, kLanes samples at a time
+    unsigned int lBlocks = count / kLanes;
+#if USE_NEON
+    float32x4_t vRe = vld1q_f32(lRe);
+    float32x4_t vIm = vld1q_f32(lIm);
+    float32x4_t vAmp = vld1q_f32(lAmp);
+    const float32x4_t vDec = vdupq_n_f32(lDec * kLanes);
+    for (; lBlocks; lBlocks--) {
+        vst1q_f32(outBuffer, vmlaq_f32(vld1q_f32(outBuffer), vIm, vAmp));
+        outBuffer += kLanes;
+        float32x4_t vNextRe = vmlsq_n_f32(vmulq_n_f32(vRe, mRotRe), vIm, mRotIm);
+        vIm = vmlaq_n_f32(vmulq_n_f32(vIm, mRotRe), vRe, mRotIm);
+        vRe = vNextRe;
+        vAmp = vsubq_f32(vAmp, vDec);
+    }
+    vst1q_f32(lRe, vRe);
+    vst1q_f32(lIm, vIm);
+    vst1q_f32(lAmp, vAmp);
+#else
+    for (; lBlocks; lBlocks--) {
+        for (unsigned int lane = 0; lane < kLanes; lane++) {
+            outBuffer[lane] += lIm[lane] * lAmp[lane];  // put result in buffer
+            float lNextRe = lRe[lane] * mRotRe - lIm[lane] * mRotIm;
+            lIm[lane] = lIm[lane] * mRotRe + lRe[lane] * mRotIm;
+            lRe[lane] = lNextRe;
+            lAmp[lane] -= lDec * kLanes;
         }
-    } else {
-        // loop generation
-        while (count--) {
-            Sample = ((lA1 * lS1) >> S_Q14) - lS2;
-            // shift delay
-            lS2 = lS1;
-            lS1 = Sample;
-            Sample = (lAmplitude * Sample) >> S_Q15;
-            *(outBuffer++) += (short)Sample;  // put result in buffer
+        outBuffer += kLanes;
+    }
+#endif
+
+    // remaining samples: the first lanes are consumed and the others become the first lanes of
+    // the next block
+    unsigned int lRemain = count % kLanes;
+    for (unsigned int lane = 0; lane < lRemain; lane++) {
+        outBuffer[lane] += lIm[lane] * lAmp[lane];
+    }
+    for (unsigned int lane = 0; lane < kLanes; lane++) {
+        unsigned int lSrc = lane + lRemain;
+        if (lSrc < kLanes) {
+            mRe[lane] = lRe[lSrc];
+            mIm[lane] = lIm[lSrc];
+        } else {
+            lSrc -= kLanes;
+            mRe[lane] = lRe[lSrc] * mRotRe - lIm[lSrc] * mRotIm;
+            mIm[lane] = lIm[lSrc] * mRotRe + lRe[lSrc] * mRotIm;
         }
     }
 
-    // save status
-    mS1 = (short)lS1;
-    mS2 = (short)lS2;
+    // save status, renormalized so that rounding errors do not accumulate across blocks
+    for (unsigned int lane = 0; lane < kLanes; lane++) {
+        float lGain = 1.5f - 0.5f * (mRe[lane] * mRe[lane] + mIm[lane] * mIm[lane]);
+        mRe[lane] *= lGain;
+        mIm[lane] *= lGain;
+    }
 }
 
 }  // end namespace android
@@ -44,6 +44,8 @@ Visualizer::Visualizer (int32_t priority,
         mSampleRate(44100000),
         mScalingMode(VISUALIZER_SCALING_MODE_NORMALIZED),
         mMeasurementMode(MEASUREMENT_MODE_NONE),
+        mFftWindow(VISUALIZER_FFT_WINDOW_RECTANGULAR),
+        mEffectFftSupported(true),
         mCaptureCallBack(NULL),
         mCaptureCbkUser(NULL)
 {
@@ -126,7 +128,7 @@ status_t Visualizer::setCaptureCallBack(capture_cbk_t cbk, void* user, uint32_t
 
 status_t Visualizer::setCaptureSize(uint32_t size)
 {
-    if (size > VISUALIZER_CAPTURE_SIZE_MAX ||
+    if (size > VISUALIZER_CAPTURE_SIZE_MAX_EXT ||
         size < VISUALIZER_CAPTURE_SIZE_MIN ||
         popcount(size) != 1) {
         return BAD_VALUE;
@@ -187,6 +189,36 @@ status_t Visualizer::setScalingMode(uint32_t mode) {
     return status;
 }
 
+status_t Visualizer::setFftWindow(uint32_t window) {
+    if (window >= VISUALIZER_FFT_WINDOW_CNT) {
+        return BAD_VALUE;
+    }
+
+    Mutex::Autolock _l(mCaptureLock);
+
+    uint32_t buf32[sizeof(effect_param_t) / sizeof(uint32_t) + 2];
+    effect_param_t *p = (effect_param_t *)buf32;
+
+    p->psize = sizeof(uint32_t);
+    p->vsize = sizeof(uint32_t);
+    *(int32_t *)p->data = VISUALIZER_PARAM_FFT_WINDOW;
+    *((int32_t *)p->data + 1)= window;
+    status_t status = setParameter(p);
+
+    ALOGV("setFftWindow window %d  status %d p->status %d", window, status, p->status);
+
+    if (status == NO_ERROR) {
+        status = p->status;
+        if (status == NO_ERROR) {
+            mFftWindow = window;
+        } else if (window != VISUALIZER_FFT_WINDOW_RECTANGULAR) {
+            // the effect does not know about windowing, it cannot compute the FFT either
+            status = INVALID_OPERATION;
+        }
+    }
+    return status;
+}
+
 status_t Visualizer::setMeasurementMode(uint32_t mode) {
     if ((mode != MEASUREMENT_MODE_NONE)
             //Note: needs to be handled as a mask when more measurement modes are added
@@ -289,10 +321,13 @@ status_t Visualizer::getFft(uint8_t *fft)
 
     status_t status = NO_ERROR;
     if (mEnabled) {
-        uint8_t buf[mCaptureSize];
-        status = getWaveForm(buf);
-        if (status == NO_ERROR) {
-            status = doFft(fft, buf);
+        status = getEffectFft(fft);
+        if (status == INVALID_OPERATION) {
+            uint8_t buf[mCaptureSize];
+            status = getWaveForm(buf);
+            if (status == NO_ERROR) {
+                status = doFft(fft, buf);
+            }
         }
     } else {
         memset(fft, 0, mCaptureSize);
@@ -300,8 +335,36 @@ status_t Visualizer::getFft(uint8_t *fft)
     return status;
 }
 
+status_t Visualizer::getEffectFft(uint8_t *fft)
+{
+    if (!mEffectFftSupported) {
+        return INVALID_OPERATION;
+    }
+    uint32_t replySize = mCaptureSize;
+    status_t status = command(VISUALIZER_CMD_CAPTURE_FFT, 0, NULL, &replySize, fft);
+    ALOGV("getEffectFft() command returned %d", status);
+    if (status == BAD_VALUE || status == INVALID_OPERATION) {
+        // effects implementations not supporting the command return -EINVAL. A client not
+        // controlling the effect cannot send it either: use the waveform capture instead.
+        if (status == BAD_VALUE) {
+            mEffectFftSupported = false;
+        }
+        return INVALID_OPERATION;
+    }
+    if ((status == NO_ERROR) && (replySize == 0)) {
+        status = NOT_ENOUGH_DATA;
+    }
+    return status;
+}
+
 status_t Visualizer::doFft(uint8_t *fft, uint8_t *waveform)
 {
+    // fixed_fft_real() is limited to VISUALIZER_CAPTURE_SIZE_MAX samples, larger captures
+    // need the FFT of the effect
+    if (mCaptureSize > VISUALIZER_CAPTURE_SIZE_MAX) {
+        return INVALID_OPERATION;
+    }
+
     int32_t workspace[mCaptureSize >> 1];
     int32_t nonzero = 0;
 
@@ -337,13 +400,26 @@ void Visualizer::periodicCapture()
         (mCaptureFlags & (CAPTURE_WAVEFORM|CAPTURE_FFT)) &&
         mCaptureSize != 0) {
         uint8_t waveform[mCaptureSize];
-        status_t status = getWaveForm(waveform);
-        if (status != NO_ERROR) {
-            return;
-        }
         uint8_t fft[mCaptureSize];
-        if (mCaptureFlags & CAPTURE_FFT) {
-            status = doFft(fft, waveform);
+        status_t status = INVALID_OPERATION;
+        // when only the FFT is requested, let the effect compute it once for all clients.
+        // Otherwise derive it from the waveform so that both describe the same window, unless
+        // the capture is too large for the local FFT: then the effect FFT is of the next window.
+        if ((mCaptureFlags & (CAPTURE_WAVEFORM|CAPTURE_FFT)) == CAPTURE_FFT && mEnabled) {
+            status = getEffectFft(fft);
+        }
+        if (status == INVALID_OPERATION) {
+            status = getWaveForm(waveform);
+            if (status != NO_ERROR) {
+                return;
+            }
+            if (mCaptureFlags & CAPTURE_FFT) {
+                if (mCaptureSize > VISUALIZER_CAPTURE_SIZE_MAX && mEnabled) {
+                    status = getEffectFft(fft);
+                } else {
+                    status = doFft(fft, waveform);
+                }
+            }
         }
         if (status != NO_ERROR) {
             return;
@@ -398,6 +474,10 @@ void Visualizer::controlStatusChanged(bool controlGranted) {
         setScalingMode(mScalingMode);
         ALOGV("    capture size reset to %d", mCaptureSize);
         setCaptureSize(mCaptureSize);
+        if (mFftWindow != VISUALIZER_FFT_WINDOW_RECTANGULAR) {
+            ALOGV("    FFT window reset to %d", mFftWindow);
+            setFftWindow(mFftWindow);
+        }
     }
     AudioEffect::controlStatusChanged(controlGranted);
 }
@@ -27,6 +27,7 @@ LOCAL_SRC_FILES:=               \
 LOCAL_SHARED_LIBRARIES :=       \
     libbinder                   \
     libcamera_client            \
+    libcpustats_registry        \
     libcrypto                   \
     libcutils                   \
     libdrmframework             \
@@ -47,6 +47,7 @@
 #include <utils/Vector.h>
 #include <dlfcn.h>
 
+#include <cpustats/ThreadCpuRegistry.h>
 #include <media/IMediaHTTPService.h>
 #include <media/IRemoteDisplay.h>
 #include <media/IRemoteDisplayClient.h>
@@ -629,6 +630,12 @@ status_t MediaPlayerService::dump(int fd, const Vector<String16>& args)
             result.append("\n");
         }
 
+        // per-thread CPU usage of the whole media server, since the previous dump
+        result.append("\n");
+        write(fd, result.string(), result.size());
+        result.clear();
+        ThreadCpuRegistry::dump(fd, 1);
+
         bool dumpMem = false;
         for (size_t i = 0; i < args.size(); i++) {
             if (args[i] == String16("-m")) {
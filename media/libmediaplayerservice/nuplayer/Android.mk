@@ -5,6 +5,7 @@ LOCAL_SRC_FILES:=                       \
         GenericSource.cpp               \
         HTTPLiveSource.cpp              \
         NuPlayer.cpp                    \
+        NuPlayerCodecPool.cpp           \
         NuPlayerDecoder.cpp             \
         NuPlayerDecoderPassThrough.cpp  \
         NuPlayerDriver.cpp              \
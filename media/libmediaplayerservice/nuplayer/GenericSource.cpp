@@ -40,6 +40,9 @@
 
 namespace android {
 
+const int64_t NuPlayer::GenericSource::kAudioReadAheadUs = 2000000ll;
+const int64_t NuPlayer::GenericSource::kVideoReadAheadUs = 1000000ll;
+
 NuPlayer::GenericSource::GenericSource(
         const sp<AMessage> &notify,
         bool uidValid,
@@ -62,8 +65,13 @@ NuPlayer::GenericSource::GenericSource(
 }
 
 void NuPlayer::GenericSource::resetDataSource() {
-    mAudioTimeUs = 0;
-    mVideoTimeUs = 0;
+    {
+        Mutex::Autolock _a(mAudioTrack.mReadLock);
+        Mutex::Autolock _v(mVideoTrack.mReadLock);
+        mAudioTimeUs = 0;
+        mVideoTimeUs = 0;
+        mStopRead = true;
+    }
     mHTTPService.clear();
     mHttpSource.clear();
     mUri.clear();
@@ -75,7 +83,6 @@ void NuPlayer::GenericSource::resetDataSource() {
     mDecryptHandle = NULL;
     mDrmManagerClient = NULL;
     mStarted = false;
-    mStopRead = true;
 }
 
 status_t NuPlayer::GenericSource::setDataSource(
@@ -246,13 +253,25 @@ void NuPlayer::GenericSource::checkDrmStatus(const sp<DataSource>& dataSource) {
 }
 
 int64_t NuPlayer::GenericSource::getLastReadPosition() {
-    if (mAudioTrack.mSource != NULL) {
-        return mAudioTimeUs;
-    } else if (mVideoTrack.mSource != NULL) {
+    {
+        Mutex::Autolock _l(mAudioTrack.mReadLock);
+        if (mAudioTrack.mSource != NULL) {
+            return mAudioTimeUs;
+        }
+    }
+
+    Mutex::Autolock _l(mVideoTrack.mReadLock);
+    if (mVideoTrack.mSource != NULL) {
         return mVideoTimeUs;
-    } else {
-        return 0;
     }
+    return 0;
+}
+
+void NuPlayer::GenericSource::setStopRead(bool stopRead) {
+    // also waits for the reads in progress on the read loopers
+    Mutex::Autolock _a(mAudioTrack.mReadLock);
+    Mutex::Autolock _v(mVideoTrack.mReadLock);
+    mStopRead = stopRead;
 }
 
 status_t NuPlayer::GenericSource::setBuffers(
@@ -264,6 +283,9 @@ status_t NuPlayer::GenericSource::setBuffers(
 }
 
 NuPlayer::GenericSource::~GenericSource() {
+    stopReadLooper(&mAudioTrack);
+    stopReadLooper(&mVideoTrack);
+
     if (mLooper != NULL) {
         mLooper->unregisterHandler(id());
         mLooper->stop();
@@ -277,6 +299,9 @@ void NuPlayer::GenericSource::prepareAsync() {
         mLooper->start();
 
         mLooper->registerHandler(this);
+
+        startReadLooper(&mAudioTrack, "generic-audio");
+        startReadLooper(&mVideoTrack, "generic-video");
     }
 
     sp<AMessage> msg = new AMessage(kWhatPrepareAsync, id());
@@ -456,7 +481,7 @@ status_t NuPlayer::GenericSource::prefillCacheIfNecessary() {
 void NuPlayer::GenericSource::start() {
     ALOGI("start");
 
-    mStopRead = false;
+    setStopRead(false);
     if (mAudioTrack.mSource != NULL) {
         CHECK_EQ(mAudioTrack.mSource->start(), (status_t)OK);
 
@@ -637,25 +662,31 @@ void NuPlayer::GenericSource::onMessageReceived(const sp<AMessage> &msg) {
           }
 
 
-          if (track->mSource != NULL) {
-              track->mSource->stop();
-          }
-          track->mSource = source;
-          track->mSource->start();
-          track->mIndex = trackIndex;
-
-          status_t avail;
-          if (!track->mPackets->hasBufferAvailable(&avail)) {
-              // sync from other source
-              TRESPASS();
-              break;
-          }
-
           int64_t timeUs, actualTimeUs;
           const bool formatChange = true;
-          sp<AMessage> latestMeta = track->mPackets->getLatestEnqueuedMeta();
-          CHECK(latestMeta != NULL && latestMeta->findInt64("timeUs", &timeUs));
-          readBuffer(trackType, timeUs, &actualTimeUs, formatChange);
+          {
+              // keep the track's read looper off the source until the
+              // format change is queued
+              Mutex::Autolock _l(track->mReadLock);
+
+              if (track->mSource != NULL) {
+                  track->mSource->stop();
+              }
+              track->mSource = source;
+              track->mSource->start();
+              track->mIndex = trackIndex;
+
+              status_t avail;
+              if (!track->mPackets->hasBufferAvailable(&avail)) {
+                  // sync from other source
+                  TRESPASS();
+                  break;
+              }
+
+              sp<AMessage> latestMeta = track->mPackets->getLatestEnqueuedMeta();
+              CHECK(latestMeta != NULL && latestMeta->findInt64("timeUs", &timeUs));
+              readBuffer_l(trackType, timeUs, &actualTimeUs, formatChange);
+          }
           readBuffer(counterpartType, -1, NULL, formatChange);
           ALOGV("timeUs %lld actualTimeUs %lld", timeUs, actualTimeUs);
 
@@ -705,7 +736,7 @@ void NuPlayer::GenericSource::onMessageReceived(const sp<AMessage> &msg) {
       {
           // mStopRead is only used for Widevine to prevent the video source
           // from being read while the associated video decoder is shutting down.
-          mStopRead = true;
+          setStopRead(true);
           if (mVideoTrack.mSource != NULL) {
               mVideoTrack.mPackets->clear();
           }
@@ -847,8 +878,9 @@ status_t NuPlayer::GenericSource::dequeueAccessUnit(
 
     status_t result = track->mPackets->dequeueAccessUnit(accessUnit);
 
-    if (!track->mPackets->hasBufferAvailable(&finalResult)) {
-        postReadBuffer(audio? MEDIA_TRACK_TYPE_AUDIO : MEDIA_TRACK_TYPE_VIDEO);
+    media_track_type trackType = audio ? MEDIA_TRACK_TYPE_AUDIO : MEDIA_TRACK_TYPE_VIDEO;
+    if (needsReadAhead(trackType)) {
+        postReadBuffer(trackType);
     }
 
     if (result != OK) {
@@ -1211,12 +1243,66 @@ sp<ABuffer> NuPlayer::GenericSource::mediaBufferToABuffer(
     return ab;
 }
 
+NuPlayer::GenericSource::Track *NuPlayer::GenericSource::getTrack(
+        media_track_type trackType) {
+    switch (trackType) {
+        case MEDIA_TRACK_TYPE_VIDEO:
+            return &mVideoTrack;
+        case MEDIA_TRACK_TYPE_AUDIO:
+            return &mAudioTrack;
+        case MEDIA_TRACK_TYPE_SUBTITLE:
+            return &mSubtitleTrack;
+        case MEDIA_TRACK_TYPE_TIMEDTEXT:
+            return &mTimedTextTrack;
+        default:
+            TRESPASS();
+    }
+    return NULL;
+}
+
+void NuPlayer::GenericSource::startReadLooper(Track *track, const char *name) {
+    track->mReadLooper = new ALooper;
+    track->mReadLooper->setName(name);
+    track->mReadLooper->start();
+
+    track->mReadHandler = new AHandlerReflector<GenericSource>(this);
+    track->mReadLooper->registerHandler(track->mReadHandler);
+}
+
+void NuPlayer::GenericSource::stopReadLooper(Track *track) {
+    if (track->mReadLooper != NULL) {
+        track->mReadLooper->unregisterHandler(track->mReadHandler->id());
+        track->mReadLooper->stop();
+        track->mReadLooper.clear();
+        track->mReadHandler.clear();
+    }
+}
+
+bool NuPlayer::GenericSource::needsReadAhead(media_track_type trackType) {
+    Track *track = getTrack(trackType);
+    status_t finalResult;
+    if (!track->mPackets->hasBufferAvailable(&finalResult)) {
+        return finalResult == OK;
+    }
+
+    // Widevine hands out video buffers from a fixed pool, read it on demand.
+    if (mIsWidevine || finalResult != OK) {
+        return false;
+    }
+
+    int64_t bufferedUs = track->mPackets->getBufferedDurationUs(&finalResult);
+    return bufferedUs < (trackType == MEDIA_TRACK_TYPE_AUDIO
+            ? kAudioReadAheadUs : kVideoReadAheadUs);
+}
+
 void NuPlayer::GenericSource::postReadBuffer(media_track_type trackType) {
     Mutex::Autolock _l(mReadBufferLock);
 
     if ((mPendingReadBufferTypes & (1 << trackType)) == 0) {
         mPendingReadBufferTypes |= (1 << trackType);
-        sp<AMessage> msg = new AMessage(kWhatReadBuffer, id());
+        Track *track = getTrack(trackType);
+        sp<AMessage> msg = new AMessage(kWhatReadBuffer,
+                track->mReadHandler != NULL ? track->mReadHandler->id() : id());
         msg->setInt32("trackType", trackType);
         msg->post();
     }
@@ -1234,39 +1320,52 @@ void NuPlayer::GenericSource::onReadBuffer(sp<AMessage> msg) {
         mPendingReadBufferTypes &= ~(1 << trackType);
     }
     readBuffer(trackType);
+
+    Track *track = getTrack(trackType);
+    bool canRead;
+    {
+        Mutex::Autolock _l(track->mReadLock);
+        canRead = !mStopRead && track->mSource != NULL;
+    }
+
+    // Read in bounded batches until the track is filled up, so that seeks
+    // and source changes made on mLooper needn't wait long for mReadLock.
+    // Widevine reads don't block, they are retried as access units are
+    // dequeued instead.
+    if (!mIsWidevine && canRead && needsReadAhead(trackType)) {
+        postReadBuffer(trackType);
+    }
 }
 
 void NuPlayer::GenericSource::readBuffer(
         media_track_type trackType, int64_t seekTimeUs, int64_t *actualTimeUs, bool formatChange) {
+    Mutex::Autolock _l(getTrack(trackType)->mReadLock);
+    readBuffer_l(trackType, seekTimeUs, actualTimeUs, formatChange);
+}
+
+void NuPlayer::GenericSource::readBuffer_l(
+        media_track_type trackType, int64_t seekTimeUs, int64_t *actualTimeUs, bool formatChange) {
     // Do not read data if Widevine source is stopped
     if (mStopRead) {
         return;
     }
-    Track *track;
+    Track *track = getTrack(trackType);
     size_t maxBuffers = 1;
     switch (trackType) {
         case MEDIA_TRACK_TYPE_VIDEO:
-            track = &mVideoTrack;
             if (mIsWidevine) {
                 maxBuffers = 2;
             }
             break;
         case MEDIA_TRACK_TYPE_AUDIO:
-            track = &mAudioTrack;
             if (mIsWidevine) {
                 maxBuffers = 8;
             } else {
                 maxBuffers = 64;
             }
             break;
-        case MEDIA_TRACK_TYPE_SUBTITLE:
-            track = &mSubtitleTrack;
-            break;
-        case MEDIA_TRACK_TYPE_TIMEDTEXT:
-            track = &mTimedTextTrack;
-            break;
         default:
-            TRESPASS();
+            break;
     }
 
     if (track->mSource == NULL) {
@@ -24,6 +24,7 @@
 #include "ATSParser.h"
 
 #include <media/mediaplayer.h>
+#include <media/stagefright/foundation/AHandlerReflector.h>
 
 namespace android {
 
@@ -98,16 +99,28 @@ private:
 
     Vector<sp<MediaSource> > mSources;
 
+    // Audio and video are read ahead on loopers of their own, until this
+    // much is queued, so that slow reads of one track don't starve the other.
+    static const int64_t kAudioReadAheadUs;
+    static const int64_t kVideoReadAheadUs;
+
     struct Track {
         size_t mIndex;
         sp<MediaSource> mSource;
         sp<AnotherPacketSource> mPackets;
+
+        // Only set for audio and video, text is read on mLooper.
+        sp<ALooper> mReadLooper;
+        sp<AHandlerReflector<GenericSource> > mReadHandler;
+
+        // Held while reading from mSource, and while mLooper changes it.
+        Mutex mReadLock;
     };
 
     Track mAudioTrack;
-    int64_t mAudioTimeUs;
+    int64_t mAudioTimeUs;  // guarded by mAudioTrack.mReadLock
     Track mVideoTrack;
-    int64_t mVideoTimeUs;
+    int64_t mVideoTimeUs;  // guarded by mVideoTrack.mReadLock
     Track mSubtitleTrack;
     Track mTimedTextTrack;
 
@@ -133,6 +146,7 @@ private:
     DrmManagerClient *mDrmManagerClient;
     sp<DecryptHandle> mDecryptHandle;
     bool mStarted;
+    // Written holding both tracks' mReadLock, read holding either.
     bool mStopRead;
     String8 mContentType;
     AString mSniffedMIME;
@@ -144,11 +158,14 @@ private:
 
     sp<ALooper> mLooper;
 
+    friend struct AHandlerReflector<GenericSource>;
+
     void resetDataSource();
 
     status_t initFromDataSource();
     void checkDrmStatus(const sp<DataSource>& dataSource);
     int64_t getLastReadPosition();
+    void setStopRead(bool stopRead);
     void setDrmPlaybackStatusIfNeeded(int playbackStatus, int64_t position);
 
     status_t prefillCacheIfNecessary();
@@ -182,11 +199,19 @@ private:
             media_track_type trackType,
             int64_t *actualTimeUs = NULL);
 
+    Track *getTrack(media_track_type trackType);
+    void startReadLooper(Track *track, const char *name);
+    void stopReadLooper(Track *track);
+    bool needsReadAhead(media_track_type trackType);
+
     void postReadBuffer(media_track_type trackType);
     void onReadBuffer(sp<AMessage> msg);
     void readBuffer(
             media_track_type trackType,
             int64_t seekTimeUs = -1ll, int64_t *actualTimeUs = NULL, bool formatChange = false);
+    void readBuffer_l(
+            media_track_type trackType,
+            int64_t seekTimeUs = -1ll, int64_t *actualTimeUs = NULL, bool formatChange = false);
 
     void schedulePollBuffering();
     void cancelPollBuffering();
@@ -82,6 +82,7 @@ protected:
 public:
     struct NuPlayerStreamListener;
     struct Source;
+    struct CodecPool;
 
 private:
     struct Decoder;
@@ -0,0 +1,265 @@
+/*
+ * Copyright (C) 2015 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+//#define LOG_NDEBUG 0
+#define LOG_TAG "NuPlayerCodecPool"
+#include <utils/Log.h>
+
+#include "NuPlayerCodecPool.h"
+
+#include <cutils/properties.h>
+#include <media/stagefright/foundation/ADebug.h>
+#include <media/stagefright/foundation/ALooper.h>
+#include <media/stagefright/foundation/AMessage.h>
+#include <media/stagefright/MediaCodec.h>
+
+#include <stdlib.h>
+
+namespace android {
+
+const int64_t NuPlayer::CodecPool::kMaxIdleTimeUs = 10000000ll;
+const int64_t NuPlayer::CodecPool::kMaxIdleHardwareTimeUs = 3000000ll;
+
+static Mutex sInitMutex;
+static sp<NuPlayer::CodecPool> gCodecPool;
+
+// static
+sp<NuPlayer::CodecPool> NuPlayer::CodecPool::Get() {
+    Mutex::Autolock autoLock(sInitMutex);
+
+    if (gCodecPool == NULL) {
+        size_t maxIdleCodecs = kDefaultMaxIdleCodecs;
+
+        char value[PROPERTY_VALUE_MAX];
+        if (property_get("media.nuplayer.codec-pool-size", value, NULL)) {
+            char *end;
+            long n = strtol(value, &end, 10);
+            if (end > value && *end == '\0' && n >= 0) {
+                maxIdleCodecs = n;
+            } else {
+                ALOGW("invalid media.nuplayer.codec-pool-size '%s'", value);
+            }
+        }
+
+        gCodecPool = new CodecPool(maxIdleCodecs);
+        gCodecPool->mLooper->registerHandler(gCodecPool);
+    }
+
+    return gCodecPool;
+}
+
+NuPlayer::CodecPool::CodecPool(size_t maxIdleCodecs)
+    : mMaxIdleCodecs(maxIdleCodecs) {
+    mLooper = new ALooper;
+    mLooper->setName("NPCodecPool");
+    mLooper->start();
+}
+
+NuPlayer::CodecPool::~CodecPool() {
+    mLooper->unregisterHandler(id());
+    mLooper->stop();
+
+    releaseIdle(INT64_MAX);
+}
+
+// static
+sp<ALooper> NuPlayer::CodecPool::CreateCodecLooper() {
+    sp<ALooper> looper = new ALooper;
+    looper->setName("NPDecoder-CL");
+    looper->start(false, false, ANDROID_PRIORITY_AUDIO);
+    return looper;
+}
+
+// static
+void NuPlayer::CodecPool::InitEntry(
+        Entry *entry, const AString &mime,
+        const sp<MediaCodec> &codec, const sp<ALooper> &looper) {
+    AString componentName;
+    bool isHardware = codec->getName(&componentName) != OK
+            || !componentName.startsWith("OMX.google.");
+
+    entry->mMime = mime;
+    entry->mLooper = looper;
+    entry->mCodec = codec;
+    entry->mIsHardwareVideo = isHardware && mime.startsWith("video/");
+    entry->mExpiryUs = ALooper::GetNowUs()
+            + (isHardware ? kMaxIdleHardwareTimeUs : kMaxIdleTimeUs);
+}
+
+sp<MediaCodec> NuPlayer::CodecPool::acquire(
+        const AString &mime, sp<ALooper> *looper) {
+    {
+        Mutex::Autolock autoLock(mLock);
+
+        ssize_t index = findIdle_l(mime);
+        if (index >= 0) {
+            const Entry &entry = mIdle.itemAt(index);
+            sp<MediaCodec> codec = entry.mCodec;
+            *looper = entry.mLooper;
+            mIdle.removeAt(index);
+
+            ALOGV("reusing idle %s decoder", mime.c_str());
+            return codec;
+        }
+    }
+
+    sp<ALooper> codecLooper = CreateCodecLooper();
+    sp<MediaCodec> codec =
+        MediaCodec::CreateByType(codecLooper, mime.c_str(), false /* encoder */);
+
+    if (codec == NULL && releaseIdle(INT64_MAX) > 0) {
+        // the idle decoders may have held the last instances available
+        codec = MediaCodec::CreateByType(
+                codecLooper, mime.c_str(), false /* encoder */);
+    }
+
+    if (codec != NULL) {
+        *looper = codecLooper;
+    }
+
+    return codec;
+}
+
+void NuPlayer::CodecPool::recycle(
+        const AString &mime,
+        const sp<MediaCodec> &codec, const sp<ALooper> &looper) {
+    if (mMaxIdleCodecs == 0 || codec->stop() != OK) {
+        codec->release();
+        return;
+    }
+
+    Entry entry;
+    InitEntry(&entry, mime, codec, looper);
+    addIdle(entry);
+}
+
+void NuPlayer::CodecPool::prewarm(const AString &mime) {
+    sp<AMessage> msg = new AMessage(kWhatPrewarm, id());
+    msg->setString("mime", mime.c_str());
+    msg->post();
+}
+
+void NuPlayer::CodecPool::addIdle(const Entry &entry) {
+    Vector<Entry> evicted;
+    {
+        Mutex::Autolock autoLock(mLock);
+
+        if (entry.mIsHardwareVideo) {
+            for (size_t i = 0; i < mIdle.size(); ++i) {
+                if (mIdle.itemAt(i).mIsHardwareVideo) {
+                    evicted.push(mIdle.itemAt(i));
+                    mIdle.removeAt(i);
+                    break;
+                }
+            }
+        }
+
+        mIdle.push(entry);
+        while (mIdle.size() > mMaxIdleCodecs) {
+            evicted.push(mIdle.itemAt(0));
+            mIdle.removeAt(0);
+        }
+    }
+
+    // releasing blocks, don't hold mLock meanwhile
+    for (size_t i = 0; i < evicted.size(); ++i) {
+        ALOGV("releasing idle %s decoder", evicted.itemAt(i).mMime.c_str());
+        evicted.itemAt(i).mCodec->release();
+    }
+
+    (new AMessage(kWhatTrim, id()))->post(entry.mExpiryUs - ALooper::GetNowUs());
+}
+
+ssize_t NuPlayer::CodecPool::findIdle_l(const AString &mime) const {
+    // most recently recycled first, it is the least likely to be trimmed
+    for (size_t i = mIdle.size(); i-- > 0;) {
+        if (mIdle.itemAt(i).mMime == mime) {
+            return i;
+        }
+    }
+    return -1;
+}
+
+size_t NuPlayer::CodecPool::releaseIdle(int64_t expiryUs) {
+    Vector<Entry> expired;
+    {
+        Mutex::Autolock autoLock(mLock);
+
+        size_t i = 0;
+        while (i < mIdle.size()) {
+            if (mIdle.itemAt(i).mExpiryUs <= expiryUs) {
+                expired.push(mIdle.itemAt(i));
+                mIdle.removeAt(i);
+            } else {
+                ++i;
+            }
+        }
+    }
+
+    for (size_t i = 0; i < expired.size(); ++i) {
+        ALOGV("releasing idle %s decoder", expired.itemAt(i).mMime.c_str());
+        expired.itemAt(i).mCodec->release();
+    }
+
+    return expired.size();
+}
+
+void NuPlayer::CodecPool::onPrewarm(const AString &mime) {
+    {
+        Mutex::Autolock autoLock(mLock);
+
+        if (mMaxIdleCodecs == 0 || findIdle_l(mime) >= 0) {
+            return;
+        }
+    }
+
+    sp<ALooper> looper = CreateCodecLooper();
+    sp<MediaCodec> codec = MediaCodec::CreateByType(
+            looper, mime.c_str(), false /* encoder */);
+    if (codec == NULL) {
+        ALOGW("unable to prewarm a %s decoder", mime.c_str());
+        return;
+    }
+
+    ALOGV("prewarmed a %s decoder", mime.c_str());
+    Entry entry;
+    InitEntry(&entry, mime, codec, looper);
+    addIdle(entry);
+}
+
+void NuPlayer::CodecPool::onMessageReceived(const sp<AMessage> &msg) {
+    switch (msg->what()) {
+        case kWhatPrewarm:
+        {
+            AString mime;
+            CHECK(msg->findString("mime", &mime));
+            onPrewarm(mime);
+            break;
+        }
+
+        case kWhatTrim:
+        {
+            releaseIdle(ALooper::GetNowUs());
+            break;
+        }
+
+        default:
+            TRESPASS();
+            break;
+    }
+}
+
+}  // namespace android
@@ -0,0 +1,115 @@
+/*
+ * Copyright (C) 2015 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef NUPLAYER_CODEC_POOL_H_
+
+#define NUPLAYER_CODEC_POOL_H_
+
+#include "NuPlayer.h"
+
+#include <media/stagefright/foundation/AHandler.h>
+#include <media/stagefright/foundation/AString.h>
+#include <utils/threads.h>
+#include <utils/Vector.h>
+
+namespace android {
+
+struct MediaCodec;
+
+// Decoders kept allocated but unconfigured (stopped) once a player is done
+// with them, so that the next player decoding the same mime type skips the
+// allocation of the component, which dominates the time to the first frame of
+// short clips. Shared by all players of the process.
+//
+// The number of idle decoders is bounded by media.nuplayer.codec-pool-size
+// (0 disables the pool); they are released after kMaxIdleTimeUs, or as soon
+// as a decoder can't be allocated.
+//
+// Idle hardware decoders are held on behalf of every MediaCodec client of the
+// device, which may be refused one meanwhile. So at most one hardware video
+// decoder is kept idle, and hardware decoders only for
+// kMaxIdleHardwareTimeUs: enough for clips played back to back, while
+// software decoders, which only cost memory, are kept longer.
+struct NuPlayer::CodecPool : public AHandler {
+    static sp<CodecPool> Get();
+
+    // Returns a decoder for mime in the initialized state, running on
+    // *looper: an idle one if any, a new one otherwise.
+    sp<MediaCodec> acquire(const AString &mime, sp<ALooper> *looper);
+
+    // Stops the decoder and keeps it for acquire(), or releases it if that
+    // fails. The decoder must not be used by the caller anymore.
+    void recycle(
+            const AString &mime,
+            const sp<MediaCodec> &codec, const sp<ALooper> &looper);
+
+    // Allocates an idle decoder for mime in the background, unless there is
+    // one already.
+    void prewarm(const AString &mime);
+
+protected:
+    virtual ~CodecPool();
+
+    virtual void onMessageReceived(const sp<AMessage> &msg);
+
+private:
+    enum {
+        kWhatPrewarm = 'prwm',
+        kWhatTrim    = 'trim',
+    };
+
+    enum {
+        kDefaultMaxIdleCodecs = 2,
+    };
+
+    static const int64_t kMaxIdleTimeUs;
+    static const int64_t kMaxIdleHardwareTimeUs;
+
+    struct Entry {
+        AString mMime;
+        sp<ALooper> mLooper;
+        sp<MediaCodec> mCodec;
+        bool mIsHardwareVideo;
+        int64_t mExpiryUs;
+    };
+
+    Mutex mLock;
+    sp<ALooper> mLooper;
+    size_t mMaxIdleCodecs;
+
+    // Least recently recycled first.
+    Vector<Entry> mIdle;
+
+    CodecPool(size_t maxIdleCodecs);
+
+    static sp<ALooper> CreateCodecLooper();
+
+    static void InitEntry(
+            Entry *entry, const AString &mime,
+            const sp<MediaCodec> &codec, const sp<ALooper> &looper);
+
+    void addIdle(const Entry &entry);
+    ssize_t findIdle_l(const AString &mime) const;
+    size_t releaseIdle(int64_t expiryUs);
+
+    void onPrewarm(const AString &mime);
+
+    DISALLOW_EVIL_CONSTRUCTORS(CodecPool);
+};
+
+}  // namespace android
+
+#endif  // NUPLAYER_CODEC_POOL_H_
@@ -20,6 +20,7 @@
 #include <inttypes.h>
 
 #include "NuPlayerDecoder.h"
+#include "NuPlayerCodecPool.h"
 
 #include <media/ICrypto.h>
 #include <media/stagefright/foundation/ABitReader.h>
@@ -38,6 +39,7 @@ NuPlayer::Decoder::Decoder(
         const sp<NativeWindowWrapper> &nativeWindow)
     : mNotify(notify),
       mNativeWindow(nativeWindow),
+      mCodecIsReusable(false),
       mBufferGeneration(0),
       mPaused(true),
       mComponentName("decoder") {
@@ -46,10 +48,6 @@ NuPlayer::Decoder::Decoder(
     mDecoderLooper = new ALooper;
     mDecoderLooper->setName("NPDecoder");
     mDecoderLooper->start(false, false, ANDROID_PRIORITY_AUDIO);
-
-    mCodecLooper = new ALooper;
-    mCodecLooper->setName("NPDecoder-CL");
-    mCodecLooper->start(false, false, ANDROID_PRIORITY_AUDIO);
 }
 
 NuPlayer::Decoder::~Decoder() {
@@ -105,9 +103,15 @@ void NuPlayer::Decoder::onConfigure(const sp<AMessage> &format) {
     mComponentName.append(" decoder");
     ALOGV("[%s] onConfigure (surface=%p)", mComponentName.c_str(), surface.get());
 
-    mCodec = MediaCodec::CreateByType(mCodecLooper, mime.c_str(), false /* encoder */);
     int32_t secure = 0;
     if (format->findInt32("secure", &secure) && secure != 0) {
+        if (mCodecLooper == NULL) {
+            mCodecLooper = new ALooper;
+            mCodecLooper->setName("NPDecoder-CL");
+            mCodecLooper->start(false, false, ANDROID_PRIORITY_AUDIO);
+        }
+
+        mCodec = MediaCodec::CreateByType(mCodecLooper, mime.c_str(), false /* encoder */);
         if (mCodec != NULL) {
             mCodec->getName(&mComponentName);
             mComponentName.append(".secure");
@@ -116,6 +120,9 @@ void NuPlayer::Decoder::onConfigure(const sp<AMessage> &format) {
             mCodec = MediaCodec::CreateByComponentName(
                     mCodecLooper, mComponentName.c_str());
         }
+    } else {
+        // comes with a looper of its own, which goes back to the pool with it
+        mCodec = CodecPool::Get()->acquire(mime, &mCodecLooper);
     }
     if (mCodec == NULL) {
         ALOGE("Failed to create %s%s decoder",
@@ -129,6 +136,8 @@ void NuPlayer::Decoder::onConfigure(const sp<AMessage> &format) {
 #endif
 
     mCodec->getName(&mComponentName);
+    mCodecMime = mime;
+    mCodecIsReusable = (secure == 0);
 
     status_t err;
     if (mNativeWindow != NULL) {
@@ -242,6 +251,7 @@ void NuPlayer::Decoder::handleError(int32_t err)
     // decoder after flushing and increment the generation to discard unnecessary messages.
 
     ++mBufferGeneration;
+    mCodecIsReusable = false;
 
     sp<AMessage> notify = mNotify->dup();
     notify->setInt32("what", kWhatError);
@@ -555,8 +565,14 @@ void NuPlayer::Decoder::onResume() {
 void NuPlayer::Decoder::onShutdown() {
     status_t err = OK;
     if (mCodec != NULL) {
-        err = mCodec->release();
+        if (mCodecIsReusable) {
+            CodecPool::Get()->recycle(mCodecMime, mCodec, mCodecLooper);
+            mCodecLooper.clear();
+        } else {
+            err = mCodec->release();
+        }
         mCodec = NULL;
+        mCodecIsReusable = false;
         ++mBufferGeneration;
 
         if (mNativeWindow != NULL) {
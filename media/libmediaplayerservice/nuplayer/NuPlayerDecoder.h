@@ -78,6 +78,11 @@ private:
     sp<AMessage> mOutputFormat;
     sp<MediaCodec> mCodec;
     sp<ALooper> mCodecLooper;
+    AString mCodecMime;
+
+    // Whether mCodec may go back to the CodecPool on shutdown: it isn't
+    // secure and never failed.
+    bool mCodecIsReusable;
     sp<ALooper> mDecoderLooper;
 
     List<sp<AMessage> > mPendingInputMessages;
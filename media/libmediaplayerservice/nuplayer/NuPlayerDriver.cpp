@@ -22,6 +22,7 @@
 #include "NuPlayerDriver.h"
 
 #include "NuPlayer.h"
+#include "NuPlayerCodecPool.h"
 #include "NuPlayerSource.h"
 
 #include <media/stagefright/foundation/ADebug.h>
@@ -512,8 +513,15 @@ void NuPlayerDriver::setAudioSink(const sp<AudioSink> &audioSink) {
     mAudioSink = audioSink;
 }
 
-status_t NuPlayerDriver::setParameter(
-        int /* key */, const Parcel & /* request */) {
+status_t NuPlayerDriver::setParameter(int key, const Parcel &request) {
+    if (key == KEY_PARAMETER_PREWARM_DECODER) {
+        String8 mime(request.readString16());
+        if (mime.isEmpty()) {
+            return BAD_VALUE;
+        }
+        NuPlayer::CodecPool::Get()->prewarm(AString(mime.string()));
+        return OK;
+    }
     return INVALID_OPERATION;
 }
 
@@ -9,6 +9,8 @@ LOCAL_SRC_FILES := \
     NBAIO.cpp                       \
     MonoPipe.cpp                    \
     MonoPipeReader.cpp              \
+    MultiPipe.cpp                   \
+    MultiPipeReader.cpp             \
     Pipe.cpp                        \
     PipeReader.cpp                  \
     roundup.c                       \
@@ -0,0 +1,126 @@
+/*
+ * Copyright (C) 2015 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#define LOG_TAG "MultiPipe"
+//#define LOG_NDEBUG 0
+
+#include <cutils/atomic.h>
+#include <cutils/compiler.h>
+#include <utils/Log.h>
+#include <media/nbaio/MultiPipe.h>
+#include <media/nbaio/roundup.h>
+
+namespace android {
+
+MultiPipe::MultiPipe(size_t maxFrames, const NBAIO_Format& format) :
+        NBAIO_Sink(format),
+        mMaxFrames(roundup(maxFrames)),
+        mBuffer(malloc(mMaxFrames * Format_frameSize(format))),
+        mRear(0)
+{
+    for (size_t i = 0; i < kMaxReaders; i++) {
+        mSlots[i].mState = SLOT_FREE;
+        mSlots[i].mFront = 0;
+    }
+}
+
+MultiPipe::~MultiPipe()
+{
+#if !LOG_NDEBUG
+    for (size_t i = 0; i < kMaxReaders; i++) {
+        ALOG_ASSERT(android_atomic_acquire_load(&mSlots[i].mState) == SLOT_FREE);
+    }
+#endif
+    free(mBuffer);
+}
+
+ssize_t MultiPipe::availableToWrite() const
+{
+    if (CC_UNLIKELY(!mNegotiated)) {
+        return NEGOTIATE;
+    }
+    // write() is not multi-thread safe w.r.t. itself, so no mutex or atomic op needed to read mRear
+    const int32_t rear = mRear;
+    size_t filled = 0;
+    for (size_t i = 0; i < kMaxReaders; i++) {
+        // a slot in transition is not yet waited for, see enroll()
+        if (android_atomic_acquire_load(&mSlots[i].mState) == SLOT_BLOCKING) {
+            size_t slotFilled = rear - android_atomic_acquire_load(&mSlots[i].mFront);
+            ALOG_ASSERT(slotFilled <= mMaxFrames);
+            if (slotFilled > filled) {
+                filled = slotFilled;
+            }
+        }
+    }
+    return mMaxFrames - filled;
+}
+
+ssize_t MultiPipe::write(const void *buffer, size_t count)
+{
+    // can't return a negative value other than NEGOTIATE
+    ssize_t avail = availableToWrite();
+    if (CC_UNLIKELY(avail <= 0)) {
+        return avail;
+    }
+    if (CC_LIKELY(count > (size_t) avail)) {
+        count = avail;
+    }
+    size_t rear = mRear & (mMaxFrames - 1);
+    size_t written = mMaxFrames - rear;
+    if (CC_LIKELY(written > count)) {
+        written = count;
+    }
+    memcpy((char *) mBuffer + (rear * mFrameSize), buffer, written * mFrameSize);
+    if (CC_UNLIKELY(rear + written == mMaxFrames)) {
+        if (CC_UNLIKELY((count -= written) > rear)) {
+            count = rear;
+        }
+        if (CC_LIKELY(count > 0)) {
+            memcpy(mBuffer, (char *) buffer + (written * mFrameSize), count * mFrameSize);
+            written += count;
+        }
+    }
+    android_atomic_release_store(written + mRear, &mRear);
+    mFramesWritten += written;
+    return written;
+}
+
+int MultiPipe::enroll(bool lossy)
+{
+    for (size_t i = 0; i < kMaxReaders; i++) {
+        Slot& slot = mSlots[i];
+        if (android_atomic_cmpxchg(SLOT_FREE, SLOT_CLAIMED, &slot.mState) != 0) {
+            continue;
+        }
+        // A write() in progress may not see the new state and fill the whole pipe from its rear,
+        // so the front is published once before the state, for the writer to see a valid value,
+        // and again after, so that the reader skips what that write() may have overwritten.
+        android_atomic_release_store(android_atomic_acquire_load(&mRear), &slot.mFront);
+        android_atomic_release_store(lossy ? SLOT_LOSSY : SLOT_BLOCKING, &slot.mState);
+        android_atomic_release_store(android_atomic_acquire_load(&mRear), &slot.mFront);
+        return i;
+    }
+    ALOGW("enroll() all %zu reader slots are in use", kMaxReaders);
+    return -1;
+}
+
+void MultiPipe::unenroll(int slot)
+{
+    ALOG_ASSERT(slot >= 0 && (size_t) slot < kMaxReaders);
+    android_atomic_release_store(SLOT_FREE, &mSlots[slot].mState);
+}
+
+}   // namespace android
@@ -0,0 +1,99 @@
+/*
+ * Copyright (C) 2015 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#define LOG_TAG "MultiPipeReader"
+//#define LOG_NDEBUG 0
+
+#include <cutils/atomic.h>
+#include <cutils/compiler.h>
+#include <utils/Log.h>
+#include <media/nbaio/MultiPipeReader.h>
+
+namespace android {
+
+MultiPipeReader::MultiPipeReader(MultiPipe& pipe, bool lossy) :
+        NBAIO_Source(pipe.mFormat),
+        mPipe(pipe),
+        mSlot(pipe.enroll(lossy)),
+        mFront(mSlot >= 0 ? android_atomic_acquire_load(&pipe.mSlots[mSlot].mFront) : 0),
+        mFramesOverrun(0),
+        mOverruns(0)
+{
+}
+
+MultiPipeReader::~MultiPipeReader()
+{
+    if (mSlot >= 0) {
+        mPipe.unenroll(mSlot);
+    }
+}
+
+ssize_t MultiPipeReader::availableToRead()
+{
+    if (CC_UNLIKELY(!mNegotiated)) {
+        return NEGOTIATE;
+    }
+    if (CC_UNLIKELY(mSlot < 0)) {
+        return NO_INIT;
+    }
+    int32_t rear = android_atomic_acquire_load(&mPipe.mRear);
+    // read() is not multi-thread safe w.r.t. itself, so no mutex or atomic op needed to read mFront
+    size_t avail = rear - mFront;
+    if (CC_UNLIKELY(avail > mPipe.mMaxFrames)) {
+        // only possible for a lossy reader, which the writer does not wait for.
+        // Discard 1/16 of the most recent data in pipe to avoid another overrun immediately
+        int32_t oldFront = mFront;
+        mFront = rear - mPipe.mMaxFrames + (mPipe.mMaxFrames >> 4);
+        mFramesOverrun += (size_t) (mFront - oldFront);
+        ++mOverruns;
+        return OVERRUN;
+    }
+    return avail;
+}
+
+ssize_t MultiPipeReader::read(void *buffer, size_t count, int64_t readPTS __unused)
+{
+    ssize_t avail = availableToRead();
+    if (CC_UNLIKELY(avail <= 0)) {
+        return avail;
+    }
+    if (CC_LIKELY(count > (size_t) avail)) {
+        count = avail;
+    }
+    size_t front = mFront & (mPipe.mMaxFrames - 1);
+    size_t red = mPipe.mMaxFrames - front;
+    if (CC_LIKELY(red > count)) {
+        red = count;
+    }
+    // for a lossy reader, an overrun during the memcpy will result in reading corrupt data
+    memcpy(buffer, (char *) mPipe.mBuffer + (front * mFrameSize), red * mFrameSize);
+    if (CC_UNLIKELY(front + red == mPipe.mMaxFrames)) {
+        if (CC_UNLIKELY((count -= red) > front)) {
+            count = front;
+        }
+        if (CC_LIKELY(count > 0)) {
+            memcpy((char *) buffer + (red * mFrameSize), mPipe.mBuffer, count * mFrameSize);
+            red += count;
+        }
+    }
+    mFront += red;
+    // release the space to the writer only after the data has been copied out
+    android_atomic_release_store(mFront, &mPipe.mSlots[mSlot].mFront);
+    mFramesRead += red;
+    return red;
+}
+
+}   // namespace android
@@ -30,6 +30,9 @@
 
 namespace android {
 
+// next process-wide format id, see NBLog::Format
+static volatile int32_t sNextFormatId = 0;
+
 int NBLog::Entry::readAt(size_t offset) const
 {
     // FIXME This is too slow, despite the name it is used during writing
@@ -75,17 +78,26 @@ size_t NBLog::Timeline::sharedSize(size_t size)
 NBLog::Writer::Writer()
     : mSize(0), mShared(NULL), mRear(0), mEnabled(false)
 {
+    for (size_t i = 0; i < kMaxFormats; i++) {
+        mFormatRear[i] = mRear - mSize;
+    }
 }
 
 NBLog::Writer::Writer(size_t size, void *shared)
     : mSize(roundup(size)), mShared((Shared *) shared), mRear(0), mEnabled(mShared != NULL)
 {
+    for (size_t i = 0; i < kMaxFormats; i++) {
+        mFormatRear[i] = mRear - mSize;
+    }
 }
 
 NBLog::Writer::Writer(size_t size, const sp<IMemory>& iMemory)
     : mSize(roundup(size)), mShared(iMemory != 0 ? (Shared *) iMemory->pointer() : NULL),
       mIMemory(iMemory), mRear(0), mEnabled(mShared != NULL)
 {
+    for (size_t i = 0; i < kMaxFormats; i++) {
+        mFormatRear[i] = mRear - mSize;
+    }
 }
 
 void NBLog::Writer::log(const char *string)
@@ -147,6 +159,52 @@ void NBLog::Writer::logTimestamp(const struct timespec& ts)
     log(EVENT_TIMESTAMP, &ts, sizeof(struct timespec));
 }
 
+void NBLog::Writer::logEvent(const Format& format, const int32_t *args, size_t count)
+{
+    if (!mEnabled) {
+        return;
+    }
+    int32_t id = format.mId;
+    if (id < 0) {
+        // first use of this format in the process
+        int32_t newId = android_atomic_inc(&sNextFormatId);
+        // if another thread assigned an id first, newId is wasted
+        (void) android_atomic_cmpxchg(-1, newId, &format.mId);
+        id = format.mId;
+    }
+    if ((size_t) id >= kMaxFormats) {
+        return;
+    }
+    // log the format if the reader may not have seen it yet: never logged, or possibly overwritten
+    if (mRear - mFormatRear[id] >= (int32_t) (mSize >> 1)) {
+        uint8_t buffer[255];
+        size_t length = strlen(format.mFmt);
+        if (length > sizeof(buffer) - 2) {
+            length = sizeof(buffer) - 2;
+        }
+        buffer[0] = id;
+        buffer[1] = format.mPhase;
+        memcpy(&buffer[2], format.mFmt, length);
+        mFormatRear[id] = mRear;
+        log(EVENT_FORMAT, buffer, length + 2);
+    }
+    if (count > kMaxEventArgs) {
+        count = kMaxEventArgs;
+    }
+    struct timespec ts;
+    if (clock_gettime(CLOCK_MONOTONIC, &ts)) {
+        return;
+    }
+    const int64_t ns = ts.tv_sec * 1000000000LL + ts.tv_nsec;
+    uint8_t buffer[1 + sizeof(int64_t) + kMaxEventArgs * sizeof(int32_t)];
+    buffer[0] = id;
+    memcpy(&buffer[1], &ns, sizeof(int64_t));
+    if (count > 0) {
+        memcpy(&buffer[1 + sizeof(int64_t)], args, count * sizeof(int32_t));
+    }
+    log(EVENT_BINARY, buffer, 1 + sizeof(int64_t) + count * sizeof(int32_t));
+}
+
 void NBLog::Writer::log(Event event, const void *data, size_t length)
 {
     if (!mEnabled) {
@@ -158,6 +216,8 @@ void NBLog::Writer::log(Event event, const void *data, size_t length)
     switch (event) {
     case EVENT_STRING:
     case EVENT_TIMESTAMP:
+    case EVENT_FORMAT:
+    case EVENT_BINARY:
         break;
     case EVENT_RESERVED:
     default:
@@ -258,6 +318,12 @@ void NBLog::LockedWriter::logTimestamp(const struct timespec& ts)
     Writer::logTimestamp(ts);
 }
 
+void NBLog::LockedWriter::logEvent(const Format& format, const int32_t *args, size_t count)
+{
+    Mutex::Autolock _l(mLock);
+    Writer::logEvent(format, args, count);
+}
+
 bool NBLog::LockedWriter::isEnabled() const
 {
     Mutex::Autolock _l(mLock);
@@ -275,15 +341,17 @@ bool NBLog::LockedWriter::setEnabled(bool enabled)
 NBLog::Reader::Reader(size_t size, const void *shared)
     : mSize(roundup(size)), mShared((const Shared *) shared), mFront(0)
 {
+    memset(mPhases, 0, sizeof(mPhases));
 }
 
 NBLog::Reader::Reader(size_t size, const sp<IMemory>& iMemory)
     : mSize(roundup(size)), mShared(iMemory != 0 ? (const Shared *) iMemory->pointer() : NULL),
       mIMemory(iMemory), mFront(0)
 {
+    memset(mPhases, 0, sizeof(mPhases));
 }
 
-void NBLog::Reader::dump(int fd, size_t indent)
+void NBLog::Reader::dump(int fd, size_t indent, bool trace)
 {
     int32_t rear = android_atomic_acquire_load(&mShared->mRear);
     size_t avail = rear - mFront;
@@ -342,6 +410,19 @@ void NBLog::Reader::dump(int fd, size_t indent)
     mIndent = indent;
     String8 timestamp, body;
     lost += i;
+    if (trace) {
+        // only the binary events, each with its own timestamp
+        while (i < avail) {
+            event = (Event) copy[i];
+            length = copy[i + 1];
+            if (event == EVENT_FORMAT || event == EVENT_BINARY) {
+                dumpEvent(&copy[i + 2], length, event, true /*trace*/);
+            }
+            i += length + 3;
+        }
+        delete[] copy;
+        return;
+    }
     if (lost > 0) {
         body.appendFormat("warning: lost %zu bytes worth of events", lost);
         // TODO timestamp empty here, only other choice to wait for the first timestamp event in the
@@ -416,6 +497,16 @@ void NBLog::Reader::dump(int fd, size_t indent)
                     (int) (ts.tv_nsec / 1000000));
             deferredTimestamp = true;
             } break;
+        case EVENT_FORMAT:
+            dumpEvent((const uint8_t *) data, length, event, false /*trace*/);
+            break;
+        case EVENT_BINARY:
+            if (deferredTimestamp) {
+                dumpLine(timestamp, body);
+                deferredTimestamp = false;
+            }
+            dumpEvent((const uint8_t *) data, length, event, false /*trace*/);
+            break;
         case EVENT_RESERVED:
         default:
             body.appendFormat("warning: unknown event %d", event);
@@ -445,6 +536,160 @@ void NBLog::Reader::dumpLine(const String8& timestamp, String8& body)
     body.clear();
 }
 
+void NBLog::Reader::dumpEvent(const uint8_t *data, size_t length, Event event, bool trace)
+{
+    if (length < 1) {
+        return;
+    }
+    const uint8_t id = data[0];
+    if (event == EVENT_FORMAT) {
+        if (length >= 2) {
+            mPhases[id] = data[1];
+            mFormats[id].setTo((const char *) &data[2], length - 2);
+        }
+        return;
+    }
+    if (length < 1 + sizeof(int64_t)) {
+        return;
+    }
+    int64_t ns;
+    memcpy(&ns, &data[1], sizeof(int64_t));
+    int32_t args[kMaxEventArgs];
+    size_t count = (length - 1 - sizeof(int64_t)) / sizeof(int32_t);
+    if (count > kMaxEventArgs) {
+        count = kMaxEventArgs;
+    }
+    memcpy(args, &data[1 + sizeof(int64_t)], count * sizeof(int32_t));
+
+    FormatStats& stats = mStats[id];
+    if (stats.mCount > 0 && ns > stats.mPrevNs) {
+        uint64_t us = (ns - stats.mPrevNs) / 1000;
+        size_t bucket = 0;
+        while (us > 1 && bucket < FormatStats::kIntervalBuckets - 1) {
+            us >>= 1;
+            bucket++;
+        }
+        stats.mIntervals[bucket]++;
+    }
+    stats.mCount++;
+    stats.mPrevNs = ns;
+    if (count > 0) {
+        if (stats.mArgCount == 0 || args[0] < stats.mArgMin) {
+            stats.mArgMin = args[0];
+        }
+        if (stats.mArgCount == 0 || args[0] > stats.mArgMax) {
+            stats.mArgMax = args[0];
+        }
+        stats.mArgSum += args[0];
+        stats.mArgCount++;
+    }
+
+    String8 body;
+    expand(body, id, args, count);
+    if (trace) {
+        if (mFd >= 0) {
+            dprintf(mFd, "%lld\t%c\t%u\t%s\t%s\n", (long long) ns,
+                    mPhases[id] != 0 ? mPhases[id] : 'i', id,
+                    mFormats[id].isEmpty() ? "?" : mFormats[id].string(), body.string());
+        }
+        return;
+    }
+    String8 timestamp;
+    timestamp.appendFormat("[%d.%03d]", (int) (ns / 1000000000), (int) ((ns / 1000000) % 1000));
+    dumpLine(timestamp, body);
+}
+
+void NBLog::Reader::expand(String8& out, uint8_t id, const int32_t *args, size_t count) const
+{
+    const String8& format = mFormats[id];
+    if (format.isEmpty()) {
+        // the format was lost before the reader saw it
+        out.appendFormat("event %u:", id);
+        for (size_t i = 0; i < count; i++) {
+            out.appendFormat(" %d", args[i]);
+        }
+        return;
+    }
+    const char *fmt = format.string();
+    size_t arg = 0;
+    while (*fmt != '\0') {
+        if (*fmt != '%') {
+            const char *next = strchr(fmt, '%');
+            size_t n = next != NULL ? (size_t) (next - fmt) : strlen(fmt);
+            out.append(fmt, n);
+            fmt += n;
+            continue;
+        }
+        if (fmt[1] == '%') {
+            out.append("%");
+            fmt += 2;
+            continue;
+        }
+        // copy the conversion specification: flags and width only
+        char spec[16];
+        size_t n = 0;
+        spec[n++] = *fmt++;
+        while (*fmt != '\0' && strchr("-+ #0123456789", *fmt) != NULL && n < sizeof(spec) - 2) {
+            spec[n++] = *fmt++;
+        }
+        const char conversion = *fmt;
+        if (conversion == '\0') {
+            break;
+        }
+        fmt++;
+        if (arg >= count) {
+            out.append("?");
+            continue;
+        }
+        if (strchr("diuxXc", conversion) != NULL) {
+            spec[n++] = conversion;
+            spec[n] = '\0';
+            out.appendFormat(spec, args[arg]);
+        } else {
+            out.append("?");
+        }
+        arg++;
+    }
+}
+
+void NBLog::Reader::dumpStats(int fd, size_t indent)
+{
+    mFd = fd;
+    mIndent = indent;
+    String8 timestamp, body;
+    for (size_t id = 0; id < kMaxFormats; id++) {
+        const FormatStats& stats = mStats[id];
+        if (stats.mCount == 0) {
+            continue;
+        }
+        body.appendFormat("\"%s\": count %llu", mFormats[id].isEmpty() ? "?" :
+                mFormats[id].string(), (unsigned long long) stats.mCount);
+        if (stats.mArgCount > 0) {
+            body.appendFormat(", arg min %d mean %.1f max %d", stats.mArgMin,
+                    (double) stats.mArgSum / stats.mArgCount, stats.mArgMax);
+        }
+        dumpLine(timestamp, body);
+        // interval histogram, skipping the empty buckets at both ends
+        size_t first = 0;
+        size_t last = FormatStats::kIntervalBuckets;
+        while (first < last && stats.mIntervals[first] == 0) {
+            first++;
+        }
+        while (last > first && stats.mIntervals[last - 1] == 0) {
+            last--;
+        }
+        for (size_t i = first; i < last; i++) {
+            if (i == FormatStats::kIntervalBuckets - 1) {
+                body.appendFormat("  interval >= %u us: %u", 1u << i, stats.mIntervals[i]);
+            } else {
+                body.appendFormat("  interval %u to %u us: %u", i == 0 ? 0 : 1u << i,
+                        1u << (i + 1), stats.mIntervals[i]);
+            }
+            dumpLine(timestamp, body);
+        }
+    }
+}
+
 bool NBLog::Reader::isIMemory(const sp<IMemory>& iMemory) const
 {
     return iMemory != 0 && mIMemory != 0 && iMemory->pointer() == mIMemory->pointer();
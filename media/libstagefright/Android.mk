@@ -18,6 +18,7 @@ LOCAL_SRC_FILES:=                         \
         CodecBase.cpp                     \
         DataSource.cpp                    \
         DataURISource.cpp                 \
+        DiskCachedSource.cpp              \
         DRMExtractor.cpp                  \
         ESDS.cpp                          \
         FileSource.cpp                    \
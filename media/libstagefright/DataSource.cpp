@@ -19,6 +19,7 @@
 #include "include/AMRExtractor.h"
 #include "include/AVIExtractor.h"
 #include "include/AACExtractor.h"
+#include "include/DiskCachedSource.h"
 #include "include/DRMExtractor.h"
 #include "include/FLACExtractor.h"
 #include "include/HTTPBase.h"
@@ -221,6 +222,19 @@ sp<DataSource> DataSource::CreateFromURI(
             httpSource = new MediaHTTP(conn);
         }
 
+        // Owns the source while it is passed around as a raw pointer.
+        sp<HTTPBase> httpSourceRef = httpSource;
+
+        if (!isWidevine) {
+            sp<DiskCachedSource> diskCachedSource =
+                DiskCachedSource::Create(httpSource);
+
+            if (diskCachedSource != NULL) {
+                httpSourceRef = diskCachedSource;
+                httpSource = diskCachedSource.get();
+            }
+        }
+
         String8 tmp;
         if (isWidevine) {
             tmp = String8("http://");
@@ -0,0 +1,653 @@
+/*
+ * Copyright (C) 2015 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+//#define LOG_NDEBUG 0
+#define LOG_TAG "DiskCachedSource"
+#include <utils/Log.h>
+
+#include "include/DiskCachedSource.h"
+
+#include <cutils/properties.h>
+#include <media/stagefright/foundation/ADebug.h>
+#include <media/stagefright/foundation/ALooper.h>
+#include <media/stagefright/foundation/AMessage.h>
+#include <utils/Vector.h>
+
+#include <dirent.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <inttypes.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/file.h>
+#include <sys/stat.h>
+#include <sys/time.h>
+#include <unistd.h>
+
+namespace android {
+
+static const char *kIndexMagic = "DiskCachedSource 1";
+
+static uint64_t HashURI(const char *uri) {
+    // FNV-1a
+    uint64_t hash = 14695981039346656037ull;
+    for (const char *ptr = uri; *ptr != '\0'; ++ptr) {
+        hash ^= (uint8_t)*ptr;
+        hash *= 1099511628211ull;
+    }
+    return hash;
+}
+
+// Locks the entry whose data file is open as fd, without waiting. Fails if
+// another instance, of this process or another, holds the entry, or if the
+// file was evicted before it was locked.
+static bool LockEntry(int fd, const char *dataPath) {
+    if (flock(fd, LOCK_EX | LOCK_NB) < 0) {
+        return false;
+    }
+
+    struct stat st, pathSt;
+    return fstat(fd, &st) == 0 && stat(dataPath, &pathSt) == 0
+            && st.st_dev == pathSt.st_dev && st.st_ino == pathSt.st_ino;
+}
+
+static bool HasCredentials(const KeyedVector<String8, String8> *headers) {
+    if (headers == NULL) {
+        return false;
+    }
+
+    for (size_t i = 0; i < headers->size(); ++i) {
+        const char *key = headers->keyAt(i).string();
+        if (!strcasecmp(key, "Authorization") || !strcasecmp(key, "Cookie")) {
+            return true;
+        }
+    }
+
+    return false;
+}
+
+// static
+sp<DiskCachedSource> DiskCachedSource::Create(const sp<HTTPBase> &source) {
+    char dir[PROPERTY_VALUE_MAX];
+    if (!property_get("media.stagefright.disk-cache-dir", dir, NULL)) {
+        return NULL;
+    }
+
+    int64_t maxCacheSizeMB = kDefaultMaxCacheSizeMB;
+
+    char value[PROPERTY_VALUE_MAX];
+    if (property_get("media.stagefright.disk-cache-mb", value, NULL)) {
+        char *end;
+        long long x = strtoll(value, &end, 10);
+        if (end > value && *end == '\0' && x >= 0) {
+            maxCacheSizeMB = x;
+        }
+    }
+
+    if (maxCacheSizeMB == 0) {
+        return NULL;
+    }
+
+    if (mkdir(dir, 0700) < 0 && errno != EEXIST) {
+        ALOGW("unable to create cache directory %s (%s)", dir, strerror(errno));
+        return NULL;
+    }
+
+    return Create(source, dir, maxCacheSizeMB * 1024 * 1024);
+}
+
+// static
+sp<DiskCachedSource> DiskCachedSource::Create(
+        const sp<HTTPBase> &source, const char *cacheDir,
+        off64_t maxCacheSize) {
+    return new DiskCachedSource(source, cacheDir, maxCacheSize);
+}
+
+DiskCachedSource::DiskCachedSource(
+        const sp<HTTPBase> &source, const char *cacheDir,
+        off64_t maxCacheSize)
+    : mSource(source),
+      mCacheDir(cacheDir),
+      mMaxCacheSize(maxCacheSize),
+      mReflector(new AHandlerReflector<DiskCachedSource>(this)),
+      mLooper(new ALooper),
+      mUpdatePending(false),
+      mIndexGeneration(0),
+      mIndexWrittenGeneration(0),
+      mDataFd(-1),
+      mSize(-1),
+      mNumBytesSinceIndexUpdate(0) {
+    mLooper->setName("DiskCachedSource");
+    mLooper->registerHandler(mReflector);
+    mLooper->start(false /* runOnCallingThread */, false /* canCallJava */,
+                   PRIORITY_BACKGROUND);
+}
+
+DiskCachedSource::~DiskCachedSource() {
+    mLooper->stop();
+    mLooper->unregisterHandler(mReflector->id());
+
+    Mutex::Autolock autoLock(mLock);
+    closeEntry_l();
+}
+
+status_t DiskCachedSource::connect(
+        const char *uri,
+        const KeyedVector<String8, String8> *headers,
+        off64_t offset) {
+    status_t err = mSource->connect(uri, headers, offset);
+
+    Mutex::Autolock autoLock(mLock);
+
+    closeEntry_l();
+
+    if (err != OK) {
+        return err;
+    }
+
+    if (HasCredentials(headers)) {
+        // The response may well depend on who is asking.
+        ALOGV("not caching a request with credentials");
+        return OK;
+    }
+
+    openEntry_l(uri);
+
+    return OK;
+}
+
+void DiskCachedSource::disconnect() {
+    // No lock, this is meant to interrupt a pending readAt().
+    mSource->disconnect();
+}
+
+status_t DiskCachedSource::initCheck() const {
+    return mSource->initCheck();
+}
+
+ssize_t DiskCachedSource::readAt(off64_t offset, void *data, size_t size) {
+    {
+        Mutex::Autolock autoLock(mLock);
+
+        size_t avail = size;
+        if (mSize >= 0 && offset + (off64_t)size > mSize) {
+            avail = (offset < mSize) ? mSize - offset : 0;
+        }
+
+        if (mDataFd >= 0 && avail > 0 && isCached_l(offset, avail)) {
+            ssize_t n = pread64(mDataFd, data, avail, offset);
+            if (n == (ssize_t)avail) {
+                return n;
+            }
+
+            ALOGW("failed to read cached data at %" PRId64 " (%s)",
+                  offset, strerror(errno));
+        }
+    }
+
+    ssize_t n = mSource->readAt(offset, data, size);
+
+    if (n <= 0) {
+        return n;
+    }
+
+    Mutex::Autolock autoLock(mLock);
+
+    if (mDataFd < 0) {
+        return n;
+    }
+
+    if (pwrite64(mDataFd, data, n, offset) != n) {
+        ALOGW("failed to cache data at %" PRId64 " (%s), caching stopped",
+              offset, strerror(errno));
+
+        closeEntry_l();
+        return n;
+    }
+
+    addRange_l(offset, n);
+
+    mNumBytesSinceIndexUpdate += n;
+    if (mNumBytesSinceIndexUpdate >= kIndexUpdateIntervalBytes) {
+        postUpdateCache_l();
+    }
+
+    return n;
+}
+
+status_t DiskCachedSource::getSize(off64_t *size) {
+    return mSource->getSize(size);
+}
+
+uint32_t DiskCachedSource::flags() {
+    return mSource->flags();
+}
+
+status_t DiskCachedSource::reconnectAtOffset(off64_t offset) {
+    return mSource->reconnectAtOffset(offset);
+}
+
+sp<DecryptHandle> DiskCachedSource::DrmInitialization(const char *mime) {
+    return mSource->DrmInitialization(mime);
+}
+
+void DiskCachedSource::getDrmInfo(
+        sp<DecryptHandle> &handle, DrmManagerClient **client) {
+    mSource->getDrmInfo(handle, client);
+}
+
+String8 DiskCachedSource::getUri() {
+    return mSource->getUri();
+}
+
+String8 DiskCachedSource::getMIMEType() const {
+    return mSource->getMIMEType();
+}
+
+bool DiskCachedSource::estimateBandwidth(int32_t *bandwidth_bps) {
+    return mSource->estimateBandwidth(bandwidth_bps);
+}
+
+status_t DiskCachedSource::getEstimatedBandwidthKbps(int32_t *kbps) {
+    return mSource->getEstimatedBandwidthKbps(kbps);
+}
+
+status_t DiskCachedSource::setBandwidthStatCollectFreq(int32_t freqMs) {
+    return mSource->setBandwidthStatCollectFreq(freqMs);
+}
+
+void DiskCachedSource::openEntry_l(const char *uri) {
+    if (strchr(uri, '\n') != NULL) {
+        return;
+    }
+
+    // Without a length there is nothing to validate an entry against.
+    off64_t size;
+    if (mSource->getSize(&size) != OK || size <= 0) {
+        ALOGV("not caching a resource of unknown size");
+        return;
+    }
+
+    mURI = uri;
+    mSize = size;
+    mMIMEType = mSource->getMIMEType().string();
+
+    mPath = StringPrintf(
+            "%s/%016" PRIx64, mCacheDir.c_str(), HashURI(uri));
+
+    AString dataPath = mPath;
+    dataPath.append(".data");
+
+    int fd = open(dataPath.c_str(), O_RDWR | O_CREAT, 0600);
+    if (fd < 0) {
+        ALOGW("unable to open %s (%s)", dataPath.c_str(), strerror(errno));
+        mPath.clear();
+        return;
+    }
+
+    // The entry is written by one instance at a time, which the others
+    // neither read from nor delete.
+    if (!LockEntry(fd, dataPath.c_str())) {
+        ALOGV("%s is in use, not caching", dataPath.c_str());
+        close(fd);
+        mPath.clear();
+        return;
+    }
+
+    if (!readIndex_l()) {
+        // Unknown, or the resource changed since. The index goes first so
+        // that it never lists data that isn't there.
+        AString indexPath = mPath;
+        indexPath.append(".index");
+        unlink(indexPath.c_str());
+
+        mRanges.clear();
+        if (ftruncate(fd, 0) < 0) {
+            ALOGW("unable to truncate %s (%s)",
+                  dataPath.c_str(), strerror(errno));
+            close(fd);
+            mPath.clear();
+            return;
+        }
+    }
+
+    mDataFd = fd;
+
+    // The modification time orders the entries for eviction.
+    utimes(dataPath.c_str(), NULL);
+
+    ALOGV("caching '%s' in %s, %zu ranges cached",
+          uri, dataPath.c_str(), mRanges.size());
+
+    // Make room for what this entry is about to receive.
+    postUpdateCache_l();
+}
+
+void DiskCachedSource::closeEntry_l(bool discard) {
+    if (mDataFd >= 0) {
+        if (!discard && mNumBytesSinceIndexUpdate > 0) {
+            uint32_t generation;
+            AString index = formatIndex_l(&generation);
+            writeIndex(mPath, index, generation, mDataFd);
+        }
+
+        if (discard) {
+            // While the entry is still locked.
+            AString path = mPath;
+            path.append(".index");
+            unlink(path.c_str());
+
+            path = mPath;
+            path.append(".data");
+            unlink(path.c_str());
+        }
+
+        close(mDataFd);
+        mDataFd = -1;
+    }
+
+    mPath.clear();
+    mRanges.clear();
+    mNumBytesSinceIndexUpdate = 0;
+    mSize = -1;
+}
+
+bool DiskCachedSource::readIndex_l() {
+    AString indexPath = mPath;
+    indexPath.append(".index");
+
+    FILE *file = fopen(indexPath.c_str(), "r");
+    if (file == NULL) {
+        return false;
+    }
+
+    AString contents;
+    char buffer[1024];
+    size_t n;
+    while ((n = fread(buffer, 1, sizeof(buffer), file)) > 0) {
+        contents.append(buffer, n);
+    }
+    fclose(file);
+
+    // magic, size, MIME type and URI, then one range per line
+    Vector<AString> lines;
+    size_t start = 0;
+    ssize_t end;
+    while ((end = contents.find("\n", start)) >= 0) {
+        lines.push(AString(contents, start, end - start));
+        start = end + 1;
+    }
+
+    if (lines.size() < 4
+            || lines.itemAt(0) != kIndexMagic
+            || strtoll(lines.itemAt(1).c_str(), NULL, 10) != mSize
+            || lines.itemAt(2) != mMIMEType
+            || lines.itemAt(3) != mURI) {
+        return false;
+    }
+
+    mRanges.clear();
+    for (size_t i = 4; i < lines.size(); ++i) {
+        long long offset, length;
+        if (sscanf(lines.itemAt(i).c_str(), "%lld %lld", &offset, &length) != 2
+                || offset < 0 || length <= 0 || offset + length > mSize) {
+            return false;
+        }
+        addRange_l(offset, length);
+    }
+
+    return true;
+}
+
+AString DiskCachedSource::formatIndex_l(uint32_t *generation) {
+    mNumBytesSinceIndexUpdate = 0;
+    *generation = ++mIndexGeneration;
+
+    AString index = StringPrintf("%s\n%" PRId64 "\n%s\n%s\n",
+            kIndexMagic, mSize, mMIMEType.c_str(), mURI.c_str());
+
+    for (size_t i = 0; i < mRanges.size(); ++i) {
+        index.append(StringPrintf("%" PRId64 " %" PRId64 "\n",
+                mRanges.keyAt(i), mRanges.valueAt(i) - mRanges.keyAt(i)));
+    }
+
+    return index;
+}
+
+void DiskCachedSource::writeIndex(
+        const AString &path, const AString &index, uint32_t generation,
+        int dataFd) {
+    Mutex::Autolock autoLock(mIndexLock);
+
+    if (path == mIndexWrittenPath && generation <= mIndexWrittenGeneration) {
+        // closeEntry_l() got ahead of us with a more recent one.
+        return;
+    }
+    mIndexWrittenPath = path;
+    mIndexWrittenGeneration = generation;
+
+    AString indexPath = path;
+    indexPath.append(".index");
+
+    AString tmpPath = indexPath;
+    tmpPath.append(".tmp");
+
+    int fd = open(tmpPath.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0600);
+    FILE *file = (fd >= 0) ? fdopen(fd, "w") : NULL;
+    if (file == NULL) {
+        if (fd >= 0) {
+            close(fd);
+        }
+        ALOGW("unable to write %s (%s)", tmpPath.c_str(), strerror(errno));
+        return;
+    }
+
+    // The data the index refers to must be on disk before the index is.
+    fdatasync(dataFd);
+
+    bool ok = fwrite(index.c_str(), 1, index.size(), file) == index.size()
+            && fflush(file) == 0 && fsync(fileno(file)) == 0;
+    fclose(file);
+
+    if (!ok || rename(tmpPath.c_str(), indexPath.c_str()) < 0) {
+        ALOGW("unable to write %s (%s)", indexPath.c_str(), strerror(errno));
+        unlink(tmpPath.c_str());
+    }
+}
+
+bool DiskCachedSource::isCached_l(off64_t offset, size_t size) const {
+    for (size_t i = 0; i < mRanges.size(); ++i) {
+        if (mRanges.keyAt(i) <= offset
+                && offset + (off64_t)size <= mRanges.valueAt(i)) {
+            return true;
+        }
+    }
+
+    return false;
+}
+
+void DiskCachedSource::addRange_l(off64_t offset, size_t size) {
+    off64_t start = offset;
+    off64_t end = offset + size;
+
+    // Absorb the ranges overlapping or adjacent to the new one.
+    for (size_t i = mRanges.size(); i-- > 0;) {
+        if (mRanges.keyAt(i) <= end && mRanges.valueAt(i) >= start) {
+            if (mRanges.keyAt(i) < start) {
+                start = mRanges.keyAt(i);
+            }
+            if (mRanges.valueAt(i) > end) {
+                end = mRanges.valueAt(i);
+            }
+            mRanges.removeItemsAt(i);
+        }
+    }
+
+    mRanges.add(start, end);
+}
+
+void DiskCachedSource::postUpdateCache_l() {
+    if (!mUpdatePending) {
+        mUpdatePending = true;
+        (new AMessage(kWhatUpdateCache, mReflector->id()))->post();
+    }
+}
+
+void DiskCachedSource::onUpdateCache() {
+    AString path;
+    AString index;
+    uint32_t generation = 0;
+    int dataFd = -1;
+
+    {
+        Mutex::Autolock autoLock(mLock);
+        mUpdatePending = false;
+
+        if (mDataFd < 0) {
+            return;
+        }
+
+        path = mPath;
+        if (mNumBytesSinceIndexUpdate > 0) {
+            index = formatIndex_l(&generation);
+
+            // closeEntry_l() may close ours meanwhile.
+            dataFd = dup(mDataFd);
+        }
+    }
+
+    if (dataFd >= 0) {
+        writeIndex(path, index, generation, dataFd);
+        close(dataFd);
+    }
+
+    if (!trimCache(path)) {
+        Mutex::Autolock autoLock(mLock);
+        if (mPath == path) {
+            ALOGI("cache full, caching stopped");
+            closeEntry_l(true /* discard */);
+        }
+    }
+}
+
+bool DiskCachedSource::trimCache(const AString &currentPath) {
+    struct Entry {
+        AString mPath;  // without extension
+        time_t mTime;
+        off64_t mSize;
+    };
+
+    DIR *dir = opendir(mCacheDir.c_str());
+    if (dir == NULL) {
+        return true;
+    }
+
+    Vector<Entry> entries;
+    off64_t totalSize = 0;
+    off64_t currentSize = 0;
+
+    struct dirent *ent;
+    while ((ent = readdir(dir)) != NULL) {
+        size_t len = strlen(ent->d_name);
+        if (len <= 5 || strcmp(ent->d_name + len - 5, ".data")) {
+            continue;
+        }
+
+        Entry entry;
+        entry.mPath = StringPrintf("%s/%s", mCacheDir.c_str(), ent->d_name);
+
+        struct stat st;
+        if (stat(entry.mPath.c_str(), &st) < 0) {
+            continue;
+        }
+
+        entry.mPath.erase(entry.mPath.size() - 5, 5);
+        entry.mTime = st.st_mtime;
+        // What the sparse file really takes.
+        entry.mSize = (off64_t)st.st_blocks * 512;
+
+        totalSize += entry.mSize;
+        if (entry.mPath == currentPath) {
+            currentSize = entry.mSize;
+        } else {
+            entries.push(entry);
+        }
+    }
+    closedir(dir);
+
+    while (totalSize > mMaxCacheSize) {
+        ssize_t oldest = -1;
+        for (size_t i = 0; i < entries.size(); ++i) {
+            if (oldest < 0
+                    || entries.itemAt(i).mTime < entries.itemAt(oldest).mTime) {
+                oldest = i;
+            }
+        }
+
+        if (oldest < 0) {
+            // What is left is in use; only if the current entry is too large
+            // alone must it go.
+            return currentSize <= mMaxCacheSize;
+        }
+
+        Entry entry = entries.itemAt(oldest);
+        entries.removeAt(oldest);
+
+        AString dataPath = entry.mPath;
+        dataPath.append(".data");
+
+        int fd = open(dataPath.c_str(), O_RDWR);
+        if (fd < 0) {
+            // Evicted by another instance meanwhile.
+            totalSize -= entry.mSize;
+            continue;
+        }
+
+        if (!LockEntry(fd, dataPath.c_str())) {
+            ALOGV("not evicting %s, in use", entry.mPath.c_str());
+            close(fd);
+            continue;
+        }
+
+        ALOGV("evicting %s", entry.mPath.c_str());
+
+        AString indexPath = entry.mPath;
+        indexPath.append(".index");
+        unlink(indexPath.c_str());
+        unlink(dataPath.c_str());
+        close(fd);
+
+        totalSize -= entry.mSize;
+    }
+
+    return true;
+}
+
+void DiskCachedSource::onMessageReceived(const sp<AMessage> &msg) {
+    switch (msg->what()) {
+        case kWhatUpdateCache:
+        {
+            onUpdateCache();
+            break;
+        }
+
+        default:
+            TRESPASS();
+    }
+}
+
+}  // namespace android
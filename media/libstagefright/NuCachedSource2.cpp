@@ -45,6 +45,12 @@ struct PageCache {
     void appendPage(Page *page);
     size_t releaseFromStart(size_t maxBytes);
 
+    // Moves all pages of "other" behind ours.
+    void appendCache(PageCache *other);
+
+    // Returns the memory of released pages to the system.
+    void freeReleasedPages();
+
     size_t totalSize() const {
         return mTotalSize;
     }
@@ -112,6 +118,24 @@ void PageCache::appendPage(Page *page) {
     mActivePages.push_back(page);
 }
 
+void PageCache::appendCache(PageCache *other) {
+    List<Page *>::iterator it = other->mActivePages.begin();
+    while (it != other->mActivePages.end()) {
+        mActivePages.push_back(*it);
+        ++it;
+    }
+
+    mTotalSize += other->mTotalSize;
+
+    other->mActivePages.clear();
+    other->mTotalSize = 0;
+}
+
+void PageCache::freeReleasedPages() {
+    freePages(&mFreePages);
+    mFreePages.clear();
+}
+
 size_t PageCache::releaseFromStart(size_t maxBytes) {
     size_t bytesReleased = 0;
 
@@ -197,6 +221,9 @@ NuCachedSource2::NuCachedSource2(
       mHighwaterThresholdBytes(kDefaultHighWaterThreshold),
       mLowwaterThresholdBytes(kDefaultLowWaterThreshold),
       mKeepAliveIntervalUs(kDefaultKeepAliveIntervalUs),
+      mMaxRetainedBytes(kDefaultMaxRetainedBytes),
+      mRetainedBytes(0),
+      mAccessCounter(0),
       mDisconnectAtHighwatermark(disconnectAtHighwatermark) {
     // We are NOT going to support disconnect-at-highwatermark indefinitely
     // and we are not guaranteeing support for client-specified cache
@@ -235,6 +262,11 @@ NuCachedSource2::~NuCachedSource2() {
 
     delete mCache;
     mCache = NULL;
+
+    for (size_t i = 0; i < mRanges.size(); ++i) {
+        delete mRanges.itemAt(i).mCache;
+    }
+    mRanges.clear();
 }
 
 status_t NuCachedSource2::getEstimatedBandwidthKbps(int32_t *kbps) {
@@ -311,11 +343,22 @@ void NuCachedSource2::fetchInternal() {
     ALOGV("fetchInternal");
 
     bool reconnect = false;
+    size_t maxBytes = kPageSize;
 
     {
         Mutex::Autolock autoLock(mLock);
         CHECK(mFinalStatus == OK || mNumRetriesLeft > 0);
 
+        // Stop short of data we have already, so that it can be merged.
+        off64_t fetchOffset = mCacheOffset + mCache->totalSize();
+        for (size_t i = 0; i < mRanges.size(); ++i) {
+            off64_t rangeOffset = mRanges.itemAt(i).mOffset;
+            if (rangeOffset > fetchOffset
+                    && rangeOffset - fetchOffset < (off64_t)maxBytes) {
+                maxBytes = rangeOffset - fetchOffset;
+            }
+        }
+
         if (mFinalStatus != OK) {
             --mNumRetriesLeft;
 
@@ -349,7 +392,7 @@ void NuCachedSource2::fetchInternal() {
     PageCache::Page *page = mCache->acquirePage();
 
     ssize_t n = mSource->readAt(
-            mCacheOffset + mCache->totalSize(), page->mData, kPageSize);
+            mCacheOffset + mCache->totalSize(), page->mData, maxBytes);
 
     Mutex::Autolock autoLock(mLock);
 
@@ -379,6 +422,8 @@ void NuCachedSource2::fetchInternal() {
 
         page->mSize = n;
         mCache->appendPage(page);
+
+        mergeFollowingRange_l();
     }
 }
 
@@ -522,6 +567,12 @@ ssize_t NuCachedSource2::readAt(off64_t offset, void *data, size_t size) {
         return size;
     }
 
+    // Or from a range retained from an earlier seek, without disturbing
+    // the prefetcher.
+    if (readFromRange_l(offset, data, size)) {
+        return size;
+    }
+
     sp<AMessage> msg = new AMessage(kWhatRead, mReflector->id());
     msg->setInt64("offset", offset);
     msg->setPointer("data", data);
@@ -583,13 +634,8 @@ ssize_t NuCachedSource2::readInternal(off64_t offset, void *data, size_t size) {
 
     Mutex::Autolock autoLock(mLock);
 
-    if (!mFetching) {
-        mLastAccessPos = offset;
-        restartPrefetcherIfNecessary_l(
-                false, // ignoreLowWaterThreshold
-                true); // force
-    }
-
+    // Seek first, so that the current range is retained before the
+    // prefetcher gets restarted and releases what lies behind offset.
     if (offset < mCacheOffset
             || offset >= (off64_t)(mCacheOffset + mCache->totalSize())) {
         static const off64_t kPadding = 256 * 1024;
@@ -600,9 +646,29 @@ ssize_t NuCachedSource2::readInternal(off64_t offset, void *data, size_t size) {
         // does not trigger another seek.
         off64_t seekOffset = (offset > kPadding) ? offset - kPadding : 0;
 
+        if (findRange_l(offset) >= 0) {
+            // Resume fetching where that range ends instead.
+            seekOffset = offset;
+        } else {
+            // Don't start inside a retained range either, its bytes would be
+            // fetched a second time.
+            ssize_t index = findRange_l(seekOffset);
+            if (index >= 0) {
+                const CachedRange &range = mRanges.itemAt(index);
+                seekOffset = range.mOffset + range.mCache->totalSize();
+            }
+        }
+
         seekInternal_l(seekOffset);
     }
 
+    if (!mFetching) {
+        mLastAccessPos = offset;
+        restartPrefetcherIfNecessary_l(
+                false, // ignoreLowWaterThreshold
+                true); // force
+    }
+
     size_t delta = offset - mCacheOffset;
 
     if (mFinalStatus != OK && mNumRetriesLeft == 0) {
@@ -642,10 +708,45 @@ status_t NuCachedSource2::seekInternal_l(off64_t offset) {
 
     ALOGI("new range: offset= %lld", offset);
 
-    mCacheOffset = offset;
+    // Keep the current range around, and continue in a retained range that
+    // holds offset if there is one.
+    ssize_t index = findRange_l(offset);
+
+    if (mCache->totalSize() > 0) {
+        mCache->freeReleasedPages();
+
+        CachedRange range;
+        range.mOffset = mCacheOffset;
+        range.mCache = mCache;
+        range.mLastAccess = ++mAccessCounter;
+        mRanges.push(range);
+        mRetainedBytes += mCache->totalSize();
+
+        mCache = NULL;
+    }
+
+    if (index >= 0) {
+        const CachedRange &range = mRanges.itemAt(index);
+
+        ALOGV("resuming retained range at %lld, %zu bytes",
+              range.mOffset, range.mCache->totalSize());
 
-    size_t totalSize = mCache->totalSize();
-    CHECK_EQ(mCache->releaseFromStart(totalSize), totalSize);
+        delete mCache;
+        mCache = range.mCache;
+        mCacheOffset = range.mOffset;
+
+        mRetainedBytes -= mCache->totalSize();
+        mRanges.removeAt(index);
+
+        mergeFollowingRange_l();
+    } else {
+        if (mCache == NULL) {
+            mCache = new PageCache(kPageSize);
+        }
+        mCacheOffset = offset;
+    }
+
+    evictRanges_l();
 
     mNumRetriesLeft = kMaxNumRetries;
     mFetching = true;
@@ -653,6 +754,91 @@ status_t NuCachedSource2::seekInternal_l(off64_t offset) {
     return OK;
 }
 
+ssize_t NuCachedSource2::findRange_l(off64_t offset) const {
+    for (size_t i = 0; i < mRanges.size(); ++i) {
+        const CachedRange &range = mRanges.itemAt(i);
+        if (offset >= range.mOffset
+                && offset < range.mOffset + (off64_t)range.mCache->totalSize()) {
+            return i;
+        }
+    }
+
+    return -1;
+}
+
+bool NuCachedSource2::readFromRange_l(off64_t offset, void *data, size_t size) {
+    ssize_t index = findRange_l(offset);
+    if (index < 0) {
+        return false;
+    }
+
+    CachedRange *range = &mRanges.editItemAt(index);
+    if (offset + size > range->mOffset + range->mCache->totalSize()) {
+        return false;
+    }
+
+    range->mCache->copy(offset - range->mOffset, data, size);
+    range->mLastAccess = ++mAccessCounter;
+
+    return true;
+}
+
+void NuCachedSource2::mergeFollowingRange_l() {
+    // The merged range may in turn be followed by another one.
+    for (;;) {
+        off64_t endOffset = mCacheOffset + mCache->totalSize();
+
+        ssize_t index = -1;
+        for (size_t i = 0; i < mRanges.size(); ++i) {
+            if (mRanges.itemAt(i).mOffset == endOffset) {
+                index = i;
+                break;
+            }
+        }
+
+        if (index < 0) {
+            return;
+        }
+
+        const CachedRange &range = mRanges.itemAt(index);
+
+        ALOGV("merging retained range at %lld, %zu bytes",
+              range.mOffset, range.mCache->totalSize());
+
+        mRetainedBytes -= range.mCache->totalSize();
+        mCache->appendCache(range.mCache);
+        delete range.mCache;
+        mRanges.removeAt(index);
+    }
+}
+
+void NuCachedSource2::evictRanges_l() {
+    while (mRetainedBytes > mMaxRetainedBytes) {
+        size_t lru = 0;
+        for (size_t i = 1; i < mRanges.size(); ++i) {
+            if (mRanges.itemAt(i).mLastAccess
+                    < mRanges.itemAt(lru).mLastAccess) {
+                lru = i;
+            }
+        }
+
+        CachedRange *range = &mRanges.editItemAt(lru);
+
+        // Release whole pages from its start, at least the excess.
+        size_t excess = mRetainedBytes - mMaxRetainedBytes;
+        size_t released = range->mCache->releaseFromStart(excess + kPageSize - 1);
+        range->mCache->freeReleasedPages();
+
+        range->mOffset += released;
+        mRetainedBytes -= released;
+
+        if (range->mCache->totalSize() == 0) {
+            delete range->mCache;
+            mRanges.removeAt(lru);
+        }
+    }
+}
+
 void NuCachedSource2::resumeFetchingIfNecessary() {
     Mutex::Autolock autoLock(mLock);
 
@@ -685,11 +871,13 @@ void NuCachedSource2::updateCacheParamsFromSystemProperty() {
 }
 
 void NuCachedSource2::updateCacheParamsFromString(const char *s) {
-    ssize_t lowwaterMarkKb, highwaterMarkKb;
+    ssize_t lowwaterMarkKb, highwaterMarkKb, retainedKb = -1;
     int keepAliveSecs;
 
-    if (sscanf(s, "%zd/%zd/%d",
-               &lowwaterMarkKb, &highwaterMarkKb, &keepAliveSecs) != 3) {
+    // The limit of the data retained outside the current range is optional.
+    if (sscanf(s, "%zd/%zd/%d/%zd",
+               &lowwaterMarkKb, &highwaterMarkKb, &keepAliveSecs,
+               &retainedKb) < 3) {
         ALOGE("Failed to parse cache parameters from '%s'.", s);
         return;
     }
@@ -719,10 +907,18 @@ void NuCachedSource2::updateCacheParamsFromString(const char *s) {
         mKeepAliveIntervalUs = kDefaultKeepAliveIntervalUs;
     }
 
-    ALOGV("lowwater = %zu bytes, highwater = %zu bytes, keepalive = %" PRId64 " us",
+    if (retainedKb >= 0) {
+        mMaxRetainedBytes = retainedKb * 1024;
+    } else {
+        mMaxRetainedBytes = kDefaultMaxRetainedBytes;
+    }
+
+    ALOGV("lowwater = %zu bytes, highwater = %zu bytes, keepalive = %" PRId64 " us, "
+          "retained = %zu bytes",
          mLowwaterThresholdBytes,
          mHighwaterThresholdBytes,
-         mKeepAliveIntervalUs);
+         mKeepAliveIntervalUs,
+         mMaxRetainedBytes);
 }
 
 // static
@@ -20,6 +20,8 @@
 
 #include <sys/time.h>
 
+#include <cpustats/ThreadCpuRegistry.h>
+
 #include "ALooper.h"
 
 #include "AHandler.h"
@@ -39,12 +41,18 @@ struct ALooper::LooperThread : public Thread {
 
     virtual status_t readyToRun() {
         mThreadId = androidGetThreadId();
+        ThreadCpuRegistry::registerThread("stagefright");
 
         return Thread::readyToRun();
     }
 
     virtual bool threadLoop() {
-        return mLooper->loop();
+        bool keepGoing = mLooper->loop();
+        if (!keepGoing || exitPending()) {
+            // last iteration, Thread won't call us again
+            ThreadCpuRegistry::unregisterThread();
+        }
+        return keepGoing;
     }
 
     bool isCurrentThread() const {
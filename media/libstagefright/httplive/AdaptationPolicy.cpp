@@ -0,0 +1,262 @@
+/*
+ * Copyright (C) 2015 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+//#define LOG_NDEBUG 0
+#define LOG_TAG "AdaptationPolicy"
+#include <utils/Log.h>
+
+#include "AdaptationPolicy.h"
+
+#include <cutils/properties.h>
+#include <media/stagefright/foundation/ADebug.h>
+
+#include <math.h>
+#include <string.h>
+
+namespace android {
+
+// Below this, connection setup dominates the measured rate.
+static const size_t kMinBytesForEstimate = 128 * 1024;
+
+const int64_t BandwidthEstimator::kSampleIntervalUs = 1000000ll;
+
+BandwidthEstimator::Average::Average(double halfLifeSecs)
+    : mHalfLifeSecs(halfLifeSecs),
+      mEstimate(0.0),
+      mTotalWeight(0.0) {
+}
+
+void BandwidthEstimator::Average::add(double bandwidthBps, double durationSecs) {
+    double alpha = pow(0.5, durationSecs / mHalfLifeSecs);
+    mEstimate = alpha * mEstimate + (1.0 - alpha) * bandwidthBps;
+    mTotalWeight = alpha * mTotalWeight + (1.0 - alpha);
+}
+
+double BandwidthEstimator::Average::value() const {
+    // Undo the bias toward the initial zero estimate.
+    return mEstimate / mTotalWeight;
+}
+
+BandwidthEstimator::BandwidthEstimator()
+    : mFast(2.0 /* halfLifeSecs */),
+      mSlow(5.0 /* halfLifeSecs */),
+      mTotalBytes(0),
+      mIntervalStartUs(0ll),
+      mIntervalBytes(0),
+      mIntervalBusyUs(0ll),
+      mBusyUntilUs(0ll) {
+}
+
+void BandwidthEstimator::addMeasurement(
+        size_t numBytes, int64_t startUs, int64_t endUs) {
+    if (endUs <= startUs) {
+        return;
+    }
+
+    Mutex::Autolock autoLock(mLock);
+
+    if (mIntervalBytes == 0) {
+        mIntervalStartUs = startUs;
+    }
+
+    // Only the part of the transfer that no other one covered yet adds to
+    // the time, overlapping transfers share it.
+    if (endUs > mBusyUntilUs) {
+        mIntervalBusyUs += endUs - (startUs > mBusyUntilUs ? startUs : mBusyUntilUs);
+        mBusyUntilUs = endUs;
+    }
+    mIntervalBytes += numBytes;
+
+    if (mBusyUntilUs - mIntervalStartUs >= kSampleIntervalUs) {
+        addSample_l();
+    }
+}
+
+void BandwidthEstimator::addSample_l() {
+    if (mIntervalBusyUs > 0) {
+        double durationSecs = mIntervalBusyUs / 1E6;
+        double bandwidthBps = mIntervalBytes * 8.0 / durationSecs;
+
+        ALOGV("%zu bytes in %.2f s: %.2f kbps",
+                mIntervalBytes, durationSecs, bandwidthBps / 1E3);
+
+        mFast.add(bandwidthBps, durationSecs);
+        mSlow.add(bandwidthBps, durationSecs);
+        mTotalBytes += mIntervalBytes;
+    }
+
+    mIntervalBytes = 0;
+    mIntervalBusyUs = 0ll;
+}
+
+bool BandwidthEstimator::estimateBandwidth(int32_t *bandwidthBps) {
+    Mutex::Autolock autoLock(mLock);
+    if (mTotalBytes < kMinBytesForEstimate) {
+        return false;
+    }
+
+    double estimate = mFast.value();
+    if (mSlow.value() < estimate) {
+        estimate = mSlow.value();
+    }
+    *bandwidthBps = estimate > 0x7fffffff ? 0x7fffffff : (int32_t)estimate;
+
+    return true;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+AdaptationPolicy::Status::Status()
+    : mBandwidthBps(-1),
+      mBufferedDurationUs(0ll),
+      mCurIndex(-1) {
+}
+
+// static
+sp<AdaptationPolicy> AdaptationPolicy::Create() {
+    char value[PROPERTY_VALUE_MAX];
+    if (property_get("media.httplive.abr", value, NULL)
+            && !strcmp(value, "throughput")) {
+        return new ThroughputPolicy;
+    }
+    return new BolaPolicy;
+}
+
+void AdaptationPolicy::setVariants(const Vector<int32_t> &bandwidthsBps) {
+    mBandwidthsBps = bandwidthsBps;
+}
+
+size_t AdaptationPolicy::highestVariantWithin(
+        int32_t bandwidthBps, double share) const {
+    size_t index = mBandwidthsBps.size() - 1;
+    while (index > 0 && mBandwidthsBps.itemAt(index) > bandwidthBps * share) {
+        --index;
+    }
+    return index;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+size_t ThroughputPolicy::pickVariant(const Status &status) {
+    if (mBandwidthsBps.size() < 2 || status.mBandwidthBps < 0) {
+        return 0;  // Pick the lowest bandwidth stream by default.
+    }
+
+    // consider only 80% of the available bandwidth, but if we are switching up,
+    // be even more conservative (70%) to avoid overestimating and immediately
+    // switching back.
+    ssize_t index = highestVariantWithin(status.mBandwidthBps, 0.8);
+    if (index > status.mCurIndex) {
+        index = highestVariantWithin(status.mBandwidthBps, 0.7);
+        if (status.mCurIndex >= 0 && index < status.mCurIndex) {
+            index = status.mCurIndex;
+        }
+    }
+
+    // Allow upwards bandwidth switch when a stream has buffered at least 10 seconds.
+    if (status.mCurIndex >= 0 && index > status.mCurIndex
+            && status.mBufferedDurationUs <= 10000000ll) {
+        index = status.mCurIndex;
+    }
+
+    return index;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+const int64_t BolaPolicy::kMinBufferUs = 3000000ll;
+const int64_t BolaPolicy::kTargetBufferUs = 9000000ll;
+
+BolaPolicy::BolaPolicy()
+    : mGp(0.0),
+      mV(0.0),
+      mStartup(true) {
+}
+
+void BolaPolicy::setVariants(const Vector<int32_t> &bandwidthsBps) {
+    AdaptationPolicy::setVariants(bandwidthsBps);
+
+    mStartup = true;
+    mUtilities.clear();
+    if (bandwidthsBps.size() < 2 || bandwidthsBps.itemAt(0) <= 0) {
+        return;
+    }
+
+    for (size_t i = 0; i < bandwidthsBps.size(); ++i) {
+        mUtilities.push(
+                1.0 + log((double)bandwidthsBps.itemAt(i) / bandwidthsBps.itemAt(0)));
+    }
+
+    // Solve for the lowest variant to win at kMinBufferUs and the highest
+    // one at kTargetBufferUs.
+    double minBufferSecs = kMinBufferUs / 1E6;
+    double targetBufferSecs = kTargetBufferUs / 1E6;
+    mGp = (mUtilities.top() - 1.0) / (targetBufferSecs / minBufferSecs - 1.0);
+    mV = minBufferSecs / mGp;
+
+    ALOGV("%zu variants, gp %.3f V %.3f", mUtilities.size(), mGp, mV);
+}
+
+size_t BolaPolicy::pickVariant(const Status &status) {
+    if (mUtilities.isEmpty() || mGp <= 0.0) {
+        return 0;
+    }
+
+    size_t throughputIndex = 0;
+    if (status.mBandwidthBps >= 0) {
+        throughputIndex = highestVariantWithin(status.mBandwidthBps, 0.9);
+    }
+
+    if (status.mBufferedDurationUs >= kMinBufferUs) {
+        mStartup = false;
+    }
+
+    if (status.mCurIndex < 0) {
+        return throughputIndex;
+    } else if (mStartup) {
+        // No buffer to speak of yet: go by throughput alone, once there is
+        // an estimate.
+        return status.mBandwidthBps >= 0 ? throughputIndex : status.mCurIndex;
+    }
+
+    double bufferSecs = status.mBufferedDurationUs / 1E6;
+    size_t index = 0;
+    double bestScore = 0.0;
+    for (size_t i = 0; i < mUtilities.size(); ++i) {
+        double score = (mV * (mUtilities.itemAt(i) + mGp) - bufferSecs)
+                / mBandwidthsBps.itemAt(i);
+        if (i == 0 || score >= bestScore) {
+            index = i;
+            bestScore = score;
+        }
+    }
+
+    // Don't switch up beyond what the throughput sustains, nor down while it
+    // sustains the current variant: the buffer refills by itself then.
+    size_t curIndex = status.mCurIndex;
+    if (index > curIndex && index > throughputIndex) {
+        index = throughputIndex > curIndex ? throughputIndex : curIndex;
+    } else if (index < curIndex && index < throughputIndex) {
+        index = throughputIndex < curIndex ? throughputIndex : curIndex;
+    }
+
+    ALOGV("buffered %.2f secs, throughput %d bps => variant %zu",
+            bufferSecs, status.mBandwidthBps, index);
+
+    return index;
+}
+
+}  // namespace android
@@ -0,0 +1,166 @@
+/*
+ * Copyright (C) 2015 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef ADAPTATION_POLICY_H_
+
+#define ADAPTATION_POLICY_H_
+
+#include <media/stagefright/foundation/ABase.h>
+#include <utils/Mutex.h>
+#include <utils/RefBase.h>
+#include <utils/Vector.h>
+
+namespace android {
+
+// Throughput estimate made of two exponentially weighted moving averages of
+// the download rate, weighted by download time: a fast one that follows drops
+// quickly and a slow one that is reluctant to follow peaks. The estimate is
+// the lower of the two.
+//
+// Transfers may run concurrently (segment prefetches, separate audio and
+// video fetchers), so they are not averaged one by one: the bytes received
+// over each kSampleIntervalUs of wall-clock time are divided by the time
+// during which at least one transfer was running, and that aggregate rate is
+// one sample of the averages.
+//
+// Measurements may be added from any thread, in about the order in which the
+// transfers end.
+struct BandwidthEstimator : public RefBase {
+    BandwidthEstimator();
+
+    // numBytes were received between startUs and endUs (ALooper::GetNowUs()).
+    void addMeasurement(size_t numBytes, int64_t startUs, int64_t endUs);
+
+    // Returns false until enough data was transferred for a meaningful estimate.
+    bool estimateBandwidth(int32_t *bandwidthBps);
+
+private:
+    struct Average {
+        Average(double halfLifeSecs);
+
+        void add(double bandwidthBps, double durationSecs);
+        double value() const;
+
+        double mHalfLifeSecs;
+        double mEstimate;
+        double mTotalWeight;
+    };
+
+    static const int64_t kSampleIntervalUs;
+
+    Mutex mLock;
+    Average mFast;
+    Average mSlow;
+    size_t mTotalBytes;
+
+    // The sample being accumulated.
+    int64_t mIntervalStartUs;
+    size_t mIntervalBytes;
+    int64_t mIntervalBusyUs;
+
+    // End of the last transfer, transfer time before it is already counted.
+    int64_t mBusyUntilUs;
+
+    void addSample_l();
+
+    DISALLOW_EVIL_CONSTRUCTORS(BandwidthEstimator);
+};
+
+// Decides which variant of a playlist LiveSession should fetch.
+struct AdaptationPolicy : public RefBase {
+    struct Status {
+        Status();
+
+        int32_t mBandwidthBps;          // estimated throughput, < 0 if unknown
+        int64_t mBufferedDurationUs;    // buffered ahead of the playback position
+        ssize_t mCurIndex;              // variant being fetched, < 0 if none
+    };
+
+    // Returns the policy named by media.httplive.abr ("bola" or "throughput"),
+    // the buffer based one by default.
+    static sp<AdaptationPolicy> Create();
+
+    // Bandwidths of the variants, in bits per second and increasing order.
+    virtual void setVariants(const Vector<int32_t> &bandwidthsBps);
+
+    virtual size_t pickVariant(const Status &status) = 0;
+
+    // How often LiveSession should reconsider the variant.
+    virtual int64_t checkIntervalUs() const = 0;
+
+    virtual const char *name() const = 0;
+
+protected:
+    AdaptationPolicy() {}
+    virtual ~AdaptationPolicy() {}
+
+    // Highest variant whose bandwidth fits in the given share of bandwidthBps,
+    // the lowest one if none does.
+    size_t highestVariantWithin(int32_t bandwidthBps, double share) const;
+
+    Vector<int32_t> mBandwidthsBps;
+
+private:
+    DISALLOW_EVIL_CONSTRUCTORS(AdaptationPolicy);
+};
+
+// The original heuristic: the highest variant fitting in 80% of the estimated
+// throughput (70% to switch up), switching up only with 10 seconds buffered.
+struct ThroughputPolicy : public AdaptationPolicy {
+    ThroughputPolicy() {}
+
+    virtual size_t pickVariant(const Status &status);
+    virtual int64_t checkIntervalUs() const { return 10000000ll; }
+    virtual const char *name() const { return "throughput"; }
+
+private:
+    DISALLOW_EVIL_CONSTRUCTORS(ThroughputPolicy);
+};
+
+// Buffer based selection after BOLA (Spiteri et al., "BOLA: Near-Optimal
+// Bitrate Adaptation for Online Videos"): variant m maximizes
+// (V * (u_m + gp) - Q) / S_m, with u_m = 1 + ln(S_m / S_0) the utility of
+// bitrate S_m and Q the buffer level, so that the lowest variant is picked at
+// kMinBufferUs and the highest one from kTargetBufferUs. Throughput only
+// matters until the buffer first reaches kMinBufferUs, and to bound the
+// switches: never up beyond what the network sustains (BOLA-O), which avoids
+// the up/down oscillations behind most down-switches, and never down below it.
+struct BolaPolicy : public AdaptationPolicy {
+    BolaPolicy();
+
+    virtual void setVariants(const Vector<int32_t> &bandwidthsBps);
+    virtual size_t pickVariant(const Status &status);
+    virtual int64_t checkIntervalUs() const { return 2000000ll; }
+    virtual const char *name() const { return "bola"; }
+
+private:
+    // PlaylistFetcher buffers up to 10 seconds, keep the target below.
+    static const int64_t kMinBufferUs;
+    static const int64_t kTargetBufferUs;
+
+    Vector<double> mUtilities;
+    double mGp;
+    double mV;
+
+    // Until the buffer first reaches kMinBufferUs.
+    bool mStartup;
+
+    DISALLOW_EVIL_CONSTRUCTORS(BolaPolicy);
+};
+
+}  // namespace android
+
+#endif  // ADAPTATION_POLICY_H_
@@ -20,6 +20,7 @@
 
 #include "LiveSession.h"
 
+#include "AdaptationPolicy.h"
 #include "M3UParser.h"
 #include "PlaylistFetcher.h"
 
@@ -57,6 +58,8 @@ LiveSession::LiveSession(
       mHTTPService(httpService),
       mInPreparationPhase(true),
       mHTTPDataSource(new MediaHTTP(mHTTPService->makeHTTPConnection())),
+      mBandwidthEstimator(new BandwidthEstimator),
+      mAdaptationPolicy(AdaptationPolicy::Create()),
       mCurBandwidthIndex(-1),
       mStreamMask(0),
       mNewStreamMask(0),
@@ -713,6 +716,13 @@ void LiveSession::onConnect(const sp<AMessage> &msg) {
         mBandwidthItems.push(item);
     }
 
+    Vector<int32_t> bandwidthsBps;
+    for (size_t i = 0; i < mBandwidthItems.size(); ++i) {
+        bandwidthsBps.push(mBandwidthItems.itemAt(i).mBandwidth);
+    }
+    mAdaptationPolicy->setVariants(bandwidthsBps);
+    ALOGI("adapting with the %s policy", mAdaptationPolicy->name());
+
     mPlaylist->pickRandomMediaItems();
     changeConfiguration(
             0ll /* timeUs */, initialBandwidthIndex, false /* pickTrack */);
@@ -804,7 +814,8 @@ ssize_t LiveSession::fetchFile(
         int64_t range_offset, int64_t range_length,
         uint32_t block_size, /* download block size */
         sp<DataSource> *source, /* to return and reuse source */
-        String8 *actualUrl) {
+        String8 *actualUrl,
+        const sp<HTTPBase> &http_source) {
     off64_t size;
     sp<DataSource> temp_source;
     if (source == NULL) {
@@ -830,13 +841,15 @@ ssize_t LiveSession::fetchFile(
                                     ? "" : StringPrintf("%lld",
                                             range_offset + range_length - 1).c_str()).c_str()));
             }
-            status_t err = mHTTPDataSource->connect(url, &headers);
+            sp<HTTPBase> httpSource =
+                http_source != NULL ? http_source : mHTTPDataSource;
+            status_t err = httpSource->connect(url, &headers);
 
             if (err != OK) {
                 return err;
             }
 
-            *source = mHTTPDataSource;
+            *source = httpSource;
         }
     }
 
@@ -913,7 +926,8 @@ ssize_t LiveSession::fetchFile(
 }
 
 sp<M3UParser> LiveSession::fetchPlaylist(
-        const char *url, uint8_t *curPlaylistHash, bool *unchanged) {
+        const char *url, uint8_t *curPlaylistHash, bool *unchanged,
+        const sp<M3UParser> &previous) {
     ALOGV("fetchPlaylist '%s'", url);
 
     *unchanged = false;
@@ -951,7 +965,7 @@ sp<M3UParser> LiveSession::fetchPlaylist(
 #endif
 
     sp<M3UParser> playlist =
-        new M3UParser(actualUrl.string(), buffer->data(), buffer->size());
+        new M3UParser(actualUrl.string(), buffer, previous);
 
     if (playlist->initCheck() != OK) {
         ALOGE("failed to parse .m3u8 playlist");
@@ -986,44 +1000,32 @@ size_t LiveSession::getBandwidthIndex() {
 
     if (index < 0) {
         int32_t bandwidthBps;
-        if (mHTTPDataSource != NULL
-                && mHTTPDataSource->estimateBandwidth(&bandwidthBps)) {
+        if (mBandwidthEstimator->estimateBandwidth(&bandwidthBps)
+                || (mHTTPDataSource != NULL
+                    && mHTTPDataSource->estimateBandwidth(&bandwidthBps))) {
             ALOGV("bandwidth estimated at %.2f kbps", bandwidthBps / 1024.0f);
-        } else {
-            ALOGV("no bandwidth estimate.");
-            return 0;  // Pick the lowest bandwidth stream by default.
-        }
 
-        char value[PROPERTY_VALUE_MAX];
-        if (property_get("media.httplive.max-bw", value, NULL)) {
-            char *end;
-            long maxBw = strtoul(value, &end, 10);
-            if (end > value && *end == '\0') {
-                if (maxBw > 0 && bandwidthBps > maxBw) {
-                    ALOGV("bandwidth capped to %ld bps", maxBw);
-                    bandwidthBps = maxBw;
+            char value[PROPERTY_VALUE_MAX];
+            if (property_get("media.httplive.max-bw", value, NULL)) {
+                char *end;
+                long maxBw = strtoul(value, &end, 10);
+                if (end > value && *end == '\0') {
+                    if (maxBw > 0 && bandwidthBps > maxBw) {
+                        ALOGV("bandwidth capped to %ld bps", maxBw);
+                        bandwidthBps = maxBw;
+                    }
                 }
             }
+        } else {
+            ALOGV("no bandwidth estimate.");
+            bandwidthBps = -1;
         }
 
-        // Pick the highest bandwidth stream below or equal to estimated bandwidth.
-
-        index = mBandwidthItems.size() - 1;
-        while (index > 0) {
-            // consider only 80% of the available bandwidth, but if we are switching up,
-            // be even more conservative (70%) to avoid overestimating and immediately
-            // switching back.
-            size_t adjustedBandwidthBps = bandwidthBps;
-            if (index > mCurBandwidthIndex) {
-                adjustedBandwidthBps = adjustedBandwidthBps * 7 / 10;
-            } else {
-                adjustedBandwidthBps = adjustedBandwidthBps * 8 / 10;
-            }
-            if (mBandwidthItems.itemAt(index).mBandwidth <= adjustedBandwidthBps) {
-                break;
-            }
-            --index;
-        }
+        AdaptationPolicy::Status status;
+        status.mBandwidthBps = bandwidthBps;
+        status.mBufferedDurationUs = getBufferedDurationUs();
+        status.mCurIndex = mCurBandwidthIndex;
+        index = mAdaptationPolicy->pickVariant(status);
     }
 #elif 0
     // Change bandwidth at random()
@@ -1164,17 +1166,28 @@ status_t LiveSession::selectTrack(size_t index, bool select) {
     return err;
 }
 
-bool LiveSession::canSwitchUp() {
-    // Allow upwards bandwidth switch when a stream has buffered at least 10 seconds.
-    status_t err = OK;
+void LiveSession::addBandwidthMeasurement(
+        size_t numBytes, int64_t startUs, int64_t endUs) {
+    mBandwidthEstimator->addMeasurement(numBytes, startUs, endUs);
+}
+
+int64_t LiveSession::getBufferedDurationUs() {
+    // Like the fetchers, go by the stream buffered the most, in case the
+    // playlist doesn't actually carry one of the streams we expect.
+    int64_t bufferedDurationUs = 0ll;
     for (size_t i = 0; i < mPacketSources.size(); ++i) {
-        sp<AnotherPacketSource> source = mPacketSources.valueAt(i);
-        int64_t dur = source->getBufferedDurationUs(&err);
-        if (err == OK && dur > 10000000) {
-            return true;
+        StreamType type = mPacketSources.keyAt(i);
+        if (type == STREAMTYPE_SUBTITLES || !(mStreamMask & type)) {
+            continue;
+        }
+
+        status_t err = OK;
+        int64_t durationUs = mPacketSources.valueAt(i)->getBufferedDurationUs(&err);
+        if (err == OK && durationUs > bufferedDurationUs) {
+            bufferedDurationUs = durationUs;
         }
     }
-    return false;
+    return bufferedDurationUs;
 }
 
 void LiveSession::changeConfiguration(
@@ -1650,7 +1663,7 @@ void LiveSession::tryToFinishBandwidthSwitch() {
 void LiveSession::scheduleCheckBandwidthEvent() {
     sp<AMessage> msg = new AMessage(kWhatCheckBandwidth, id());
     msg->setInt32("generation", mCheckBandwidthGeneration);
-    msg->post(10000000ll);
+    msg->post(mAdaptationPolicy->checkIntervalUs());
 }
 
 void LiveSession::cancelCheckBandwidthEvent() {
@@ -1695,13 +1708,8 @@ bool LiveSession::canSwitchBandwidthTo(size_t bandwidthIndex) {
         return true;
     }
 
-    if (bandwidthIndex == (size_t)mCurBandwidthIndex) {
-        return false;
-    } else if (bandwidthIndex > (size_t)mCurBandwidthIndex) {
-        return canSwitchUp();
-    } else {
-        return true;
-    }
+    // The adaptation policy already decided whether switching up is wise.
+    return bandwidthIndex != (size_t)mCurBandwidthIndex;
 }
 
 void LiveSession::onCheckBandwidth(const sp<AMessage> &msg) {
@@ -1709,10 +1717,10 @@ void LiveSession::onCheckBandwidth(const sp<AMessage> &msg) {
     if (canSwitchBandwidthTo(bandwidthIndex)) {
         changeConfiguration(-1ll /* timeUs */, bandwidthIndex);
     } else {
-        // Come back and check again 10 seconds later in case there is nothing to do now.
+        // Come back and check again later in case there is nothing to do now.
         // If we DO change configuration, once that completes it'll schedule a new
         // check bandwidth event with an incremented mCheckBandwidthGeneration.
-        msg->post(10000000ll);
+        msg->post(mAdaptationPolicy->checkIntervalUs());
     }
 }
 
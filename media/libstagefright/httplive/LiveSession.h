@@ -25,7 +25,9 @@
 namespace android {
 
 struct ABuffer;
+struct AdaptationPolicy;
 struct AnotherPacketSource;
+struct BandwidthEstimator;
 struct DataSource;
 struct HTTPBase;
 struct IMediaHTTPService;
@@ -96,6 +98,7 @@ protected:
 
 private:
     friend struct PlaylistFetcher;
+    friend struct SegmentPrefetcher;
 
     enum {
         kWhatConnect                    = 'conn',
@@ -158,6 +161,11 @@ private:
     sp<HTTPBase> mHTTPDataSource;
     KeyedVector<String8, String8> mExtraHeaders;
 
+    // Fed with the segment downloads of the fetchers, and used by
+    // mAdaptationPolicy to pick variants.
+    sp<BandwidthEstimator> mBandwidthEstimator;
+    sp<AdaptationPolicy> mAdaptationPolicy;
+
     AString mMasterURL;
 
     Vector<BandwidthItem> mBandwidthItems;
@@ -227,6 +235,9 @@ private:
     //
     // For reused HTTP sources, the caller must download a file sequentially without
     // any overlaps or gaps to prevent reconnection.
+    //
+    // HTTP files are opened on http_source if given, otherwise on the session's
+    // shared connection.
     ssize_t fetchFile(
             const char *url, sp<ABuffer> *out,
             /* request/open a file starting at range_offset for range_length bytes */
@@ -235,12 +246,21 @@ private:
             uint32_t block_size = 0,
             /* reuse DataSource if doing partial fetch */
             sp<DataSource> *source = NULL,
-            String8 *actualUrl = NULL);
+            String8 *actualUrl = NULL,
+            const sp<HTTPBase> &http_source = NULL);
 
+    // previous, if given, is the last version of the playlist; the items it
+    // shares with the new one are not parsed again.
     sp<M3UParser> fetchPlaylist(
-            const char *url, uint8_t *curPlaylistHash, bool *unchanged);
+            const char *url, uint8_t *curPlaylistHash, bool *unchanged,
+            const sp<M3UParser> &previous = NULL);
+
+    // Called by the fetchers, on any thread, for the media data they download,
+    // as it is received.
+    void addBandwidthMeasurement(size_t numBytes, int64_t startUs, int64_t endUs);
 
     size_t getBandwidthIndex();
+    int64_t getBufferedDurationUs();
     int64_t latestMediaSegmentStartTimeUs();
 
     static int SortByBandwidth(const BandwidthItem *, const BandwidthItem *);
@@ -273,7 +293,6 @@ private:
     void postPrepared(status_t err);
 
     void swapPacketSource(StreamType stream);
-    bool canSwitchUp();
 
     DISALLOW_EVIL_CONSTRUCTORS(LiveSession);
 };
@@ -21,6 +21,7 @@
 #include "M3UParser.h"
 #include <binder/Parcel.h>
 #include <cutils/properties.h>
+#include <media/stagefright/foundation/ABuffer.h>
 #include <media/stagefright/foundation/ADebug.h>
 #include <media/stagefright/foundation/AMessage.h>
 #include <media/stagefright/MediaDefs.h>
@@ -248,7 +249,22 @@ M3UParser::M3UParser(
       mIsEvent(false),
       mDiscontinuitySeq(0),
       mSelectedIndex(-1) {
-    mInitCheck = parse(data, size);
+    mInitCheck = parse(data, size, NULL /* previous */);
+}
+
+M3UParser::M3UParser(
+        const char *baseURI, const sp<ABuffer> &data,
+        const sp<M3UParser> &previous)
+    : mInitCheck(NO_INIT),
+      mData(data),
+      mBaseURI(baseURI),
+      mIsExtM3U(false),
+      mIsVariantPlaylist(false),
+      mIsComplete(false),
+      mIsEvent(false),
+      mDiscontinuitySeq(0),
+      mSelectedIndex(-1) {
+    mInitCheck = parse(data->data(), data->size(), previous);
 }
 
 M3UParser::~M3UParser() {
@@ -479,15 +495,77 @@ static bool MakeURL(const char *baseURL, const char *url, AString *out) {
     return true;
 }
 
-status_t M3UParser::parse(const void *_data, size_t size) {
+int32_t M3UParser::firstSeqNumber() const {
+    int32_t seqNumber;
+    if (mMeta == NULL || !mMeta->findInt32("media-sequence", &seqNumber)) {
+        seqNumber = 0;
+    }
+    return seqNumber;
+}
+
+// static
+const M3UParser::Item *M3UParser::findReusableItem(
+        const sp<M3UParser> &previous, int32_t seqNumber,
+        const char *data, size_t size, size_t offset,
+        uint64_t rangeOffset) {
+    int32_t index = seqNumber - previous->firstSeqNumber();
+    if (index < 0 || (size_t)index >= previous->mItems.size()) {
+        return NULL;
+    }
+
+    const Item *item = &previous->mItems.itemAt(index);
+    if (!item->mReusable || item->mRangeOffsetIn != rangeOffset
+            || item->mLength > size - offset
+            || (offset + item->mLength < size && data[offset + item->mLength] != '\n')
+            || memcmp(&data[offset],
+                    previous->mData->data() + item->mOffset, item->mLength)) {
+        return NULL;
+    }
+
+    return item;
+}
+
+status_t M3UParser::parse(
+        const void *_data, size_t size, const sp<M3UParser> &previous) {
     int32_t lineNo = 0;
 
     sp<AMessage> itemMeta;
 
+    // Items of a media playlist whose lines are unchanged since the previous
+    // version are taken over without parsing them again.
+    bool reuseItems = previous != NULL && previous->mData != NULL
+            && previous->mIsExtM3U && !previous->mIsVariantPlaylist
+            && previous->mBaseURI == mBaseURI;
+
     const char *data = (const char *)_data;
     size_t offset = 0;
     uint64_t segmentRangeOffset = 0;
+
+    // Start of the lines of the next item, and whether they only concern it.
+    size_t itemOffset = 0;
+    uint64_t itemRangeOffset = 0;
+    bool itemReusable = true;
+
     while (offset < size) {
+        if (reuseItems && offset == itemOffset && mIsExtM3U
+                && !mIsVariantPlaylist && mItems.size() > 0) {
+            const Item *item = findReusableItem(
+                    previous, firstSeqNumber() + mItems.size(),
+                    data, size, offset, segmentRangeOffset);
+
+            if (item != NULL) {
+                mItems.push(*item);
+                mItems.editItemAt(mItems.size() - 1).mOffset = offset;
+
+                segmentRangeOffset = item->mRangeOffsetOut;
+                offset += item->mLength + 1;
+                itemOffset = offset;
+                itemRangeOffset = segmentRangeOffset;
+                ++lineNo;
+                continue;
+            }
+        }
+
         size_t offsetLF = offset;
         while (offsetLF < size && data[offsetLF] != '\n') {
             ++offsetLF;
@@ -509,11 +587,23 @@ status_t M3UParser::parse(const void *_data, size_t size) {
 
         if (lineNo == 0 && line == "#EXTM3U") {
             mIsExtM3U = true;
+            itemReusable = false;
         }
 
         if (mIsExtM3U) {
             status_t err = OK;
 
+            // Tags with an effect beyond the next item.
+            if (line.startsWith("#EXT-X-TARGETDURATION")
+                    || line.startsWith("#EXT-X-MEDIA-SEQUENCE")
+                    || line.startsWith("#EXT-X-DISCONTINUITY-SEQUENCE")
+                    || line.startsWith("#EXT-X-ENDLIST")
+                    || line.startsWith("#EXT-X-PLAYLIST-TYPE")
+                    || line.startsWith("#EXT-X-STREAM-INF")
+                    || line.startsWith("#EXT-X-MEDIA")) {
+                itemReusable = false;
+            }
+
             if (line.startsWith("#EXT-X-TARGETDURATION")) {
                 if (mIsVariantPlaylist) {
                     return ERROR_MALFORMED;
@@ -600,8 +690,17 @@ status_t M3UParser::parse(const void *_data, size_t size) {
             CHECK(MakeURL(mBaseURI.c_str(), line.c_str(), &item->mURI));
 
             item->mMeta = itemMeta;
+            item->mOffset = itemOffset;
+            item->mLength = offsetLF - itemOffset;
+            item->mRangeOffsetIn = itemRangeOffset;
+            item->mRangeOffsetOut = segmentRangeOffset;
+            item->mReusable = itemReusable;
 
             itemMeta.clear();
+
+            itemOffset = offsetLF + 1;
+            itemRangeOffset = segmentRangeOffset;
+            itemReusable = true;
         }
 
         offset = offsetLF + 1;
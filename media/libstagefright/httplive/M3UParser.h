@@ -25,9 +25,19 @@
 
 namespace android {
 
+struct ABuffer;
+
 struct M3UParser : public RefBase {
     M3UParser(const char *baseURI, const void *data, size_t size);
 
+    // Parses the playlist in data, which stays referenced so that a later
+    // version of the playlist can be parsed incrementally. Items of previous,
+    // an earlier version of the same playlist, are reused as they are when
+    // their lines did not change.
+    M3UParser(
+            const char *baseURI, const sp<ABuffer> &data,
+            const sp<M3UParser> &previous);
+
     status_t initCheck() const;
 
     bool isExtM3U() const;
@@ -58,10 +68,21 @@ private:
     struct Item {
         AString mURI;
         sp<AMessage> mMeta;
+
+        // Where the lines of the item (its tags and URI) are in mData, and
+        // the byte range offset they continue from and leave behind.
+        size_t mOffset;
+        size_t mLength;
+        uint64_t mRangeOffsetIn;
+        uint64_t mRangeOffsetOut;
+
+        // None of the lines has an effect beyond the item.
+        bool mReusable;
     };
 
     status_t mInitCheck;
 
+    sp<ABuffer> mData;
     AString mBaseURI;
     bool mIsExtM3U;
     bool mIsVariantPlaylist;
@@ -76,7 +97,17 @@ private:
     // Media groups keyed by group ID.
     KeyedVector<AString, sp<MediaGroup> > mMediaGroups;
 
-    status_t parse(const void *data, size_t size);
+    status_t parse(
+            const void *data, size_t size, const sp<M3UParser> &previous);
+
+    int32_t firstSeqNumber() const;
+
+    // Returns the item of previous with sequence number seqNumber if its
+    // lines are the ones at offset in data.
+    static const Item *findReusableItem(
+            const sp<M3UParser> &previous, int32_t seqNumber,
+            const char *data, size_t size, size_t offset,
+            uint64_t rangeOffset);
 
     static status_t parseMetaData(
             const AString &line, sp<AMessage> *meta, const char *key);
@@ -23,12 +23,14 @@
 #include "LiveDataSource.h"
 #include "LiveSession.h"
 #include "M3UParser.h"
+#include "SegmentPrefetcher.h"
 
 #include "include/avc_utils.h"
 #include "include/HTTPBase.h"
 #include "include/ID3.h"
 #include "mpeg2ts/AnotherPacketSource.h"
 
+#include <cutils/properties.h>
 #include <media/IStreamSource.h>
 #include <media/stagefright/foundation/ABitReader.h>
 #include <media/stagefright/foundation/ABuffer.h>
@@ -41,7 +43,7 @@
 
 #include <ctype.h>
 #include <inttypes.h>
-#include <openssl/aes.h>
+#include <openssl/evp.h>
 #include <openssl/md5.h>
 
 namespace android {
@@ -50,6 +52,7 @@ namespace android {
 const int64_t PlaylistFetcher::kMinBufferedDurationUs = 10000000ll;
 const int64_t PlaylistFetcher::kMaxMonitorDelayUs = 3000000ll;
 const int32_t PlaylistFetcher::kDownloadBlockSize = 2048;
+const size_t PlaylistFetcher::kDefaultPrefetchDepth = 2;
 const int32_t PlaylistFetcher::kNumSkipFrames = 10;
 
 PlaylistFetcher::PlaylistFetcher(
@@ -78,13 +81,29 @@ PlaylistFetcher::PlaylistFetcher(
       mRefreshState(INITIAL_MINIMUM_RELOAD_DELAY),
       mFirstPTSValid(false),
       mAbsoluteTimeAnchorUs(0ll),
-      mVideoBuffer(new AnotherPacketSource(NULL)) {
+      mVideoBuffer(new AnotherPacketSource(NULL)),
+      mCipherMethod("NONE"),
+      mAESContext(EVP_CIPHER_CTX_new()) {
     memset(mPlaylistHash, 0, sizeof(mPlaylistHash));
     mStartTimeUsNotify->setInt32("what", kWhatStartedAt);
     mStartTimeUsNotify->setInt32("streamMask", 0);
+
+    size_t prefetchDepth = kDefaultPrefetchDepth;
+    char value[PROPERTY_VALUE_MAX];
+    if (property_get("media.httplive.prefetch-depth", value, NULL)) {
+        char *end;
+        unsigned long depth = strtoul(value, &end, 10);
+        if (end > value && *end == '\0') {
+            prefetchDepth = depth;
+        }
+    }
+    if (prefetchDepth > 0) {
+        mPrefetcher = new SegmentPrefetcher(session, prefetchDepth);
+    }
 }
 
 PlaylistFetcher::~PlaylistFetcher() {
+    EVP_CIPHER_CTX_free(mAESContext);
 }
 
 int64_t PlaylistFetcher::getSegmentStartTimeUs(int32_t seqNumber) const {
@@ -185,6 +204,39 @@ int64_t PlaylistFetcher::delayUsToRefreshPlaylist() const {
 status_t PlaylistFetcher::decryptBuffer(
         size_t playlistIndex, const sp<ABuffer> &buffer,
         bool first) {
+    if (first) {
+        status_t err = initDecryption(playlistIndex);
+        if (err != OK) {
+            mCipherMethod = "NONE";
+            return err;
+        }
+    }
+    buffer->meta()->setString("cipher-method", mCipherMethod.c_str());
+
+    if (mCipherMethod == "NONE") {
+        return OK;
+    }
+
+    size_t n = buffer->size();
+    if (!n) {
+        return OK;
+    }
+    CHECK(n % 16 == 0);
+
+    // Padding is disabled, so every full block is decrypted (in place) right
+    // away and the context carries the last cipher block over to the next call.
+    int outLength;
+    if (!EVP_DecryptUpdate(
+                mAESContext, buffer->data(), &outLength, buffer->data(), n)
+            || outLength != (int)n) {
+        ALOGE("failed to decrypt %zu bytes.", n);
+        return UNKNOWN_ERROR;
+    }
+
+    return OK;
+}
+
+status_t PlaylistFetcher::initDecryption(size_t playlistIndex) {
     sp<AMessage> itemMeta;
     bool found = false;
     AString method;
@@ -202,7 +254,7 @@ status_t PlaylistFetcher::decryptBuffer(
     if (!found) {
         method = "NONE";
     }
-    buffer->meta()->setString("cipher-method", method.c_str());
+    mCipherMethod = method;
 
     if (method == "NONE") {
         return OK;
@@ -236,55 +288,49 @@ status_t PlaylistFetcher::decryptBuffer(
         mAESKeyForURI.add(keyURI, key);
     }
 
-    AES_KEY aes_key;
-    if (AES_set_decrypt_key(key->data(), 128, &aes_key) != 0) {
-        ALOGE("failed to set AES decryption key.");
-        return UNKNOWN_ERROR;
-    }
-
-    size_t n = buffer->size();
-    if (!n) {
-        return OK;
-    }
-    CHECK(n % 16 == 0);
-
-    if (first) {
-        // If decrypting the first block in a file, read the iv from the manifest
-        // or derive the iv from the file's sequence number.
+    // Read the iv from the manifest or derive it from the file's sequence number.
+    uint8_t initVec[16];
+    AString iv;
+    if (itemMeta->findString("cipher-iv", &iv)) {
+        if ((!iv.startsWith("0x") && !iv.startsWith("0X"))
+                || iv.size() != 16 * 2 + 2) {
+            ALOGE("malformed cipher IV '%s'.", iv.c_str());
+            return ERROR_MALFORMED;
+        }
 
-        AString iv;
-        if (itemMeta->findString("cipher-iv", &iv)) {
-            if ((!iv.startsWith("0x") && !iv.startsWith("0X"))
-                    || iv.size() != 16 * 2 + 2) {
+        memset(initVec, 0, sizeof(initVec));
+        for (size_t i = 0; i < 16; ++i) {
+            char c1 = tolower(iv.c_str()[2 + 2 * i]);
+            char c2 = tolower(iv.c_str()[3 + 2 * i]);
+            if (!isxdigit(c1) || !isxdigit(c2)) {
                 ALOGE("malformed cipher IV '%s'.", iv.c_str());
                 return ERROR_MALFORMED;
             }
+            uint8_t nibble1 = isdigit(c1) ? c1 - '0' : c1 - 'a' + 10;
+            uint8_t nibble2 = isdigit(c2) ? c2 - '0' : c2 - 'a' + 10;
 
-            memset(mAESInitVec, 0, sizeof(mAESInitVec));
-            for (size_t i = 0; i < 16; ++i) {
-                char c1 = tolower(iv.c_str()[2 + 2 * i]);
-                char c2 = tolower(iv.c_str()[3 + 2 * i]);
-                if (!isxdigit(c1) || !isxdigit(c2)) {
-                    ALOGE("malformed cipher IV '%s'.", iv.c_str());
-                    return ERROR_MALFORMED;
-                }
-                uint8_t nibble1 = isdigit(c1) ? c1 - '0' : c1 - 'a' + 10;
-                uint8_t nibble2 = isdigit(c2) ? c2 - '0' : c2 - 'a' + 10;
-
-                mAESInitVec[i] = nibble1 << 4 | nibble2;
-            }
-        } else {
-            memset(mAESInitVec, 0, sizeof(mAESInitVec));
-            mAESInitVec[15] = mSeqNumber & 0xff;
-            mAESInitVec[14] = (mSeqNumber >> 8) & 0xff;
-            mAESInitVec[13] = (mSeqNumber >> 16) & 0xff;
-            mAESInitVec[12] = (mSeqNumber >> 24) & 0xff;
+            initVec[i] = nibble1 << 4 | nibble2;
         }
+    } else {
+        memset(initVec, 0, sizeof(initVec));
+        initVec[15] = mSeqNumber & 0xff;
+        initVec[14] = (mSeqNumber >> 8) & 0xff;
+        initVec[13] = (mSeqNumber >> 16) & 0xff;
+        initVec[12] = (mSeqNumber >> 24) & 0xff;
+    }
+
+    if (mAESContext == NULL) {
+        ALOGE("no AES decryption context.");
+        return NO_MEMORY;
     }
 
-    AES_cbc_encrypt(
-            buffer->data(), buffer->data(), buffer->size(),
-            &aes_key, mAESInitVec, AES_DECRYPT);
+    // The EVP interface picks the AES instructions of the CPU when there are.
+    if (!EVP_DecryptInit_ex(
+                mAESContext, EVP_aes_128_cbc(), NULL, key->data(), initVec)
+            || !EVP_CIPHER_CTX_set_padding(mAESContext, 0)) {
+        ALOGE("failed to set AES decryption key.");
+        return UNKNOWN_ERROR;
+    }
 
     return OK;
 }
@@ -510,11 +556,19 @@ status_t PlaylistFetcher::onStart(const sp<AMessage> &msg) {
 
 void PlaylistFetcher::onPause() {
     cancelMonitorQueue();
+
+    if (mPrefetcher != NULL) {
+        mPrefetcher->cancelAll();
+    }
 }
 
 void PlaylistFetcher::onStop(const sp<AMessage> &msg) {
     cancelMonitorQueue();
 
+    if (mPrefetcher != NULL) {
+        mPrefetcher->cancelAll();
+    }
+
     int32_t clear;
     CHECK(msg->findInt32("clear", &clear));
     if (clear) {
@@ -689,7 +743,7 @@ status_t PlaylistFetcher::refreshPlaylist() {
     if (delayUsToRefreshPlaylist() <= 0) {
         bool unchanged;
         sp<M3UParser> playlist = mSession->fetchPlaylist(
-                mURI.c_str(), mPlaylistHash, &unchanged);
+                mURI.c_str(), mPlaylistHash, &unchanged, mPlaylist);
 
         if (playlist == NULL) {
             if (unchanged) {
@@ -876,12 +930,51 @@ void PlaylistFetcher::onDownloadNext() {
         }
     }
 
+    // Segments after this one download in the background while this one is
+    // parsed; this one is read from its prefetch if there is one.
+    bool prefetched = false;
+    if (mPrefetcher != NULL) {
+        int32_t lastSeqNumberToPrefetch = mSeqNumber + (int32_t)mPrefetcher->depth();
+        if (lastSeqNumberToPrefetch > lastSeqNumberInPlaylist) {
+            lastSeqNumberToPrefetch = lastSeqNumberInPlaylist;
+        }
+        mPrefetcher->retain(mSeqNumber, lastSeqNumberToPrefetch);
+        prefetched = mPrefetcher->has(mSeqNumber, uri);
+
+        for (int32_t seq = mSeqNumber + 1; seq <= lastSeqNumberToPrefetch; ++seq) {
+            AString nextUri;
+            sp<AMessage> nextMeta;
+            CHECK(mPlaylist->itemAt(
+                        seq - firstSeqNumberInPlaylist, &nextUri, &nextMeta));
+
+            int64_t nextRangeOffset, nextRangeLength;
+            if (!nextMeta->findInt64("range-offset", &nextRangeOffset)
+                    || !nextMeta->findInt64("range-length", &nextRangeLength)) {
+                nextRangeOffset = 0;
+                nextRangeLength = -1;
+            }
+
+            mPrefetcher->prefetch(seq, nextUri, nextRangeOffset, nextRangeLength);
+        }
+    }
+
     // block-wise download
     bool startup = mStartup;
     ssize_t bytesRead;
     do {
-        bytesRead = mSession->fetchFile(
-                uri.c_str(), &buffer, range_offset, range_length, kDownloadBlockSize, &source);
+        if (prefetched) {
+            // the prefetcher reports the bandwidth it gets itself
+            bytesRead = mPrefetcher->read(mSeqNumber, &buffer, kDownloadBlockSize);
+        } else {
+            // time spent parsing in between blocks is not part of the download
+            int64_t startUs = ALooper::GetNowUs();
+            bytesRead = mSession->fetchFile(
+                    uri.c_str(), &buffer, range_offset, range_length, kDownloadBlockSize, &source);
+            if (bytesRead > 0) {
+                mSession->addBandwidthMeasurement(
+                        bytesRead, startUs, ALooper::GetNowUs());
+            }
+        }
 
         if (bytesRead < 0) {
             status_t err = bytesRead;
@@ -962,6 +1055,11 @@ void PlaylistFetcher::onDownloadNext() {
 
     } while (bytesRead != 0);
 
+    if (prefetched) {
+        // release the download and its copy of the segment
+        mPrefetcher->cancel(mSeqNumber);
+    }
+
     if (bufferStartsWithTsSyncByte(buffer)) {
         // If we still don't see a stream after fetching a full ts segment mark it as
         // nonexistent.
@@ -1162,20 +1260,17 @@ status_t PlaylistFetcher::extractAndQueueAccessUnitsFromTs(const sp<ABuffer> &bu
         mFirstPTSValid = false;
     }
 
-    size_t offset = 0;
-    while (offset + 188 <= buffer->size()) {
-        status_t err = mTSParser->feedTSPacket(buffer->data() + offset, 188);
-
-        if (err != OK) {
-            return err;
-        }
+    size_t offset;
+    status_t err = mTSParser->feedTSPackets(
+            buffer->data(), buffer->size(), &offset);
 
-        offset += 188;
+    if (err != OK) {
+        return err;
     }
+
     // setRange to indicate consumed bytes.
     buffer->setRange(buffer->offset() + offset, buffer->size() - offset);
 
-    status_t err = OK;
     for (size_t i = mPacketSources.size(); i-- > 0;) {
         sp<AnotherPacketSource> packetSource = mPacketSources.valueAt(i);
 
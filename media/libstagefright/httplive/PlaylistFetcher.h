@@ -23,6 +23,9 @@
 #include "mpeg2ts/ATSParser.h"
 #include "LiveSession.h"
 
+// EVP_CIPHER_CTX, without pulling the OpenSSL headers into every includer.
+struct evp_cipher_ctx_st;
+
 namespace android {
 
 struct ABuffer;
@@ -31,6 +34,7 @@ struct DataSource;
 struct HTTPBase;
 struct LiveDataSource;
 struct M3UParser;
+struct SegmentPrefetcher;
 struct String8;
 
 struct PlaylistFetcher : public AHandler {
@@ -95,6 +99,7 @@ private:
     static const int64_t kMinBufferedDurationUs;
     static const int64_t kMaxMonitorDelayUs;
     static const int32_t kDownloadBlockSize;
+    static const size_t kDefaultPrefetchDepth;
     static const int32_t kNumSkipFrames;
 
     static bool bufferStartsWithTsSyncByte(const sp<ABuffer>& buffer);
@@ -148,21 +153,27 @@ private:
 
     sp<ATSParser> mTSParser;
 
+    // Downloads the segments after mSeqNumber while it is being parsed;
+    // NULL if prefetching is disabled.
+    sp<SegmentPrefetcher> mPrefetcher;
+
     bool mFirstPTSValid;
     uint64_t mFirstPTS;
     int64_t mFirstTimeUs;
     int64_t mAbsoluteTimeAnchorUs;
     sp<AnotherPacketSource> mVideoBuffer;
 
-    // Stores the initialization vector to decrypt the next block of cipher text, which can
-    // either be derived from the sequence number, read from the manifest, or copied from
-    // the last block of cipher text (cipher-block chaining).
-    unsigned char mAESInitVec[16];
+    // Cipher of the segment being decrypted, and the AES-128-CBC state that
+    // carries the key schedule and the chaining block from one call of
+    // decryptBuffer to the next.
+    AString mCipherMethod;
+    // NULL if it could not be allocated.
+    ::evp_cipher_ctx_st *mAESContext;
 
     // Set first to true if decrypting the first segment of a playlist segment. When
-    // first is true, reset the initialization vector based on the available
-    // information in the manifest; otherwise, use the initialization vector as
-    // updated by the last call to AES_cbc_encrypt.
+    // first is true, set up the cipher, key and initialization vector based on the
+    // available information in the manifest; otherwise, continue from the state
+    // left by the previous call.
     //
     // For the input to decrypt correctly, decryptBuffer must be called on
     // consecutive byte ranges on block boundaries, e.g. 0..15, 16..47, 48..63,
@@ -170,6 +181,7 @@ private:
     status_t decryptBuffer(
             size_t playlistIndex, const sp<ABuffer> &buffer,
             bool first = true);
+    status_t initDecryption(size_t playlistIndex);
     status_t checkDecryptPadding(const sp<ABuffer> &buffer);
 
     void postMonitorQueue(int64_t delayUs = 0, int64_t minDelayUs = 0);
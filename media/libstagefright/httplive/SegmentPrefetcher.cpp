@@ -0,0 +1,297 @@
+/*
+ * Copyright (C) 2015 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+//#define LOG_NDEBUG 0
+#define LOG_TAG "SegmentPrefetcher"
+#include <utils/Log.h>
+
+#include "SegmentPrefetcher.h"
+
+#include "LiveSession.h"
+
+#include "include/HTTPBase.h"
+
+#include <media/IMediaHTTPService.h>
+#include <media/stagefright/foundation/ABuffer.h>
+#include <media/stagefright/foundation/ADebug.h>
+#include <media/stagefright/foundation/ALooper.h>
+#include <media/stagefright/MediaErrors.h>
+#include <media/stagefright/MediaHTTP.h>
+#include <utils/Condition.h>
+#include <utils/Mutex.h>
+#include <utils/Thread.h>
+
+namespace android {
+
+struct SegmentPrefetcher::Download : public Thread {
+    Download(
+            const sp<LiveSession> &session, const AString &uri,
+            int64_t rangeOffset, int64_t rangeLength);
+
+    const AString &uri() const { return mURI; }
+
+    ssize_t read(sp<ABuffer> *out, uint32_t blockSize);
+
+    // Stops the download, aborting the block being fetched.
+    void cancel();
+
+protected:
+    virtual ~Download();
+
+private:
+    enum {
+        // Bytes received per fetch; the reader is woken up after each one.
+        kBlockSize = 16384,
+    };
+
+    sp<LiveSession> mSession;
+    AString mURI;
+    int64_t mRangeOffset;
+    int64_t mRangeLength;
+
+    // A connection of our own, so that the download runs concurrently with
+    // the session's fetches.
+    sp<HTTPBase> mHTTPSource;
+
+    Mutex mLock;
+    Condition mCondition;
+    sp<ABuffer> mBuffer;
+    size_t mNumBytesReceived;
+    size_t mNumBytesRead;
+    status_t mFinalResult;  // OK while the download is running
+
+    virtual bool threadLoop();
+
+    DISALLOW_EVIL_CONSTRUCTORS(Download);
+};
+
+SegmentPrefetcher::Download::Download(
+        const sp<LiveSession> &session, const AString &uri,
+        int64_t rangeOffset, int64_t rangeLength)
+    : Thread(false /* canCallJava */),
+      mSession(session),
+      mURI(uri),
+      mRangeOffset(rangeOffset),
+      mRangeLength(rangeLength),
+      mHTTPSource(new MediaHTTP(session->mHTTPService->makeHTTPConnection())),
+      mNumBytesReceived(0),
+      mNumBytesRead(0),
+      mFinalResult(OK) {
+}
+
+SegmentPrefetcher::Download::~Download() {
+}
+
+bool SegmentPrefetcher::Download::threadLoop() {
+    sp<DataSource> source;
+    sp<ABuffer> buffer;
+    status_t finalResult = ERROR_END_OF_STREAM;
+    while (!exitPending()) {
+        int64_t startUs = ALooper::GetNowUs();
+        ssize_t n = mSession->fetchFile(
+                mURI.c_str(), &buffer, mRangeOffset, mRangeLength, kBlockSize,
+                &source, NULL /* actualUrl */, mHTTPSource);
+
+        if (n < 0) {
+            ALOGW_IF(!exitPending(),
+                    "failed to prefetch '%s' (%zd)", mURI.c_str(), n);
+            finalResult = n;
+            break;
+        }
+
+        if (n > 0) {
+            mSession->addBandwidthMeasurement(n, startUs, ALooper::GetNowUs());
+        }
+
+        Mutex::Autolock autoLock(mLock);
+        mBuffer = buffer;
+        mNumBytesReceived = buffer->size();
+        mCondition.signal();
+
+        if (n == 0) {
+            break;
+        }
+    }
+
+    if (exitPending()) {
+        finalResult = -ECANCELED;
+    }
+    mHTTPSource->disconnect();
+
+    Mutex::Autolock autoLock(mLock);
+    mFinalResult = finalResult;
+    mCondition.signal();
+
+    return false;
+}
+
+ssize_t SegmentPrefetcher::Download::read(
+        sp<ABuffer> *out, uint32_t blockSize) {
+    Mutex::Autolock autoLock(mLock);
+
+    if (*out == NULL) {
+        // The reader starts the segment over, e.g. after parsing was
+        // interrupted; the received data is kept for that.
+        mNumBytesRead = 0;
+    }
+
+    while (mFinalResult == OK
+            && (blockSize == 0
+                || mNumBytesReceived - mNumBytesRead < blockSize)) {
+        mCondition.wait(mLock);
+    }
+
+    size_t n = mNumBytesReceived - mNumBytesRead;
+    if (blockSize > 0 && n > blockSize) {
+        n = blockSize;
+    }
+
+    if (n == 0) {
+        return mFinalResult == ERROR_END_OF_STREAM ? 0 : mFinalResult;
+    }
+
+    // Bytes below mNumBytesReceived are no longer written by the download
+    // thread, which only appends to (or reallocates) mBuffer.
+    sp<ABuffer> buffer = *out;
+    if (buffer == NULL) {
+        buffer = new ABuffer(mBuffer->capacity());
+        buffer->setRange(0, 0);
+    } else if (buffer->capacity() - buffer->size() < n) {
+        size_t capacity = mBuffer->capacity();
+        if (capacity < buffer->size() + n) {
+            capacity = buffer->size() + n;
+        }
+        sp<ABuffer> copy = new ABuffer(capacity);
+        memcpy(copy->data(), buffer->data(), buffer->size());
+        copy->setRange(0, buffer->size());
+        buffer = copy;
+    }
+
+    memcpy(buffer->data() + buffer->size(), mBuffer->data() + mNumBytesRead, n);
+    buffer->setRange(0, buffer->size() + n);
+    mNumBytesRead += n;
+
+    *out = buffer;
+    return n;
+}
+
+void SegmentPrefetcher::Download::cancel() {
+    requestExit();
+
+    // Makes the fetch in progress fail instead of completing its block,
+    // which could take long on a slow link.
+    mHTTPSource->disconnect();
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+SegmentPrefetcher::SegmentPrefetcher(
+        const sp<LiveSession> &session, size_t depth)
+    : mSession(session),
+      mDepth(depth) {
+}
+
+SegmentPrefetcher::~SegmentPrefetcher() {
+    // Downloads hold a reference to the session; don't let one of them
+    // outlive us and end up releasing it.
+    cancelAll();
+    for (size_t i = 0; i < mCancelled.size(); ++i) {
+        mCancelled.itemAt(i)->requestExitAndWait();
+    }
+}
+
+void SegmentPrefetcher::prefetch(
+        int32_t seqNumber, const AString &uri,
+        int64_t rangeOffset, int64_t rangeLength) {
+    // One more than the depth, for the segment being parsed.
+    if (mDownloads.indexOfKey(seqNumber) >= 0 || mDownloads.size() > mDepth) {
+        return;
+    }
+
+    ALOGV("prefetching segment %d '%s'", seqNumber, uri.c_str());
+
+    sp<Download> download =
+        new Download(mSession, uri, rangeOffset, rangeLength);
+    if (download->run("HLSPrefetch") != OK) {
+        return;
+    }
+    mDownloads.add(seqNumber, download);
+}
+
+bool SegmentPrefetcher::has(int32_t seqNumber, const AString &uri) {
+    ssize_t index = mDownloads.indexOfKey(seqNumber);
+    if (index < 0) {
+        return false;
+    }
+
+    if (mDownloads.valueAt(index)->uri() != uri) {
+        // the playlist changed under us
+        cancel(seqNumber);
+        return false;
+    }
+
+    return true;
+}
+
+ssize_t SegmentPrefetcher::read(
+        int32_t seqNumber, sp<ABuffer> *out, uint32_t blockSize) {
+    ssize_t index = mDownloads.indexOfKey(seqNumber);
+    CHECK_GE(index, 0);
+
+    return mDownloads.valueAt(index)->read(out, blockSize);
+}
+
+void SegmentPrefetcher::retain(int32_t first, int32_t last) {
+    for (size_t i = mDownloads.size(); i-- > 0;) {
+        int32_t seqNumber = mDownloads.keyAt(i);
+        if (seqNumber < first || seqNumber > last) {
+            cancel(seqNumber);
+        }
+    }
+}
+
+void SegmentPrefetcher::cancel(int32_t seqNumber) {
+    ssize_t index = mDownloads.indexOfKey(seqNumber);
+    if (index < 0) {
+        return;
+    }
+
+    ALOGV("cancelling prefetch of segment %d", seqNumber);
+
+    cancelAt(index);
+}
+
+void SegmentPrefetcher::cancelAll() {
+    while (!mDownloads.isEmpty()) {
+        cancelAt(mDownloads.size() - 1);
+    }
+}
+
+void SegmentPrefetcher::cancelAt(size_t index) {
+    for (size_t i = mCancelled.size(); i-- > 0;) {
+        if (!mCancelled.itemAt(i)->isRunning()) {
+            mCancelled.removeAt(i);
+        }
+    }
+
+    sp<Download> download = mDownloads.valueAt(index);
+    mDownloads.removeItemsAt(index);
+
+    download->cancel();
+    mCancelled.push(download);
+}
+
+}  // namespace android
@@ -0,0 +1,92 @@
+/*
+ * Copyright (C) 2015 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef SEGMENT_PREFETCHER_H_
+
+#define SEGMENT_PREFETCHER_H_
+
+#include <media/stagefright/foundation/ABase.h>
+#include <media/stagefright/foundation/AString.h>
+#include <utils/KeyedVector.h>
+#include <utils/RefBase.h>
+#include <utils/Vector.h>
+
+namespace android {
+
+struct ABuffer;
+struct LiveSession;
+
+// Downloads the segments following the one a PlaylistFetcher is parsing,
+// each on its own thread and HTTP connection, so that the next segments are
+// (at least partially) available by the time the parser reaches them.
+//
+// All methods are called from the fetcher's looper; the received data is
+// handed over block by block, so parsing a prefetched segment can start
+// before its download completes.
+struct SegmentPrefetcher : public RefBase {
+    SegmentPrefetcher(const sp<LiveSession> &session, size_t depth);
+
+    // Maximum number of segments downloaded ahead of the current one.
+    size_t depth() const { return mDepth; }
+
+    // Starts downloading segment seqNumber unless it is already being
+    // downloaded or depth() segments are downloaded ahead already. Callers
+    // keep the downloads within a window of segments with retain().
+    void prefetch(
+            int32_t seqNumber, const AString &uri,
+            int64_t rangeOffset, int64_t rangeLength);
+
+    // Returns true if segment seqNumber of uri is being (or has been)
+    // downloaded. A download of seqNumber from another uri is cancelled.
+    bool has(int32_t seqNumber, const AString &uri);
+
+    // Appends the next block of a prefetched segment to *out, with the same
+    // semantics as LiveSession::fetchFile() in block mode: waits until
+    // blockSize bytes are available (or the download ends), and returns the
+    // number of bytes appended, 0 once the segment is complete or an error.
+    // Like fetchFile(), a read into a NULL *out starts from the beginning of
+    // the segment, so a segment is read again in full after its parsing was
+    // interrupted.
+    ssize_t read(int32_t seqNumber, sp<ABuffer> *out, uint32_t blockSize);
+
+    // Cancels the downloads of segments outside [first, last].
+    void retain(int32_t first, int32_t last);
+
+    void cancel(int32_t seqNumber);
+    void cancelAll();
+
+protected:
+    virtual ~SegmentPrefetcher();
+
+private:
+    struct Download;
+
+    sp<LiveSession> mSession;
+    size_t mDepth;
+
+    KeyedVector<int32_t, sp<Download> > mDownloads;
+
+    // Downloads that were asked to stop but may still be running.
+    Vector<sp<Download> > mCancelled;
+
+    void cancelAt(size_t index);
+
+    DISALLOW_EVIL_CONSTRUCTORS(SegmentPrefetcher);
+};
+
+}  // namespace android
+
+#endif  // SEGMENT_PREFETCHER_H_
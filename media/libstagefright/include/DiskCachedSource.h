@@ -0,0 +1,170 @@
+/*
+ * Copyright (C) 2015 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef DISK_CACHED_SOURCE_H_
+
+#define DISK_CACHED_SOURCE_H_
+
+#include "HTTPBase.h"
+
+#include <media/stagefright/foundation/ABase.h>
+#include <media/stagefright/foundation/AHandlerReflector.h>
+#include <media/stagefright/foundation/AString.h>
+#include <utils/KeyedVector.h>
+#include <utils/threads.h>
+
+namespace android {
+
+struct ALooper;
+
+// Keeps what is read from an HTTP source in a file, so that playing the same
+// URL again (or seeking back into it) doesn't download it again. The file is
+// sparse, holding data at its offset in the resource, along with an index of
+// the ranges it holds.
+//
+// Entries are only reused while the server reports the same content length
+// and MIME type; requests carrying credentials are never cached. The cache is
+// disabled unless media.stagefright.disk-cache-dir names a directory; its
+// size is bounded by media.stagefright.disk-cache-mb, least recently used
+// entries are deleted beyond.
+//
+// Reads only write the data file: the index is rewritten, and the cache
+// directory trimmed, on a looper of our own.
+//
+// An entry is locked (flock) by the instance caching into it. Other
+// instances, e.g. a metadata retriever opening the URL being played, don't
+// cache that connection, and never delete a locked entry.
+struct DiskCachedSource : public HTTPBase {
+    // Returns NULL if the cache is disabled.
+    static sp<DiskCachedSource> Create(const sp<HTTPBase> &source);
+
+    // Caches in cacheDir, which must exist, up to maxCacheSize bytes
+    // regardless of the properties.
+    static sp<DiskCachedSource> Create(
+            const sp<HTTPBase> &source, const char *cacheDir,
+            off64_t maxCacheSize);
+
+    virtual status_t connect(
+            const char *uri,
+            const KeyedVector<String8, String8> *headers = NULL,
+            off64_t offset = 0);
+
+    virtual void disconnect();
+
+    virtual status_t initCheck() const;
+
+    virtual ssize_t readAt(off64_t offset, void *data, size_t size);
+
+    virtual status_t getSize(off64_t *size);
+    virtual uint32_t flags();
+
+    virtual status_t reconnectAtOffset(off64_t offset);
+
+    virtual sp<DecryptHandle> DrmInitialization(const char *mime = NULL);
+    virtual void getDrmInfo(sp<DecryptHandle> &handle, DrmManagerClient **client);
+    virtual String8 getUri();
+    virtual String8 getMIMEType() const;
+
+    // Measured by the wrapped source, on what is actually downloaded.
+    virtual bool estimateBandwidth(int32_t *bandwidth_bps);
+    virtual status_t getEstimatedBandwidthKbps(int32_t *kbps);
+    virtual status_t setBandwidthStatCollectFreq(int32_t freqMs);
+
+protected:
+    virtual ~DiskCachedSource();
+
+private:
+    friend struct AHandlerReflector<DiskCachedSource>;
+
+    enum {
+        kDefaultMaxCacheSizeMB = 256,
+
+        // Write the index after this much new data, so that a crash loses
+        // little of it.
+        kIndexUpdateIntervalBytes = 1024 * 1024,
+    };
+
+    enum {
+        kWhatUpdateCache = 'updt',
+    };
+
+    mutable Mutex mLock;
+
+    sp<HTTPBase> mSource;
+    AString mCacheDir;
+    off64_t mMaxCacheSize;
+
+    sp<AHandlerReflector<DiskCachedSource> > mReflector;
+    sp<ALooper> mLooper;
+    bool mUpdatePending;
+
+    // Serializes the writes of index files, and orders them: an index older
+    // than the last one written for the same entry is dropped.
+    Mutex mIndexLock;
+    uint32_t mIndexGeneration;
+    AString mIndexWrittenPath;
+    uint32_t mIndexWrittenGeneration;
+
+    // Path of the entry without extension, empty while caching is off for
+    // this connection.
+    AString mPath;
+    int mDataFd;
+
+    AString mURI;
+    off64_t mSize;
+    AString mMIMEType;
+
+    // Start offset to end offset of the cached ranges, disjoint and not
+    // adjacent.
+    KeyedVector<off64_t, off64_t> mRanges;
+    size_t mNumBytesSinceIndexUpdate;
+
+    DiskCachedSource(
+            const sp<HTTPBase> &source, const char *cacheDir,
+            off64_t maxCacheSize);
+
+    void openEntry_l(const char *uri);
+
+    // Deletes the files of the entry if discard is set, writes its index
+    // otherwise.
+    void closeEntry_l(bool discard = false);
+
+    bool readIndex_l();
+    AString formatIndex_l(uint32_t *generation);
+    void writeIndex(
+            const AString &path, const AString &index, uint32_t generation,
+            int dataFd);
+
+    bool isCached_l(off64_t offset, size_t size) const;
+    void addRange_l(off64_t offset, size_t size);
+
+    void postUpdateCache_l();
+    void onUpdateCache();
+
+    // Deletes the least recently used entries other than the one at
+    // currentPath, and other than those in use by other instances, until the
+    // cache fits its budget. Returns false if the current entry is too large
+    // alone.
+    bool trimCache(const AString &currentPath);
+
+    void onMessageReceived(const sp<AMessage> &msg);
+
+    DISALLOW_EVIL_CONSTRUCTORS(DiskCachedSource);
+};
+
+}  // namespace android
+
+#endif  // DISK_CACHED_SOURCE_H_
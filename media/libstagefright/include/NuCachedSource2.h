@@ -21,6 +21,7 @@
 #include <media/stagefright/foundation/ABase.h>
 #include <media/stagefright/foundation/AHandlerReflector.h>
 #include <media/stagefright/DataSource.h>
+#include <utils/Vector.h>
 
 namespace android {
 
@@ -77,6 +78,9 @@ private:
         kDefaultHighWaterThreshold      = 20 * 1024 * 1024,
         kDefaultLowWaterThreshold       = 4 * 1024 * 1024,
 
+        // Data kept from ranges fetched before a seek.
+        kDefaultMaxRetainedBytes        = 8 * 1024 * 1024,
+
         // Read data after a 15 sec timeout whether we're actively
         // fetching or not.
         kDefaultKeepAliveIntervalUs     = 15000000,
@@ -99,8 +103,25 @@ private:
     mutable Mutex mLock;
     Condition mCondition;
 
+    // The range being fetched, starting at mCacheOffset.
     PageCache *mCache;
     off64_t mCacheOffset;
+
+    // Disjoint ranges cached before a seek elsewhere (e.g. the index at the
+    // end of a file). Reads are served from them, fetching resumes at their
+    // end when a read falls into one, and a fetch reaching one merges it.
+    // Evicted least recently used first, from their start, beyond
+    // mMaxRetainedBytes.
+    struct CachedRange {
+        off64_t mOffset;
+        PageCache *mCache;
+        uint32_t mLastAccess;
+    };
+    Vector<CachedRange> mRanges;
+    size_t mMaxRetainedBytes;
+    size_t mRetainedBytes;
+    uint32_t mAccessCounter;
+
     status_t mFinalStatus;
     off64_t mLastAccessPos;
     sp<AMessage> mAsyncResult;
@@ -126,6 +147,11 @@ private:
     ssize_t readInternal(off64_t offset, void *data, size_t size);
     status_t seekInternal_l(off64_t offset);
 
+    ssize_t findRange_l(off64_t offset) const;
+    bool readFromRange_l(off64_t offset, void *data, size_t size);
+    void mergeFollowingRange_l();
+    void evictRanges_l();
+
     size_t approxDataRemaining_l(status_t *finalStatus) const;
 
     void restartPrefetcherIfNecessary_l(
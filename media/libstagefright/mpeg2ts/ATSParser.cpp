@@ -37,6 +37,7 @@
 #include <utils/KeyedVector.h>
 
 #include <inttypes.h>
+#include <string.h>
 
 namespace android {
 
@@ -46,6 +47,10 @@ namespace android {
 
 static const size_t kTSPacketSize = 188;
 
+static void selectPID(uint32_t *filter, unsigned PID) {
+    filter[PID >> 5] |= 1u << (PID & 31);
+}
+
 struct ATSParser::Program : public RefBase {
     Program(ATSParser *parser, unsigned programNumber, unsigned programMapPID);
 
@@ -84,6 +89,9 @@ struct ATSParser::Program : public RefBase {
         return mParser->mFlags;
     }
 
+    // Selects the PIDs of this program's streams and their PCR.
+    void selectPIDs(uint32_t *filter) const;
+
 private:
     ATSParser *mParser;
     unsigned mProgramNumber;
@@ -106,6 +114,7 @@ struct ATSParser::Stream : public RefBase {
     unsigned type() const { return mStreamType; }
     unsigned pid() const { return mElementaryPID; }
     void setPID(unsigned pid) { mElementaryPID = pid; }
+    unsigned pcrPID() const { return mPCR_PID; }
 
     status_t parse(
             unsigned continuity_counter,
@@ -215,6 +224,14 @@ bool ATSParser::Program::parsePID(
     return true;
 }
 
+void ATSParser::Program::selectPIDs(uint32_t *filter) const {
+    for (size_t i = 0; i < mStreams.size(); ++i) {
+        const sp<Stream> &stream = mStreams.valueAt(i);
+        selectPID(filter, stream->pid());
+        selectPID(filter, stream->pcrPID());
+    }
+}
+
 void ATSParser::Program::signalDiscontinuity(
         DiscontinuityType type, const sp<AMessage> &extra) {
     int64_t mediaTimeUs;
@@ -949,6 +966,7 @@ ATSParser::ATSParser(uint32_t flags)
       mTimeOffsetValid(false),
       mTimeOffsetUs(0ll),
       mNumTSPacketsParsed(0),
+      mPIDFilterValid(false),
       mNumPCRs(0) {
     mPSISections.add(0 /* PID */, new PSISection);
 }
@@ -963,6 +981,85 @@ status_t ATSParser::feedTSPacket(const void *data, size_t size) {
     return parseTS(&br);
 }
 
+status_t ATSParser::feedTSPackets(
+        const void *data, size_t size, size_t *numBytesConsumed) {
+    const uint8_t *ptr = (const uint8_t *)data;
+    size_t offset = 0;
+    status_t err = OK;
+
+    while (offset + kTSPacketSize <= size) {
+        const uint8_t *packet = ptr + offset;
+
+        if (packet[0] != 0x47) {
+            // Lost sync. Take the next sync byte that is followed by
+            // another one a packet later as the start of a packet; memchr
+            // is vectorized where it matters.
+            size_t start = offset + 1;
+            for (;;) {
+                const uint8_t *next =
+                    (const uint8_t *)memchr(ptr + start, 0x47, size - start);
+
+                if (next == NULL) {
+                    start = size;
+                    break;
+                }
+
+                start = next - ptr;
+                if (start + kTSPacketSize >= size
+                        || ptr[start + kTSPacketSize] == 0x47) {
+                    break;
+                }
+                ++start;
+            }
+
+            ALOGW("lost sync, skipping %zu bytes", start - offset);
+            offset = start;
+            continue;
+        }
+
+        if (!mPIDFilterValid) {
+            updatePIDFilter();
+        }
+
+        unsigned PID = ((packet[1] & 0x1f) << 8) | packet[2];
+        if (!isPIDSelected(PID)) {
+            // parseTS() would count it, unless flagged as corrupt.
+            if (!(packet[1] & 0x80)) {  // transport_error_indicator
+                ++mNumTSPacketsParsed;
+            }
+            offset += kTSPacketSize;
+            continue;
+        }
+
+        ABitReader br(packet, kTSPacketSize);
+        err = parseTS(&br);
+
+        if (err != OK) {
+            break;
+        }
+
+        offset += kTSPacketSize;
+    }
+
+    *numBytesConsumed = offset;
+
+    return err;
+}
+
+void ATSParser::updatePIDFilter() {
+    memset(mPIDFilter, 0, sizeof(mPIDFilter));
+
+    for (size_t i = 0; i < mPSISections.size(); ++i) {
+        selectPID(mPIDFilter, mPSISections.keyAt(i));
+    }
+
+    for (size_t i = 0; i < mPrograms.size(); ++i) {
+        mPrograms.itemAt(i)->selectPIDs(mPIDFilter);
+    }
+
+    mPIDFilterValid = true;
+}
+
 void ATSParser::signalDiscontinuity(
         DiscontinuityType type, const sp<AMessage> &extra) {
     int64_t mediaTimeUs;
@@ -1093,6 +1190,9 @@ status_t ATSParser::parsePID(
 
         ABitReader sectionBits(section->data(), section->size());
 
+        // Programs and streams may come and go with any PSI section.
+        mPIDFilterValid = false;
+
         if (PID == 0) {
             parseProgramAssociationTable(&sectionBits);
         } else {
@@ -65,6 +65,14 @@ struct ATSParser : public RefBase {
 
     status_t feedTSPacket(const void *data, size_t size);
 
+    // Parses a run of transport stream packets. Packets of PIDs no program
+    // refers to are dropped after a look at their header, and bytes that
+    // don't start a packet are skipped until the stream is in sync again.
+    // A trailing partial packet is left alone: *numBytesConsumed tells where
+    // it starts, callers prepend it to the next run.
+    status_t feedTSPackets(
+            const void *data, size_t size, size_t *numBytesConsumed);
+
     void signalDiscontinuity(
             DiscontinuityType type, const sp<AMessage> &extra);
 
@@ -119,6 +127,21 @@ private:
 
     size_t mNumTSPacketsParsed;
 
+    enum {
+        kNumPIDs = 8192,
+    };
+
+    // One bit per PID that parseTS() needs to see: PSI sections, elementary
+    // streams and PCRs. Rebuilt lazily after a PSI section was parsed, as
+    // that is what adds programs and streams.
+    uint32_t mPIDFilter[kNumPIDs / 32];
+    bool mPIDFilterValid;
+
+    void updatePIDFilter();
+    bool isPIDSelected(unsigned PID) const {
+        return mPIDFilter[PID >> 5] & (1u << (PID & 31));
+    }
+
     void parseProgramAssociationTable(ABitReader *br);
     void parseProgramMap(ABitReader *br);
     void parsePES(ABitReader *br);
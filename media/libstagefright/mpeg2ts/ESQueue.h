@@ -61,6 +61,8 @@ private:
     Mode mMode;
     uint32_t mFlags;
 
+    // Consumed data is dropped by moving the start of mBuffer's range;
+    // appendData() reclaims the space once it runs out of room.
     sp<ABuffer> mBuffer;
     List<RangeInfo> mRangeInfos;
 
@@ -74,6 +76,9 @@ private:
     sp<ABuffer> dequeueAccessUnitMPEG4Video();
     sp<ABuffer> dequeueAccessUnitPCMAudio();
 
+    // Drops the first size bytes of mBuffer.
+    void consumeData(size_t size);
+
     // consume a logical (compressed) access unit of size "size",
     // returns its timestamp in us (or -1 if no time information).
     int64_t fetchTimestamp(size_t size);
@@ -36,6 +36,9 @@ namespace android {
 
 static const size_t kTSPacketSize = 188;
 
+// Packets read and handed to the parser at a time.
+static const size_t kNumPacketsPerFeed = 16;
+
 struct MPEG2TSSource : public MediaSource {
     MPEG2TSSource(
             const sp<MPEG2TSExtractor> &extractor,
@@ -156,7 +159,6 @@ sp<MetaData> MPEG2TSExtractor::getMetaData() {
 void MPEG2TSExtractor::init() {
     bool haveAudio = false;
     bool haveVideo = false;
-    int numPacketsParsed = 0;
 
     while (feedMore() == OK) {
         ATSParser::SourceType type;
@@ -185,7 +187,7 @@ void MPEG2TSExtractor::init() {
             }
         }
 
-        if (++numPacketsParsed > 10000) {
+        if (mOffset > 10000 * (off64_t)kTSPacketSize) {
             break;
         }
     }
@@ -196,15 +198,18 @@ void MPEG2TSExtractor::init() {
 status_t MPEG2TSExtractor::feedMore() {
     Mutex::Autolock autoLock(mLock);
 
-    uint8_t packet[kTSPacketSize];
-    ssize_t n = mDataSource->readAt(mOffset, packet, kTSPacketSize);
+    uint8_t packets[kNumPacketsPerFeed * kTSPacketSize];
+    ssize_t n = mDataSource->readAt(mOffset, packets, sizeof(packets));
 
     if (n < (ssize_t)kTSPacketSize) {
         return (n < 0) ? (status_t)n : ERROR_END_OF_STREAM;
     }
 
-    mOffset += n;
-    return mParser->feedTSPacket(packet, kTSPacketSize);
+    size_t numBytesConsumed;
+    status_t err = mParser->feedTSPackets(packets, n, &numBytesConsumed);
+
+    mOffset += numBytesConsumed;
+    return err;
 }
 
 uint32_t MPEG2TSExtractor::flags() const {
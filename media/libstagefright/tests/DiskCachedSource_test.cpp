@@ -0,0 +1,290 @@
+/*
+ * Copyright 2015 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+//#define LOG_NDEBUG 0
+#define LOG_TAG "DiskCachedSource_test"
+
+#include <gtest/gtest.h>
+#include <utils/KeyedVector.h>
+#include <utils/String8.h>
+#include <dirent.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <media/stagefright/foundation/AString.h>
+
+#include "include/DiskCachedSource.h"
+
+namespace android {
+
+static const size_t kReadSize = 65536;
+
+// Stands in for a HTTP server: generated content of a given length, counting
+// the bytes it serves.
+struct FakeHTTPSource : public HTTPBase {
+    FakeHTTPSource(size_t size, uint8_t seed)
+        : mSize(size),
+          mSeed(seed),
+          mNumBytesServed(0) {
+    }
+
+    uint8_t byteAt(off64_t offset) const {
+        return (uint8_t)(offset * 7 + mSeed);
+    }
+
+    size_t numBytesServed() const {
+        return mNumBytesServed;
+    }
+
+    virtual status_t connect(
+            const char * /* uri */,
+            const KeyedVector<String8, String8> * /* headers */,
+            off64_t /* offset */) {
+        return OK;
+    }
+
+    virtual void disconnect() {}
+
+    virtual status_t initCheck() const {
+        return OK;
+    }
+
+    virtual ssize_t readAt(off64_t offset, void *data, size_t size) {
+        if (offset >= (off64_t)mSize) {
+            return 0;
+        }
+        if (size > mSize - offset) {
+            size = mSize - offset;
+        }
+
+        for (size_t i = 0; i < size; ++i) {
+            ((uint8_t *)data)[i] = byteAt(offset + i);
+        }
+        mNumBytesServed += size;
+
+        return size;
+    }
+
+    virtual status_t getSize(off64_t *size) {
+        *size = mSize;
+        return OK;
+    }
+
+    virtual String8 getMIMEType() const {
+        return String8("video/mp4");
+    }
+
+private:
+    size_t mSize;
+    uint8_t mSeed;
+    size_t mNumBytesServed;
+
+    DISALLOW_EVIL_CONSTRUCTORS(FakeHTTPSource);
+};
+
+class DiskCachedSourceTest : public ::testing::Test {
+protected:
+    virtual void SetUp() {
+        char dir[] = "/data/local/tmp/DiskCachedSource_test.XXXXXX";
+        ASSERT_TRUE(mkdtemp(dir) != NULL);
+        mCacheDir = dir;
+    }
+
+    virtual void TearDown() {
+        DIR *dir = opendir(mCacheDir.c_str());
+        if (dir != NULL) {
+            struct dirent *ent;
+            while ((ent = readdir(dir)) != NULL) {
+                if (ent->d_name[0] != '.') {
+                    unlink(StringPrintf(
+                            "%s/%s", mCacheDir.c_str(), ent->d_name).c_str());
+                }
+            }
+            closedir(dir);
+        }
+        rmdir(mCacheDir.c_str());
+    }
+
+    size_t numCacheFiles() const {
+        size_t n = 0;
+        DIR *dir = opendir(mCacheDir.c_str());
+        if (dir != NULL) {
+            struct dirent *ent;
+            while ((ent = readdir(dir)) != NULL) {
+                if (ent->d_name[0] != '.') {
+                    ++n;
+                }
+            }
+            closedir(dir);
+        }
+        return n;
+    }
+
+    // Waits for the cache looper to bring the number of files down to n.
+    bool waitForNumCacheFiles(size_t n) const {
+        for (int i = 0; i < 100; ++i) {
+            if (numCacheFiles() == n) {
+                return true;
+            }
+            usleep(20000);
+        }
+        return false;
+    }
+
+    // Reads the end of the resource (where an index might be), then all of
+    // it, like a player would, checking what is read.
+    sp<DiskCachedSource> play(
+            const sp<FakeHTTPSource> &http, const char *uri,
+            off64_t maxCacheSize, bool withCredentials = false) {
+        sp<DiskCachedSource> source =
+            DiskCachedSource::Create(http, mCacheDir.c_str(), maxCacheSize);
+
+        KeyedVector<String8, String8> headers;
+        if (withCredentials) {
+            headers.add(String8("Cookie"), String8("session=1"));
+        }
+        EXPECT_EQ(OK, source->connect(uri, &headers));
+
+        off64_t size;
+        EXPECT_EQ(OK, http->getSize(&size));
+
+        uint8_t data[kReadSize];
+        off64_t offset = size - 1000;
+        EXPECT_EQ(1000, source->readAt(offset, data, kReadSize));
+        for (size_t i = 0; i < 1000; ++i) {
+            EXPECT_EQ(http->byteAt(offset + i), data[i]);
+        }
+
+        offset = 0;
+        ssize_t n;
+        while ((n = source->readAt(offset, data, kReadSize)) > 0) {
+            for (ssize_t i = 0; i < n; ++i) {
+                if (http->byteAt(offset + i) != data[i]) {
+                    ADD_FAILURE() << "wrong data at " << offset + i;
+                    return source;
+                }
+            }
+            offset += n;
+        }
+        EXPECT_EQ(size, offset);
+
+        return source;
+    }
+
+    AString mCacheDir;
+};
+
+static const off64_t kLargeCache = 64 * 1024 * 1024;
+
+TEST_F(DiskCachedSourceTest, ReplayReadsFromDisk) {
+    sp<FakeHTTPSource> http = new FakeHTTPSource(3000000, 1);
+    play(http, "http://host/a.mp4", kLargeCache);
+    EXPECT_EQ(3000000u + 1000u, http->numBytesServed());
+
+    http = new FakeHTTPSource(3000000, 1);
+    play(http, "http://host/a.mp4", kLargeCache);
+    EXPECT_EQ(0u, http->numBytesServed());
+}
+
+TEST_F(DiskCachedSourceTest, ChangedLengthInvalidatesEntry) {
+    sp<FakeHTTPSource> http = new FakeHTTPSource(3000000, 1);
+    play(http, "http://host/a.mp4", kLargeCache);
+
+    http = new FakeHTTPSource(3000001, 2);
+    play(http, "http://host/a.mp4", kLargeCache);
+    EXPECT_EQ(3000001u + 1000u, http->numBytesServed());
+}
+
+TEST_F(DiskCachedSourceTest, CredentialsBypassCache) {
+    sp<FakeHTTPSource> http = new FakeHTTPSource(3000000, 1);
+    play(http, "http://host/a.mp4", kLargeCache, true /* withCredentials */);
+    EXPECT_EQ(0u, numCacheFiles());
+
+    http = new FakeHTTPSource(3000000, 1);
+    play(http, "http://host/a.mp4", kLargeCache, true /* withCredentials */);
+    EXPECT_EQ(3000000u + 1000u, http->numBytesServed());
+}
+
+TEST_F(DiskCachedSourceTest, EvictsLeastRecentlyUsed) {
+    static const off64_t kCacheSize = 5 * 1024 * 1024;
+
+    sp<FakeHTTPSource> http = new FakeHTTPSource(3000000, 1);
+    play(http, "http://host/a.mp4", kCacheSize);
+    EXPECT_EQ(2u, numCacheFiles());
+
+    http = new FakeHTTPSource(3000000, 2);
+    play(http, "http://host/b.mp4", kCacheSize);
+
+    // The least recently used a.mp4 makes room for b.mp4.
+    http = new FakeHTTPSource(3000000, 2);
+    sp<DiskCachedSource> source = play(http, "http://host/b.mp4", kCacheSize);
+    EXPECT_EQ(0u, http->numBytesServed());
+    EXPECT_TRUE(waitForNumCacheFiles(2));
+    source.clear();
+
+    http = new FakeHTTPSource(3000000, 1);
+    play(http, "http://host/a.mp4", kCacheSize);
+    EXPECT_EQ(3000000u + 1000u, http->numBytesServed());
+}
+
+TEST_F(DiskCachedSourceTest, EntryInUseIsNotShared) {
+    sp<FakeHTTPSource> http = new FakeHTTPSource(3000000, 1);
+    sp<DiskCachedSource> source = play(http, "http://host/a.mp4", kLargeCache);
+
+    // Like a metadata retriever opening the URL being played.
+    http = new FakeHTTPSource(3000000, 1);
+    play(http, "http://host/a.mp4", kLargeCache);
+    EXPECT_EQ(3000000u + 1000u, http->numBytesServed());
+    source.clear();
+
+    http = new FakeHTTPSource(3000000, 1);
+    play(http, "http://host/a.mp4", kLargeCache);
+    EXPECT_EQ(0u, http->numBytesServed());
+}
+
+TEST_F(DiskCachedSourceTest, EntryInUseIsNotEvicted) {
+    static const off64_t kCacheSize = 5 * 1024 * 1024;
+
+    sp<FakeHTTPSource> http = new FakeHTTPSource(3000000, 1);
+    sp<DiskCachedSource> source = play(http, "http://host/a.mp4", kCacheSize);
+
+    http = new FakeHTTPSource(3000000, 2);
+    play(http, "http://host/b.mp4", kCacheSize);
+    http = new FakeHTTPSource(3000000, 2);
+    play(http, "http://host/b.mp4", kCacheSize);
+    source.clear();
+
+    http = new FakeHTTPSource(3000000, 1);
+    play(http, "http://host/a.mp4", kCacheSize);
+    EXPECT_EQ(0u, http->numBytesServed());
+}
+
+TEST_F(DiskCachedSourceTest, OversizedEntryIsDeleted) {
+    sp<FakeHTTPSource> http = new FakeHTTPSource(3000000, 1);
+    sp<DiskCachedSource> source =
+        play(http, "http://host/a.mp4", 1024 * 1024);
+    EXPECT_TRUE(waitForNumCacheFiles(0));
+
+    // Still readable, from the network.
+    uint8_t data[kReadSize];
+    size_t numBytesServed = http->numBytesServed();
+    EXPECT_EQ((ssize_t)kReadSize, source->readAt(0, data, kReadSize));
+    EXPECT_EQ(http->byteAt(0), data[0]);
+    EXPECT_EQ(numBytesServed + kReadSize, http->numBytesServed());
+}
+
+} // namespace android
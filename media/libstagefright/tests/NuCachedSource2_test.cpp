@@ -0,0 +1,152 @@
+/*
+ * Copyright 2015 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+//#define LOG_NDEBUG 0
+#define LOG_TAG "NuCachedSource2_test"
+
+#include <gtest/gtest.h>
+#include <utils/KeyedVector.h>
+#include <utils/threads.h>
+#include <unistd.h>
+
+#include <media/stagefright/DataSource.h>
+
+#include "include/NuCachedSource2.h"
+
+namespace android {
+
+static const off64_t kSourceSize = 16 * 1024 * 1024;
+static const size_t kReadSize = 4096;
+
+static uint8_t byteAt(off64_t offset) {
+    return (uint8_t)((offset * 7) ^ (offset >> 16));
+}
+
+// Generated content, remembering which bytes were read.
+struct PatternSource : public DataSource {
+    PatternSource() : mRereadOffset(-1) {}
+
+    virtual status_t initCheck() const {
+        return OK;
+    }
+
+    virtual ssize_t readAt(off64_t offset, void *data, size_t size) {
+        if (offset >= kSourceSize) {
+            return 0;
+        }
+        if (size > kSourceSize - offset) {
+            size = kSourceSize - offset;
+        }
+
+        for (size_t i = 0; i < size; ++i) {
+            ((uint8_t *)data)[i] = byteAt(offset + i);
+        }
+
+        Mutex::Autolock autoLock(mLock);
+        if (mReads.indexOfKey(offset) >= 0) {
+            mRereadOffset = offset;
+        }
+        mReads.add(offset, size);
+
+        return size;
+    }
+
+    virtual status_t getSize(off64_t *size) {
+        *size = kSourceSize;
+        return OK;
+    }
+
+    // Returns the offset of a byte read more than once, -1 if none was.
+    off64_t findOverlap() {
+        Mutex::Autolock autoLock(mLock);
+        if (mRereadOffset >= 0) {
+            return mRereadOffset;
+        }
+
+        // Sorted by offset.
+        for (size_t i = 1; i < mReads.size(); ++i) {
+            if (mReads.keyAt(i - 1) + (off64_t)mReads.valueAt(i - 1)
+                    > mReads.keyAt(i)) {
+                return mReads.keyAt(i);
+            }
+        }
+        return -1;
+    }
+
+private:
+    Mutex mLock;
+    KeyedVector<off64_t, size_t> mReads;
+    off64_t mRereadOffset;
+
+    DISALLOW_EVIL_CONSTRUCTORS(PatternSource);
+};
+
+class NuCachedSource2Test : public ::testing::Test {
+protected:
+    // Waits for the prefetcher to stop at the high water mark.
+    static size_t waitForFetchToStop(const sp<NuCachedSource2> &cached) {
+        size_t cachedSize = cached->cachedSize();
+        for (int i = 0; i < 100; ++i) {
+            usleep(50000);
+            size_t size = cached->cachedSize();
+            if (size == cachedSize) {
+                break;
+            }
+            cachedSize = size;
+        }
+        return cachedSize;
+    }
+
+    static void checkRead(const sp<NuCachedSource2> &cached, off64_t offset) {
+        uint8_t data[kReadSize];
+        ASSERT_EQ((ssize_t)kReadSize, cached->readAt(offset, data, kReadSize));
+        for (size_t i = 0; i < kReadSize; ++i) {
+            ASSERT_EQ(byteAt(offset + i), data[i]) << "at " << offset + i;
+        }
+    }
+};
+
+TEST_F(NuCachedSource2Test, SeekPastRetainedRange) {
+    sp<PatternSource> source = new PatternSource;
+
+    // 512K low, 1M high water mark, 8M retained.
+    sp<NuCachedSource2> cached =
+        new NuCachedSource2(source, "512/1024/15/8192");
+
+    checkRead(cached, 0);
+    off64_t retainedEnd = waitForFetchToStop(cached);
+    ASSERT_GE(retainedEnd, 1024 * 1024);
+
+    // Moves [0, retainedEnd) to the retained ranges.
+    checkRead(cached, 8 * 1024 * 1024);
+
+    // The seek is padded backwards into the retained range, which must not
+    // be fetched again.
+    checkRead(cached, retainedEnd + 4096);
+    EXPECT_EQ(-1, source->findOverlap());
+
+    // All the ranges are still served.
+    checkRead(cached, 65536);
+    checkRead(cached, retainedEnd - 2048);
+    checkRead(cached, 8 * 1024 * 1024 + 4096);
+
+    waitForFetchToStop(cached);
+    EXPECT_EQ(-1, source->findOverlap());
+
+    cached->disconnect();
+}
+
+} // namespace android
@@ -490,6 +490,8 @@ private:
         virtual status_t    setParameters(const String8& keyValuePairs);
         virtual status_t    getTimestamp(AudioTimestamp& timestamp);
         virtual void        signal(); // signal playback thread for a change in control block
+        virtual status_t    setStartTime(int64_t presentationTimeNs);
+        virtual status_t    setStopTime(int64_t presentationTimeNs);
 
         virtual status_t onTransact(
             uint32_t code, const Parcel& data, Parcel* reply, uint32_t flags);
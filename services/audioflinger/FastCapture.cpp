@@ -21,6 +21,7 @@
 
 #include "Configuration.h"
 #include <linux/futex.h>
+#include <time.h>
 #include <sys/syscall.h>
 #include <media/AudioBufferProvider.h>
 #include <utils/Log.h>
@@ -163,10 +164,23 @@ void FastCapture::onWork()
         ALOG_ASSERT(inputSource != NULL);
         ALOG_ASSERT(readBuffer != NULL);
         dumpState->mReadSequence++;
+#ifdef FAST_MIXER_STATISTICS
+        struct timespec beforeRead;
+        bool beforeReadValid = clock_gettime(CLOCK_MONOTONIC, &beforeRead) == 0;
+#endif
         ATRACE_BEGIN("read");
         ssize_t framesRead = inputSource->read(readBuffer, frameCount,
                 AudioBufferProvider::kInvalidPTS);
         ATRACE_END();
+#ifdef FAST_MIXER_STATISTICS
+        struct timespec afterRead;
+        if (beforeReadValid && clock_gettime(CLOCK_MONOTONIC, &afterRead) == 0) {
+            int64_t blockedNs = (afterRead.tv_sec - beforeRead.tv_sec) * 1000000000LL +
+                    (afterRead.tv_nsec - beforeRead.tv_nsec);
+            dumpState->sampleHistogram(FastThreadDumpState::HIST_IO_BLOCKED,
+                    blockedNs < 0 ? 0 : (uint32_t) (blockedNs / 1000));
+        }
+#endif
         dumpState->mReadSequence++;
         if (framesRead >= 0) {
             LOG_ALWAYS_FATAL_IF((size_t) framesRead > frameCount);
@@ -192,11 +206,13 @@ void FastCapture::onWork()
         }
         if (readBufferState > 0) {
             ssize_t framesWritten = pipeSink->write(readBuffer, readBufferState);
-            // FIXME This supports at most one fast capture client.
-            //       To handle multiple clients this could be converted to an array,
-            //       or with a lot more work the control block could be shared by all clients.
-            audio_track_cblk_t* cblk = current->mCblk;
-            if (cblk != NULL && framesWritten > 0) {
+            // FIXME with a lot more work the control block could be shared by all clients
+            for (unsigned i = 0; framesWritten > 0 && i < FastCaptureState::kMaxFastTracks;
+                    i++) {
+                audio_track_cblk_t* cblk = current->mCblks[i];
+                if (cblk == NULL) {
+                    continue;
+                }
                 int32_t rear = cblk->u.mStreaming.mRear;
                 android_atomic_release_store(framesWritten + rear, &cblk->u.mStreaming.mRear);
                 cblk->mServer += framesWritten;
@@ -21,6 +21,9 @@ namespace android {
 FastCaptureState::FastCaptureState() : FastThreadState(),
     mInputSource(NULL), mInputSourceGen(0), mPipeSink(NULL), mPipeSinkGen(0), mFrameCount(0)
 {
+    for (unsigned i = 0; i < kMaxFastTracks; i++) {
+        mCblks[i] = NULL;
+    }
 }
 
 FastCaptureState::~FastCaptureState()
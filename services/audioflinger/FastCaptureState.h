@@ -35,7 +35,11 @@ struct FastCaptureState : FastThreadState {
     NBAIO_Sink      *mPipeSink;         // after reading from input source, write to this pipe sink
     int             mPipeSinkGen;       // increment when mPipeSink is assigned
     size_t          mFrameCount;        // number of frames per fast capture buffer
-    audio_track_cblk_t  *mCblk;         // control block for the single fast client, or NULL
+
+    // Fast clients all read the pipe memory directly, each one through its own control block
+    // and rolling indices, so adding a client does not add a buffer hop or a copy.
+    static const unsigned kMaxFastTracks = 4;   // must be between 1 and 32 inclusive
+    audio_track_cblk_t  *mCblks[kMaxFastTracks];    // control blocks of the fast clients, or NULL
 
     // Extends FastThreadState::Command
     static const Command
@@ -425,9 +425,22 @@ void FastMixer::onWork()
         // FIXME write() is non-blocking and lock-free for a properly implemented NBAIO sink,
         //       but this code should be modified to handle both non-blocking and blocking sinks
         dumpState->mWriteSequence++;
+#ifdef FAST_MIXER_STATISTICS
+        struct timespec beforeWrite;
+        bool beforeWriteValid = clock_gettime(CLOCK_MONOTONIC, &beforeWrite) == 0;
+#endif
         ATRACE_BEGIN("write");
         ssize_t framesWritten = outputSink->write(buffer, frameCount);
         ATRACE_END();
+#ifdef FAST_MIXER_STATISTICS
+        struct timespec afterWrite;
+        if (beforeWriteValid && clock_gettime(CLOCK_MONOTONIC, &afterWrite) == 0) {
+            int64_t blockedNs = (afterWrite.tv_sec - beforeWrite.tv_sec) * 1000000000LL +
+                    (afterWrite.tv_nsec - beforeWrite.tv_nsec);
+            dumpState->sampleHistogram(FastThreadDumpState::HIST_IO_BLOCKED,
+                    blockedNs < 0 ? 0 : (uint32_t) (blockedNs / 1000));
+        }
+#endif
         dumpState->mWriteSequence++;
         if (framesWritten >= 0) {
             ALOG_ASSERT((size_t) framesWritten <= frameCount);
@@ -637,6 +650,7 @@ void FastMixerDumpState::dump(int fd) const
                     right.stddev()*1e-6);
         delete[] tail;
     }
+    dumpHistograms(fd);
 #endif
     // The active track mask and track states are updated non-atomically.
     // So if we relied on isActive to decide whether to display,
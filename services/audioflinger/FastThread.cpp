@@ -24,6 +24,7 @@
 #include <sys/syscall.h>
 #include <utils/Log.h>
 #include <utils/Trace.h>
+#include <cpustats/ThreadCpuRegistry.h>
 #include "FastThread.h"
 
 #define FAST_DEFAULT_NS    999999999L   // ~1 sec: default time to sleep
@@ -33,6 +34,11 @@
 
 namespace android {
 
+// binary NBLog events logged for anomalous cycles only, formatted when the log is read;
+// logging every cycle would evict the rest of the small per-thread log within a second
+static const NBLog::Format kUnderrunFormat("underrun: cycle %d us");
+static const NBLog::Format kOverrunFormat("overrun: cycle %d us");
+
 FastThread::FastThread() : Thread(false /*canCallJava*/),
     // re-initialized to &initial by subclass constructor
      previous(NULL), current(NULL),
@@ -81,6 +87,7 @@ FastThread::~FastThread()
 
 bool FastThread::threadLoop()
 {
+    ThreadCpuRegistry::registerThread("audioflinger");
     for (;;) {
 
         // either nanosleep, sched_yield, or busy wait
@@ -182,6 +189,7 @@ bool FastThread::threadLoop()
             continue;
         case FastThreadState::EXIT:
             onExit();
+            ThreadCpuRegistry::unregisterThread();
             return false;
         default:
             LOG_ALWAYS_FATAL_IF(!isSubClassCommand(command));
@@ -247,6 +255,12 @@ bool FastThread::threadLoop()
                         ALOGV("underrun: time since last cycle %d.%03ld sec",
                                 (int) sec, nsec / 1000000L);
                         dumpState->mUnderruns++;
+                        logWriter->logEvent(kUnderrunFormat,
+                                (int32_t) (sec < 4 ? sec * 1000000 + nsec / 1000 : 0x7FFFFFFF));
+#ifdef FAST_MIXER_STATISTICS
+                        dumpState->sampleHistogram(FastThreadDumpState::HIST_UNDERRUN_GAP,
+                                sec < 4 ? sec * 1000000 + nsec / 1000 : 0xFFFFFFFF);
+#endif
                         ignoreNextOverrun = true;
                     } else if (nsec < overrunNs) {
                         if (ignoreNextOverrun) {
@@ -256,6 +270,7 @@ bool FastThread::threadLoop()
                             ALOGV("overrun: time since last cycle %d.%03ld sec",
                                     (int) sec, nsec / 1000000L);
                             dumpState->mOverruns++;
+                            logWriter->logEvent(kOverrunFormat, (int32_t) (nsec / 1000));
                         }
                         // This forces a minimum cycle time. It:
                         //  - compensates for an audio HAL with jitter due to sample rate conversion
@@ -322,6 +337,10 @@ bool FastThread::threadLoop()
                     // this store #4 is not atomic with respect to stores #1, #2, #3 above, but
                     // the newest open & oldest closed halves are atomic with respect to each other
                     dumpState->mBounds = bounds;
+                    dumpState->sampleHistogram(FastThreadDumpState::HIST_CYCLE,
+                            monotonicNs / 1000);
+                    dumpState->sampleHistogram(FastThreadDumpState::HIST_LOAD, loadNs / 1000);
+                    dumpState->advanceHistogramWindow(monotonicNs / 1000);
                     ATRACE_INT("cycle_ms", monotonicNs / 1000000);
                     ATRACE_INT("load_us", loadNs / 1000);
                 }
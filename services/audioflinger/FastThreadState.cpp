@@ -15,6 +15,9 @@
  */
 
 #include "Configuration.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <cutils/properties.h>
 #include "FastThreadState.h"
 
 namespace android {
@@ -35,15 +38,77 @@ FastThreadDumpState::FastThreadDumpState() :
     /* mMeasuredWarmupTs({0, 0}), */
     mWarmupCycles(0)
 #ifdef FAST_MIXER_STATISTICS
-    , mSamplingN(1), mBounds(0)
+    , mSamplingN(1), mBounds(0), mHistogramWindowMs(kDefaultHistogramWindowMs),
+    mHistogramWindow(0)
 #endif
 {
     mMeasuredWarmupTs.tv_sec = 0;
     mMeasuredWarmupTs.tv_nsec = 0;
+#ifdef FAST_MIXER_STATISTICS
+    char value[PROPERTY_VALUE_MAX];
+    if (property_get("af.fast_hist_window_ms", value, NULL) > 0) {
+        unsigned long ms = strtoul(value, NULL, 0);
+        if (ms >= kMinHistogramWindowMs && ms <= kMaxHistogramWindowMs) {
+            mHistogramWindowMs = ms;
+        }
+    }
+    for (int w = 0; w < 2; w++) {
+        mHistogramElapsedUs[w] = 0;
+        for (int h = 0; h < HIST_CNT; h++) {
+            mHistograms[w][h].clear();
+        }
+    }
+#endif
 }
 
 FastThreadDumpState::~FastThreadDumpState()
 {
 }
 
+#ifdef FAST_MIXER_STATISTICS
+void FastThreadDumpState::advanceHistogramWindow(uint32_t cycleUs)
+{
+    uint32_t window = mHistogramWindow;
+    mHistogramElapsedUs[window] += cycleUs;
+    if (mHistogramElapsedUs[window] / 1000 >= mHistogramWindowMs) {
+        // the previous window is overwritten while a dump may be copying it, which only
+        // blurs that dump; the window just completed is intact
+        window ^= 1;
+        mHistogramElapsedUs[window] = 0;
+        for (int h = 0; h < HIST_CNT; h++) {
+            mHistograms[window][h].clear();
+        }
+        mHistogramWindow = window;
+    }
+}
+
+void FastThreadDumpState::dumpHistograms(int fd) const
+{
+    static const char * const names[HIST_CNT] = {"cycle", "load", "underrun_gap", "io_blocked"};
+    const uint32_t current = mHistogramWindow;
+    for (uint32_t age = 0; age < 2; age++) {
+        const uint32_t window = current ^ age;
+        for (int h = 0; h < HIST_CNT; h++) {
+            const LogLinearHistogram& hist = mHistograms[window][h];
+            dprintf(fd, "  hist name=%s window=%s ms=%u count=%u"
+                        " p50=%u p90=%u p99=%u p99.9=%u max=%u buckets=",
+                    names[h], age == 0 ? "current" : "previous",
+                    mHistogramElapsedUs[window] / 1000, hist.mCount,
+                    hist.percentile(0.5), hist.percentile(0.9), hist.percentile(0.99),
+                    hist.percentile(0.999), hist.mMax);
+            // sparse "lower_bound_us:count" list of the non-empty buckets
+            bool first = true;
+            for (uint32_t b = 0; b < LogLinearHistogram::kBuckets; b++) {
+                if (hist.mBuckets[b] != 0) {
+                    dprintf(fd, "%s%u:%u", first ? "" : ",", LogLinearHistogram::lowerBound(b),
+                            hist.mBuckets[b]);
+                    first = false;
+                }
+            }
+            dprintf(fd, "\n");
+        }
+    }
+}
+#endif
+
 }   // namespace android
@@ -20,6 +20,7 @@
 #include "Configuration.h"
 #include <stdint.h>
 #include <media/nbaio/NBLog.h>
+#include "LogLinearHistogram.h"
 
 namespace android {
 
@@ -79,6 +80,31 @@ struct FastThreadDumpState {
 #ifdef CPU_FREQUENCY_STATISTICS
     uint32_t mCpukHz[kSamplingN];       // absolute CPU clock frequency in kHz, bits 0-3 are CPU#
 #endif
+
+    // Histograms in microseconds of per-cycle timings, kept over two alternating windows so that
+    // dumpsys always has one complete window. Written by the fast thread only, and read on a copy.
+    enum {
+        HIST_CYCLE,                     // wall clock time per cycle
+        HIST_LOAD,                      // thread CPU time per cycle
+        HIST_UNDERRUN_GAP,              // wall clock time of the cycles that underran
+        HIST_IO_BLOCKED,                // time spent in the HAL write or read
+        HIST_CNT
+    };
+    void sampleHistogram(int which, uint32_t us) {
+        mHistograms[mHistogramWindow][which].sample(us);
+    }
+    // accounts for one cycle of cycleUs, and starts a new window when the current one is full
+    void advanceHistogramWindow(uint32_t cycleUs);
+    // one line per window and histogram, as "key=value" pairs for tools
+    void dumpHistograms(int fd) const;
+
+    static const uint32_t kDefaultHistogramWindowMs = 10000;
+    static const uint32_t kMinHistogramWindowMs = 100;
+    static const uint32_t kMaxHistogramWindowMs = 3600000;
+    uint32_t mHistogramWindowMs;        // window duration, from property af.fast_hist_window_ms
+    uint32_t mHistogramWindow;          // index of the current window, the other one is previous
+    uint32_t mHistogramElapsedUs[2];    // duration covered by each window
+    LogLinearHistogram mHistograms[2][HIST_CNT];
 #endif
 
 };  // struct FastThreadDumpState
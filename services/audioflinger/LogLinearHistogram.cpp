@@ -0,0 +1,81 @@
+/*
+ * Copyright (C) 2015 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <string.h>
+#include "LogLinearHistogram.h"
+
+namespace android {
+
+void LogLinearHistogram::clear()
+{
+    mCount = 0;
+    mMax = 0;
+    memset(mBuckets, 0, sizeof(mBuckets));
+}
+
+void LogLinearHistogram::sample(uint32_t us)
+{
+    uint32_t bucket;
+    if (us < kLinearBuckets) {
+        bucket = us;
+    } else {
+        // position of the most significant bit, >= kLinearShift
+        const uint32_t msb = 31 - __builtin_clz(us);
+        const uint32_t sub = (us >> (msb - kSubShift)) & (kSubBuckets - 1);
+        bucket = kLinearBuckets + ((msb - kLinearShift) << kSubShift) + sub;
+    }
+    mBuckets[bucket]++;
+    mCount++;
+    if (us > mMax) {
+        mMax = us;
+    }
+}
+
+/*static*/
+uint32_t LogLinearHistogram::lowerBound(uint32_t bucket)
+{
+    if (bucket < kLinearBuckets) {
+        return bucket;
+    }
+    const uint32_t msb = ((bucket - kLinearBuckets) >> kSubShift) + kLinearShift;
+    const uint32_t sub = (bucket - kLinearBuckets) & (kSubBuckets - 1);
+    return (1u << msb) + (sub << (msb - kSubShift));
+}
+
+uint32_t LogLinearHistogram::percentile(double fraction) const
+{
+    // recount rather than trust mCount, which may be inconsistent in a copy
+    uint64_t count = 0;
+    for (uint32_t i = 0; i < kBuckets; i++) {
+        count += mBuckets[i];
+    }
+    if (count == 0) {
+        return 0;
+    }
+    const uint64_t rank = (uint64_t) (fraction * count);
+    uint64_t below = 0;
+    for (uint32_t i = 0; i < kBuckets; i++) {
+        below += mBuckets[i];
+        if (below > rank) {
+            uint32_t upper = i + 1 < kBuckets ? lowerBound(i + 1) - 1 : 0xFFFFFFFF;
+            // the maximum is exact
+            return upper < mMax ? upper : mMax;
+        }
+    }
+    return mMax;
+}
+
+}   // namespace android
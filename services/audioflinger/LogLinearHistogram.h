@@ -0,0 +1,52 @@
+/*
+ * Copyright (C) 2015 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef ANDROID_AUDIO_LOG_LINEAR_HISTOGRAM_H
+#define ANDROID_AUDIO_LOG_LINEAR_HISTOGRAM_H
+
+#include <stdint.h>
+
+namespace android {
+
+// Histogram of microsecond values with a bounded relative error, suited to latency tails.
+// Values below kLinearBuckets us have a bucket each, and each power of 2 above that is split into
+// kSubBuckets linear sub-buckets, so a bucket is never wider than 1/8 of its lower bound.
+// There is a single writer and no lock: a reader works on a copy, and must tolerate a count
+// that is inconsistent with the buckets. Only POD types, as it is part of the dump states.
+struct LogLinearHistogram {
+    static const uint32_t kLinearShift = 4;     // log2(kLinearBuckets)
+    static const uint32_t kSubShift = 3;        // log2(kSubBuckets)
+    static const uint32_t kLinearBuckets = 1u << kLinearShift;
+    static const uint32_t kSubBuckets = 1u << kSubShift;    // per power of 2
+    static const uint32_t kBuckets = kLinearBuckets + (32 - kLinearShift) * kSubBuckets;
+
+    void        clear();
+    void        sample(uint32_t us);
+
+    // lower bound in us of the values counted in the bucket
+    static uint32_t lowerBound(uint32_t bucket);
+    // estimate of the value below which 'fraction' of the samples fall, as the upper bound
+    // of the bucket holding that sample, or 0 if there are no samples
+    uint32_t    percentile(double fraction) const;
+
+    uint32_t    mCount;
+    uint32_t    mMax;
+    uint32_t    mBuckets[kBuckets];
+};
+
+}   // namespace android
+
+#endif  // ANDROID_AUDIO_LOG_LINEAR_HISTOGRAM_H
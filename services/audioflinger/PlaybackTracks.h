@@ -66,6 +66,8 @@ public:
             int         auxEffectId() const { return mAuxEffectId; }
     virtual status_t    getTimestamp(AudioTimestamp& timestamp);
             void        signal();
+            status_t    setStartTime(int64_t presentationTimeNs);
+            status_t    setStopTime(int64_t presentationTimeNs);
 
 // implement FastMixerState::VolumeProvider interface
     virtual gain_minifloat_packed_t getVolumeLR();
@@ -85,7 +87,7 @@ protected:
     // AudioBufferProvider interface
     virtual status_t getNextBuffer(AudioBufferProvider::Buffer* buffer,
                                    int64_t pts = kInvalidPTS);
-    // releaseBuffer() not overridden
+    virtual void releaseBuffer(AudioBufferProvider::Buffer* buffer);
 
     // ExtendedAudioBufferProvider interface
     virtual size_t framesReady() const;
@@ -109,6 +111,18 @@ protected:
     // FIXME parameters not needed, could get them from the thread
     bool presentationComplete(size_t framesWritten, size_t audioHalFrames);
 
+    // Convert the scheduled start and stop times into frame counts for the mix period whose
+    // first frame will be presented at nextPresentationNs. Normal mixer thread only.
+    void applyScheduledTimes_l(int64_t nextPresentationNs, uint32_t sinkSampleRate,
+                               size_t sinkFrameCount);
+    bool hasScheduledTimes() const { return mStartTimeNs != 0 || mStopTimeNs != 0; }
+    // apply the resets of the frame counts requested by setStartTime(), setStopTime() and
+    // flush() since the previous mix period
+    void resetScheduledFrames_l();
+    bool isScheduledStopReached() const { return mFramesUntilStop == 0; }
+    // discard the frames queued after a scheduled stop and stop the track
+    void completeScheduledStop_l();
+
 public:
     void triggerEvents(AudioSystem::sync_event_t type);
     void invalidate();
@@ -160,6 +174,20 @@ private:
     bool                mPreviousValid;
     uint32_t            mPreviousFramesWritten;
     AudioTimestamp      mPreviousTimestamp;
+
+    // scheduled start and stop, see setStartTime() and setStopTime()
+    static const size_t kSilenceFrames = 256;  // size of mSilenceBuffer
+    int64_t             mStartTimeNs;       // 0 means none or already applied
+    int64_t             mStopTimeNs;        // 0 means none or already applied
+    // The frame counts are only written by the mixer thread: getNextBuffer() and releaseBuffer()
+    // run without the thread lock, so other threads request a reset under the lock instead.
+    size_t              mSilenceFrames;     // frames of silence to provide before the first frame
+    size_t              mTrimFrames;        // frames to discard before the first frame
+    ssize_t             mFramesUntilStop;   // frames left to provide before stopping, -1 if none
+    bool                mResetStartFrames;  // reset mSilenceFrames and mTrimFrames
+    bool                mResetStopFrames;   // reset mFramesUntilStop
+    bool                mScheduledStopDone; // stopped at its stop time, not ready until started
+    void*               mSilenceBuffer;     // kSilenceFrames of silence, allocated on demand
 };  // end of Track
 
 class TimedTrack : public Track {
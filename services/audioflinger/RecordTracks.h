@@ -66,21 +66,17 @@ private:
 
     bool                mOverflow;  // overflow on most recent attempt to fill client buffer
 
-           // updated by RecordThread::readInputParameters_l()
-            AudioResampler                      *mResampler;
-
-            // interleaved stereo pairs of fixed-point Q4.27
-            int32_t                             *mRsmpOutBuffer;
-            // current allocated frame count for the above, which may be larger than needed
-            size_t                              mRsmpOutFrameCount;
-
-            size_t                              mRsmpInUnrel;   // unreleased frames remaining from
-                                                                // most recent getNextBuffer
-                                                                // for debug only
+            // group resampling the HAL input to the track sample rate, or NULL if the track
+            // reads mRsmpInBuffer directly; updated by RecordThread::threadLoop() on each cycle
+            ResampleGroup                       *mResampleGroup;
 
             // rolling counter that is never cleared
             int32_t                             mRsmpInFront;   // next available frame
 
+            // rolling counter that is never cleared
+            int32_t                             mRsmpOutFront;  // next available frame of
+                                                                // mResampleGroup output
+
             AudioBufferProvider::Buffer mSink;  // references client's buffer sink in shared memory
 
             // sync event triggering actual audio capture. Frames read before this event will
@@ -92,8 +88,8 @@ private:
             // not received
             ssize_t                             mFramesToDrop;
 
-            // used by resampler to find source frames
-            ResamplerBufferProvider *mResamplerBufferProvider;
+            // index within FastCaptureState::mCblks[] if isFastTrack(), otherwise -1
+            int                                 mFastIndex;
 };
 
 // playback track, used by PatchPanel
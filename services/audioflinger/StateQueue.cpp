@@ -33,8 +33,8 @@ void StateQueueObserverDump::dump(int fd)
 
 void StateQueueMutatorDump::dump(int fd)
 {
-    dprintf(fd, "State queue mutator: pushDirty=%u pushAck=%u blockedSequence=%u\n",
-            mPushDirty, mPushAck, mBlockedSequence);
+    dprintf(fd, "State queue mutator: pushDirty=%u pushAck=%u pushDeferred=%u blockedSequence=%u\n",
+            mPushDirty, mPushAck, mPushDeferred, mBlockedSequence);
 }
 #endif
 
@@ -124,6 +124,9 @@ template<typename T> bool StateQueue<T>::push(StateQueue<T>::block_t block)
                     break;
                 }
                 if (block == BLOCK_NEVER) {
+#ifdef STATE_QUEUE_DUMP
+                    mMutatorDump->mPushDeferred++;
+#endif
                     return false;
                 }
 #ifdef STATE_QUEUE_DUMP
@@ -61,7 +61,10 @@
 // and the mutator were to run more frequently than the observer.
 // In this case, the mutator could get blocked waiting for a slot to fill up for
 // it to work with. This could be solved somewhat by increasing the depth of the queue, but it would
-// still limit the mutator to a finite number of changes before it would block.  A future
+// still limit the mutator to a finite number of changes before it would block.
+// Instead a mutator that must not block can push with BLOCK_NEVER: a state that could not be
+// pushed stays dirty, the next mutations are done in place on it, and all of them are published
+// together by the next successful push().  A future
 // possibility, not implemented here, would be to allow the mutator to safely overwrite an already
 // pushed state. This could be done by the mutator overwriting mNext, but then being prepared to
 // read an mAck which is actually for the earlier mNext (since there is a race).
@@ -112,9 +115,11 @@ struct StateQueueObserverDump {
 };
 
 struct StateQueueMutatorDump {
-    StateQueueMutatorDump() : mPushDirty(0), mPushAck(0), mBlockedSequence(0) { }
+    StateQueueMutatorDump() : mPushDirty(0), mPushDeferred(0), mPushAck(0), mBlockedSequence(0)
+            { }
     /*virtual*/ ~StateQueueMutatorDump() { }
     unsigned    mPushDirty;       // incremented each time push() is called with a dirty state
+    unsigned    mPushDeferred;    // incremented each time push(BLOCK_NEVER) leaves the state dirty
     unsigned    mPushAck;         // incremented each time push(BLOCK_UNTIL_ACKED) is called
     unsigned    mBlockedSequence; // incremented before and after each time that push()
                                   // blocks for more than one PUSH_BLOCK_ACK_NS;
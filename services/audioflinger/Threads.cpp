@@ -64,6 +64,8 @@
 #include <media/IMediaDeathNotifier.h>
 #endif
 
+#include <cpustats/ThreadCpuRegistry.h>
+
 #ifdef DEBUG_CPU_USAGE
 #include <cpustats/CentralTendencyStatistics.h>
 #include <cpustats/ThreadCpuUsage.h>
@@ -345,6 +347,7 @@ AudioFlinger::ThreadBase::~ThreadBase()
 
 status_t AudioFlinger::ThreadBase::readyToRun()
 {
+    ThreadCpuRegistry::registerThread("audioflinger");
     status_t status = initCheck();
     if (status == NO_ERROR) {
         ALOGI("AudioFlinger's thread %p ready to run", this);
@@ -1567,6 +1570,22 @@ uint32_t AudioFlinger::PlaybackThread::latency_l() const
     }
 }
 
+int64_t AudioFlinger::PlaybackThread::nextPresentationTimeNs_l() const
+{
+    // the next mix period is presented after the frames already written to the sink
+    const int64_t now = systemTime();
+    if (mLatchQValid && mSampleRate != 0) {
+        const int64_t time = mLatchQ.mTimestamp.mTime.tv_sec * 1000000000LL +
+                mLatchQ.mTimestamp.mTime.tv_nsec +
+                ((int64_t) mLatchQ.mUnpresentedFrames * 1000000000LL) / mSampleRate;
+        // the latch is stale after standby
+        if (time >= now) {
+            return time;
+        }
+    }
+    return now + (int64_t) latency_l() * 1000000LL;
+}
+
 void AudioFlinger::PlaybackThread::setMasterVolume(float value)
 {
     Mutex::Autolock _l(mLock);
@@ -2653,6 +2672,7 @@ bool AudioFlinger::PlaybackThread::threadLoop()
     mWakeLockUids.clear();
     mActiveTracksGeneration++;
 
+    ThreadCpuRegistry::unregisterThread();
     ALOGV("Thread %p type %d exiting", this, mType);
     return false;
 }
@@ -3178,7 +3198,10 @@ AudioFlinger::PlaybackThread::mixer_state AudioFlinger::MixerThread::prepareTrac
     FastMixerStateQueue *sq = NULL;
     FastMixerState *state = NULL;
     bool didModify = false;
-    FastMixerStateQueue::block_t block = FastMixerStateQueue::BLOCK_UNTIL_PUSHED;
+    // Added tracks and other changes that don't need an acknowledgement must not make the normal
+    // mixer wait for the fast mixer: if the previous state has not been taken yet, this state stays
+    // dirty and is coalesced with the changes of the next cycle, which will push it again.
+    FastMixerStateQueue::block_t block = FastMixerStateQueue::BLOCK_NEVER;
     if (mFastMixer != 0) {
         sq = mFastMixer->sq();
         state = sq->begin();
@@ -3196,6 +3219,9 @@ AudioFlinger::PlaybackThread::mixer_state AudioFlinger::MixerThread::prepareTrac
         // this const just means the local variable doesn't change
         Track* const track = t.get();
 
+        // apply the parameters batched by the client at this mix period boundary
+        track->mAudioTrackServerProxy->pollParameters();
+
         // process fast tracks
         if (track->isFastTrack()) {
 
@@ -3350,6 +3376,13 @@ AudioFlinger::PlaybackThread::mixer_state AudioFlinger::MixerThread::prepareTrac
 
         audio_track_cblk_t* cblk = track->cblk();
 
+        track->resetScheduledFrames_l();
+
+        // a scheduled stop was reached during the previous mix period
+        if (track->isScheduledStopReached()) {
+            track->completeScheduledStop_l();
+        }
+
         // The first time a track is added we wait
         // for all its buffers to be filled before processing it
         int name = track->name();
@@ -3408,6 +3441,10 @@ AudioFlinger::PlaybackThread::mixer_state AudioFlinger::MixerThread::prepareTrac
                 }
             }
 
+            if (track->hasScheduledTimes()) {
+                track->applyScheduledTimes_l(nextPresentationTimeNs_l(), mSampleRate,
+                        mNormalFrameCount);
+            }
 
             int param = AudioMixer::VOLUME;
             if (track->mFillingUpStatus == Track::FS_FILLED) {
@@ -3992,6 +4029,7 @@ AudioFlinger::PlaybackThread::mixer_state AudioFlinger::DirectOutputThread::prep
         }
 
         Track* const track = t.get();
+        track->mAudioTrackServerProxy->pollParameters();
         audio_track_cblk_t* cblk = track->cblk();
         // Only consider last track started for volume and mixer state control.
         // In theory an older track could underrun and restart after the new one starts
@@ -4389,6 +4427,7 @@ AudioFlinger::PlaybackThread::mixer_state AudioFlinger::OffloadThread::prepareTr
             continue;
         }
         Track* const track = t.get();
+        track->mAudioTrackServerProxy->pollParameters();
         audio_track_cblk_t* cblk = track->cblk();
         // Only consider last track started for volume and mixer state control.
         // In theory an older track could underrun and restart after the new one starts
@@ -4847,7 +4886,7 @@ AudioFlinger::RecordThread::RecordThread(const sp<AudioFlinger>& audioFlinger,
     , mPipeFramesP2(0)
     // mPipeMemory
     // mFastCaptureNBLogWriter
-    , mFastTrackAvail(false)
+    , mFastTrackAvailMask(0)
 {
     snprintf(mName, kNameLength, "AudioIn_%X", id);
     mNBLogWriter = audioFlinger->newWriter_l(kLogSize, mName);
@@ -4926,7 +4965,6 @@ AudioFlinger::RecordThread::RecordThread(const sp<AudioFlinger>& audioFlinger,
         // FIXME
 #endif
         FastCaptureState *state = sq->begin();
-        state->mCblk = NULL;
         state->mInputSource = mInputSource.get();
         state->mInputSourceGen++;
         state->mPipeSink = pipe;
@@ -4959,7 +4997,7 @@ AudioFlinger::RecordThread::RecordThread(const sp<AudioFlinger>& audioFlinger,
         // FIXME
 #endif
 
-        mFastTrackAvail = true;
+        mFastTrackAvailMask = (1 << FastCaptureState::kMaxFastTracks) - 1;
     }
 failed: ;
 
@@ -4986,6 +5024,7 @@ AudioFlinger::RecordThread::~RecordThread()
     }
     mAudioFlinger->unregisterWriter(mFastCaptureNBLogWriter);
     mAudioFlinger->unregisterWriter(mNBLogWriter);
+    clearResampleGroups_l();
     delete[] mRsmpInBuffer;
 }
 
@@ -5026,6 +5065,9 @@ reacquire_wakelock:
     // used to request a deferred sleep, to be executed later while mutex is unlocked
     uint32_t sleepUs = 0;
 
+    // identifies the loop cycles using each resample group
+    uint32_t cycle = 0;
+
     // loop while there is work to do
     for (;;) {
         Vector< sp<EffectChain> > effectChains;
@@ -5039,11 +5081,12 @@ reacquire_wakelock:
         // activeTracks accumulates a copy of a subset of mActiveTracks
         Vector< sp<RecordTrack> > activeTracks;
 
-        // reference to the (first and only) active fast track
-        sp<RecordTrack> fastTrack;
+        // control blocks of the active fast tracks, indexed like FastCaptureState::mCblks[]
+        audio_track_cblk_t *fastCblks[FastCaptureState::kMaxFastTracks];
+        memset(fastCblks, 0, sizeof(fastCblks));
 
-        // reference to a fast track which is about to be removed
-        sp<RecordTrack> fastTrackToRemove;
+        // references to the fast tracks which are about to be removed
+        Vector< sp<RecordTrack> > fastTracksToRemove;
 
         { // scope for mLock
             Mutex::Autolock _l(mLock);
@@ -5079,13 +5122,13 @@ reacquire_wakelock:
             }
 
             bool doBroadcast = false;
+            cycle++;
             for (size_t i = 0; i < size; ) {
 
                 activeTrack = mActiveTracks[i];
                 if (activeTrack->isTerminated()) {
                     if (activeTrack->isFastTrack()) {
-                        ALOG_ASSERT(fastTrackToRemove == 0);
-                        fastTrackToRemove = activeTrack;
+                        fastTracksToRemove.add(activeTrack);
                     }
                     removeTrack_l(activeTrack);
                     mActiveTracks.remove(activeTrack);
@@ -5130,9 +5173,22 @@ reacquire_wakelock:
                 i++;
 
                 if (activeTrack->isFastTrack()) {
-                    ALOG_ASSERT(!mFastTrackAvail);
-                    ALOG_ASSERT(fastTrack == 0);
-                    fastTrack = activeTrack;
+                    const int fastIndex = activeTrack->mFastIndex;
+                    ALOG_ASSERT(!(mFastTrackAvailMask & (1 << fastIndex)));
+                    ALOG_ASSERT(fastCblks[fastIndex] == NULL);
+                    fastCblks[fastIndex] = activeTrack->cblk();
+                } else if (activeTrack->mSampleRate != mSampleRate &&
+                        mChannelCount <= FCC_2 && activeTrack->mChannelCount <= FCC_2) {
+                    // FIXME I don't understand either of the channel count checks
+                    ResampleGroup *group = getResampleGroup_l(activeTrack->mSampleRate, cycle);
+                    if (activeTrackState == TrackBase::STARTING_2 ||
+                            activeTrack->mResampleGroup != group) {
+                        // like mRsmpInFront, a started track discards all buffered data
+                        activeTrack->mRsmpOutFront = group->rear();
+                    }
+                    activeTrack->mResampleGroup = group;
+                } else {
+                    activeTrack->mResampleGroup = NULL;
                 }
             }
             if (doBroadcast) {
@@ -5164,7 +5220,8 @@ reacquire_wakelock:
             FastCaptureStateQueue *sq = mFastCapture->sq();
             FastCaptureState *state = sq->begin();
             bool didModify = false;
-            FastCaptureStateQueue::block_t block = FastCaptureStateQueue::BLOCK_UNTIL_PUSHED;
+            // as for the fast mixer, a state that can't be pushed yet is retried on the next cycle
+            FastCaptureStateQueue::block_t block = FastCaptureStateQueue::BLOCK_NEVER;
             if (state->mCommand != FastCaptureState::READ_WRITE /* FIXME &&
                     (kUseFastMixer != FastMixer_Dynamic || state->mTrackMask > 1)*/) {
                 if (state->mCommand == FastCaptureState::COLD_IDLE) {
@@ -5180,18 +5237,20 @@ reacquire_wakelock:
 #endif
                 didModify = true;
             }
-            audio_track_cblk_t *cblkOld = state->mCblk;
-            audio_track_cblk_t *cblkNew = fastTrack != 0 ? fastTrack->cblk() : NULL;
-            if (cblkNew != cblkOld) {
-                state->mCblk = cblkNew;
-                // block until acked if removing a fast track
-                if (cblkOld != NULL) {
-                    block = FastCaptureStateQueue::BLOCK_UNTIL_ACKED;
+            for (unsigned i = 0; i < FastCaptureState::kMaxFastTracks; i++) {
+                audio_track_cblk_t *cblkOld = state->mCblks[i];
+                audio_track_cblk_t *cblkNew = fastCblks[i];
+                if (cblkNew != cblkOld) {
+                    state->mCblks[i] = cblkNew;
+                    // block until acked if removing a fast track
+                    if (cblkOld != NULL) {
+                        block = FastCaptureStateQueue::BLOCK_UNTIL_ACKED;
+                    }
+                    didModify = true;
                 }
-                didModify = true;
             }
             sq->end(didModify);
-            if (didModify) {
+            if (sq->isDirty()) {
                 sq->push(block);
 #if 0
                 if (kUseFastCapture == FastCapture_Dynamic) {
@@ -5201,8 +5260,8 @@ reacquire_wakelock:
             }
         }
 
-        // now run the fast track destructor with thread mutex unlocked
-        fastTrackToRemove.clear();
+        // now run the fast track destructors with thread mutex unlocked
+        fastTracksToRemove.clear();
 
         // Read from HAL to keep up with fastest client if multiple active tracks, not slowest one.
         // Only the client(s) that are too slow will overrun. But if even the fastest client is too
@@ -5257,6 +5316,15 @@ reacquire_wakelock:
         }
         rear = mRsmpInRear += framesRead;
 
+        // resample once for all the tracks at each client sample rate
+        size = mResampleGroups.size();
+        for (size_t i = 0; i < size; i++) {
+            ResampleGroup *group = mResampleGroups.valueAt(i);
+            if (group->isUsedBy(cycle)) {
+                group->resample();
+            }
+        }
+
         size = activeTracks.size();
         // loop over each active track
         for (size_t i = 0; i < size; i++) {
@@ -5281,21 +5349,47 @@ reacquire_wakelock:
                 size_t framesOut = activeTrack->mSink.frameCount;
                 LOG_ALWAYS_FATAL_IF((status == OK) != (framesOut > 0));
 
-                int32_t front = activeTrack->mRsmpInFront;
-                ssize_t filled = rear - front;
+                // tracks at the HAL rate read the HAL input directly, the others read the
+                // output of the resample group shared by all tracks at the same rate
+                ResampleGroup *group = activeTrack->mResampleGroup;
+                int32_t *pFront;
+                int32_t srcRear;
+                const int16_t *srcBuffer;
+                size_t srcFramesP2;
+                size_t srcFrames;
+                uint32_t srcChannelCount;
+                if (group == NULL) {
+                    pFront = &activeTrack->mRsmpInFront;
+                    srcRear = rear;
+                    srcBuffer = mRsmpInBuffer;
+                    srcFramesP2 = mRsmpInFramesP2;
+                    srcFrames = mRsmpInFrames;
+                    srcChannelCount = mChannelCount;
+                } else {
+                    pFront = &activeTrack->mRsmpOutFront;
+                    srcRear = group->rear();
+                    srcBuffer = group->buffer();
+                    srcFramesP2 = group->framesP2();
+                    srcFrames = srcFramesP2;
+                    // the resampler always outputs stereo
+                    srcChannelCount = FCC_2;
+                }
+
+                int32_t front = *pFront;
+                ssize_t filled = srcRear - front;
                 size_t framesIn;
 
                 if (filled < 0) {
                     // should not happen, but treat like a massive overrun and re-sync
                     framesIn = 0;
-                    activeTrack->mRsmpInFront = rear;
+                    *pFront = srcRear;
                     overrun = OVERRUN_TRUE;
-                } else if ((size_t) filled <= mRsmpInFrames) {
+                } else if ((size_t) filled <= srcFrames) {
                     framesIn = (size_t) filled;
                 } else {
                     // client is not keeping up with server, but give it latest data
-                    framesIn = mRsmpInFrames;
-                    activeTrack->mRsmpInFront = front = rear - framesIn;
+                    framesIn = srcFrames;
+                    *pFront = front = srcRear - framesIn;
                     overrun = OVERRUN_TRUE;
                 }
 
@@ -5303,109 +5397,32 @@ reacquire_wakelock:
                     break;
                 }
 
-                if (activeTrack->mResampler == NULL) {
-                    // no resampling
-                    if (framesIn > framesOut) {
-                        framesIn = framesOut;
-                    } else {
-                        framesOut = framesIn;
-                    }
-                    int8_t *dst = activeTrack->mSink.i8;
-                    while (framesIn > 0) {
-                        front &= mRsmpInFramesP2 - 1;
-                        size_t part1 = mRsmpInFramesP2 - front;
-                        if (part1 > framesIn) {
-                            part1 = framesIn;
-                        }
-                        int8_t *src = (int8_t *)mRsmpInBuffer + (front * mFrameSize);
-                        if (mChannelCount == activeTrack->mChannelCount) {
-                            memcpy(dst, src, part1 * mFrameSize);
-                        } else if (mChannelCount == 1) {
-                            upmix_to_stereo_i16_from_mono_i16((int16_t *)dst, (const int16_t *)src,
-                                    part1);
-                        } else {
-                            downmix_to_mono_i16_from_stereo_i16((int16_t *)dst, (const int16_t *)src,
-                                    part1);
-                        }
-                        dst += part1 * activeTrack->mFrameSize;
-                        front += part1;
-                        framesIn -= part1;
-                    }
-                    activeTrack->mRsmpInFront += framesOut;
-
+                if (framesIn > framesOut) {
+                    framesIn = framesOut;
                 } else {
-                    // resampling
-                    // FIXME framesInNeeded should really be part of resampler API, and should
-                    //       depend on the SRC ratio
-                    //       to keep mRsmpInBuffer full so resampler always has sufficient input
-                    size_t framesInNeeded;
-                    // FIXME only re-calculate when it changes, and optimize for common ratios
-                    // Do not precompute in/out because floating point is not associative
-                    // e.g. a*b/c != a*(b/c).
-                    const double in(mSampleRate);
-                    const double out(activeTrack->mSampleRate);
-                    framesInNeeded = ceil(framesOut * in / out) + 1;
-                    ALOGV("need %u frames in to produce %u out given in/out ratio of %.4g",
-                                framesInNeeded, framesOut, in / out);
-                    // Although we theoretically have framesIn in circular buffer, some of those are
-                    // unreleased frames, and thus must be discounted for purpose of budgeting.
-                    size_t unreleased = activeTrack->mRsmpInUnrel;
-                    framesIn = framesIn > unreleased ? framesIn - unreleased : 0;
-                    if (framesIn < framesInNeeded) {
-                        ALOGV("not enough to resample: have %u frames in but need %u in to "
-                                "produce %u out given in/out ratio of %.4g",
-                                framesIn, framesInNeeded, framesOut, in / out);
-                        size_t newFramesOut = framesIn > 0 ? floor((framesIn - 1) * out / in) : 0;
-                        LOG_ALWAYS_FATAL_IF(newFramesOut >= framesOut);
-                        if (newFramesOut == 0) {
-                            break;
-                        }
-                        framesInNeeded = ceil(newFramesOut * in / out) + 1;
-                        ALOGV("now need %u frames in to produce %u out given out/in ratio of %.4g",
-                                framesInNeeded, newFramesOut, out / in);
-                        LOG_ALWAYS_FATAL_IF(framesIn < framesInNeeded);
-                        ALOGV("success 2: have %u frames in and need %u in to produce %u out "
-                              "given in/out ratio of %.4g",
-                              framesIn, framesInNeeded, newFramesOut, in / out);
-                        framesOut = newFramesOut;
-                    } else {
-                        ALOGV("success 1: have %u in and need %u in to produce %u out "
-                            "given in/out ratio of %.4g",
-                            framesIn, framesInNeeded, framesOut, in / out);
-                    }
-
-                    // reallocate mRsmpOutBuffer as needed; we will grow but never shrink
-                    if (activeTrack->mRsmpOutFrameCount < framesOut) {
-                        // FIXME why does each track need it's own mRsmpOutBuffer? can't they share?
-                        delete[] activeTrack->mRsmpOutBuffer;
-                        // resampler always outputs stereo
-                        activeTrack->mRsmpOutBuffer = new int32_t[framesOut * FCC_2];
-                        activeTrack->mRsmpOutFrameCount = framesOut;
+                    framesOut = framesIn;
+                }
+                const size_t srcFrameSize = srcChannelCount * sizeof(int16_t);
+                int8_t *dst = activeTrack->mSink.i8;
+                while (framesIn > 0) {
+                    front &= srcFramesP2 - 1;
+                    size_t part1 = srcFramesP2 - front;
+                    if (part1 > framesIn) {
+                        part1 = framesIn;
                     }
-
-                    // resampler accumulates, but we only have one source track
-                    memset(activeTrack->mRsmpOutBuffer, 0, framesOut * FCC_2 * sizeof(int32_t));
-                    activeTrack->mResampler->resample(activeTrack->mRsmpOutBuffer, framesOut,
-                            // FIXME how about having activeTrack implement this interface itself?
-                            activeTrack->mResamplerBufferProvider
-                            /*this*/ /* AudioBufferProvider* */);
-                    // ditherAndClamp() works as long as all buffers returned by
-                    // activeTrack->getNextBuffer() are 32 bit aligned which should be always true.
-                    if (activeTrack->mChannelCount == 1) {
-                        // temporarily type pun mRsmpOutBuffer from Q4.27 to int16_t
-                        ditherAndClamp(activeTrack->mRsmpOutBuffer, activeTrack->mRsmpOutBuffer,
-                                framesOut);
-                        // the resampler always outputs stereo samples:
-                        // do post stereo to mono conversion
-                        downmix_to_mono_i16_from_stereo_i16(activeTrack->mSink.i16,
-                                (const int16_t *)activeTrack->mRsmpOutBuffer, framesOut);
+                    const int16_t *src = srcBuffer + front * srcChannelCount;
+                    if (srcChannelCount == activeTrack->mChannelCount) {
+                        memcpy(dst, src, part1 * srcFrameSize);
+                    } else if (srcChannelCount == 1) {
+                        upmix_to_stereo_i16_from_mono_i16((int16_t *)dst, src, part1);
                     } else {
-                        ditherAndClamp((int32_t *)activeTrack->mSink.raw,
-                                activeTrack->mRsmpOutBuffer, framesOut);
+                        downmix_to_mono_i16_from_stereo_i16((int16_t *)dst, src, part1);
                     }
-                    // now done with mRsmpOutBuffer
-
+                    dst += part1 * activeTrack->mFrameSize;
+                    front += part1;
+                    framesIn -= part1;
                 }
+                *pFront += framesOut;
 
                 if (framesOut > 0 && (overrun == OVERRUN_UNKNOWN)) {
                     overrun = OVERRUN_FALSE;
@@ -5484,6 +5501,7 @@ unlock:
 
     releaseWakeLock();
 
+    ThreadCpuRegistry::unregisterThread();
     ALOGV("RecordThread %p exiting", this);
     return false;
 }
@@ -5561,17 +5579,17 @@ sp<AudioFlinger::RecordThread::RecordTrack> AudioFlinger::RecordThread::createRe
             // record thread has an associated fast capture
             hasFastCapture() &&
             // there are sufficient fast track slots available
-            mFastTrackAvail
+            (mFastTrackAvailMask != 0)
         ) {
         ALOGV("AUDIO_INPUT_FLAG_FAST accepted: frameCount=%u mFrameCount=%u",
                 frameCount, mFrameCount);
       } else {
         ALOGV("AUDIO_INPUT_FLAG_FAST denied: frameCount=%u mFrameCount=%u mPipeFramesP2=%u "
                 "format=%#x isLinear=%d channelMask=%#x sampleRate=%u mSampleRate=%u "
-                "hasFastCapture=%d tid=%d mFastTrackAvail=%d",
+                "hasFastCapture=%d tid=%d mFastTrackAvailMask=%#x",
                 frameCount, mFrameCount, mPipeFramesP2,
                 format, audio_is_linear_pcm(format), channelMask, sampleRate, mSampleRate,
-                hasFastCapture(), tid, mFastTrackAvail);
+                hasFastCapture(), tid, mFastTrackAvailMask);
         *flags &= ~IAudioFlinger::TRACK_FAST;
       }
     }
@@ -5714,11 +5732,6 @@ status_t AudioFlinger::RecordThread::start(RecordThread::RecordTrack* recordTrac
         // see previously buffered data before it called start(), but with greater risk of overrun.
 
         recordTrack->mRsmpInFront = mRsmpInRear;
-        recordTrack->mRsmpInUnrel = 0;
-        // FIXME why reset?
-        if (recordTrack->mResampler != NULL) {
-            recordTrack->mResampler->reset();
-        }
         recordTrack->mState = TrackBase::STARTING_2;
         // signal thread to start
         mWaitWorkCV.broadcast();
@@ -5820,8 +5833,9 @@ void AudioFlinger::RecordThread::removeTrack_l(const sp<RecordTrack>& track)
     mTracks.remove(track);
     // need anything related to effects here?
     if (track->isFastTrack()) {
-        ALOG_ASSERT(!mFastTrackAvail);
-        mFastTrackAvail = true;
+        const int index = track->mFastIndex;
+        ALOG_ASSERT(!(mFastTrackAvailMask & (1 << index)));
+        mFastTrackAvailMask |= 1 << index;
     }
 }
 
@@ -5842,7 +5856,14 @@ void AudioFlinger::RecordThread::dumpInternals(int fd, const Vector<String16>& a
         dprintf(fd, "  No active record clients\n");
     }
     dprintf(fd, "  Fast capture thread: %s\n", hasFastCapture() ? "yes" : "no");
-    dprintf(fd, "  Fast track available: %s\n", mFastTrackAvail ? "yes" : "no");
+    dprintf(fd, "  Fast track availMask=%#x\n", mFastTrackAvailMask);
+#ifdef FAST_MIXER_STATISTICS
+    if (hasFastCapture()) {
+        // Make a non-atomic copy of fast capture dump state so it won't change underneath us
+        const FastCaptureDumpState copy(mFastCaptureDumpState);
+        copy.dumpHistograms(fd);
+    }
+#endif
 
     dumpBase(fd, args);
 }
@@ -5892,23 +5913,100 @@ void AudioFlinger::RecordThread::dumpTracks(int fd, const Vector<String16>& args
     write(fd, result.string(), result.size());
 }
 
+AudioFlinger::RecordThread::ResampleGroup::ResampleGroup(RecordThread *thread,
+        uint32_t sampleRate)
+    :   mThread(thread), mSampleRate(sampleRate), mResampler(NULL),
+        mRsmpInFront(thread->mRsmpInRear), mRsmpInUnrel(0), mBuffer(NULL), mFramesP2(0),
+        mRear(0), mRsmpOutBuffer(NULL), mRsmpOutFrameCount(0), mCycle(0)
+{
+    // sink SR
+    mResampler = AudioResampler::create(AUDIO_FORMAT_PCM_16_BIT, thread->mChannelCount,
+            sampleRate);
+    // source SR
+    mResampler->setSampleRate(thread->mSampleRate);
+    mResampler->setVolume(AudioMixer::UNITY_GAIN_FLOAT, AudioMixer::UNITY_GAIN_FLOAT);
+
+    // keep as much output history as the thread keeps input history
+    const double in(thread->mSampleRate);
+    const double out(sampleRate);
+    mFramesP2 = roundup((size_t) ceil(thread->mRsmpInFrames * out / in));
+    mBuffer = new int16_t[mFramesP2 * FCC_2];
+    // one HAL buffer is converted per resampler call
+    mRsmpOutFrameCount = (size_t) ceil(thread->mFrameCount * out / in) + 1;
+    mRsmpOutBuffer = new int32_t[mRsmpOutFrameCount * FCC_2];
+}
+
+AudioFlinger::RecordThread::ResampleGroup::~ResampleGroup()
+{
+    delete mResampler;
+    delete[] mBuffer;
+    delete[] mRsmpOutBuffer;
+}
+
+void AudioFlinger::RecordThread::ResampleGroup::reset()
+{
+    mRsmpInFront = mThread->mRsmpInRear;
+    mRsmpInUnrel = 0;
+    mResampler->reset();
+}
+
+void AudioFlinger::RecordThread::ResampleGroup::use(uint32_t cycle)
+{
+    if (cycle != mCycle) {
+        if (cycle != mCycle + 1) {
+            // the input received while idle was not converted, and no track wants it
+            reset();
+        }
+        mCycle = cycle;
+    }
+}
+
+void AudioFlinger::RecordThread::ResampleGroup::resample()
+{
+    ssize_t filled = mThread->mRsmpInRear - mRsmpInFront;
+    if (filled < 0 || (size_t) filled > mThread->mRsmpInFrames) {
+        // should not happen as all the input is converted at each cycle, but re-sync
+        ALOGW("ResampleGroup %u Hz lost sync with input, %zd frames filled", mSampleRate, filled);
+        reset();
+        return;
+    }
+    // Although we theoretically have filled frames in circular buffer, some of those are
+    // unreleased frames, and thus must be discounted for purpose of budgeting.
+    size_t framesIn = (size_t) filled > mRsmpInUnrel ? (size_t) filled - mRsmpInUnrel : 0;
+    // Do not precompute in/out because floating point is not associative
+    // e.g. a*b/c != a*(b/c).
+    const double in(mThread->mSampleRate);
+    const double out(mSampleRate);
+    // ceil(framesOut * in / out) + 1 input frames are needed to produce framesOut frames
+    size_t framesOut = framesIn > 0 ? floor((framesIn - 1) * out / in) : 0;
+    while (framesOut > 0) {
+        const size_t rear = mRear & (mFramesP2 - 1);
+        size_t part1 = mFramesP2 - rear;
+        if (part1 > framesOut) {
+            part1 = framesOut;
+        }
+        if (part1 > mRsmpOutFrameCount) {
+            part1 = mRsmpOutFrameCount;
+        }
+        // resampler accumulates, but we only have one source track
+        memset(mRsmpOutBuffer, 0, part1 * FCC_2 * sizeof(int32_t));
+        mResampler->resample(mRsmpOutBuffer, part1, this);
+        // stereo 16-bit frames have the size of an int32_t
+        ditherAndClamp((int32_t *) &mBuffer[rear * FCC_2], mRsmpOutBuffer, part1);
+        mRear += part1;
+        framesOut -= part1;
+    }
+}
+
 // AudioBufferProvider interface
-status_t AudioFlinger::RecordThread::ResamplerBufferProvider::getNextBuffer(
+status_t AudioFlinger::RecordThread::ResampleGroup::getNextBuffer(
         AudioBufferProvider::Buffer* buffer, int64_t pts __unused)
 {
-    RecordTrack *activeTrack = mRecordTrack;
-    sp<ThreadBase> threadBase = activeTrack->mThread.promote();
-    if (threadBase == 0) {
-        buffer->frameCount = 0;
-        buffer->raw = NULL;
-        return NOT_ENOUGH_DATA;
-    }
-    RecordThread *recordThread = (RecordThread *) threadBase.get();
+    RecordThread *recordThread = mThread;
     int32_t rear = recordThread->mRsmpInRear;
-    int32_t front = activeTrack->mRsmpInFront;
+    int32_t front = mRsmpInFront;
     ssize_t filled = rear - front;
     // FIXME should not be P2 (don't want to increase latency)
-    // FIXME if client not keeping up, discard
     LOG_ALWAYS_FATAL_IF(!(0 <= filled && (size_t) filled <= recordThread->mRsmpInFrames));
     // 'filled' may be non-contiguous, so return only the first contiguous chunk
     front &= recordThread->mRsmpInFramesP2 - 1;
@@ -5926,32 +6024,57 @@ status_t AudioFlinger::RecordThread::ResamplerBufferProvider::getNextBuffer(
         LOG_ALWAYS_FATAL("RecordThread::getNextBuffer() starved");
         buffer->raw = NULL;
         buffer->frameCount = 0;
-        activeTrack->mRsmpInUnrel = 0;
+        mRsmpInUnrel = 0;
         return NOT_ENOUGH_DATA;
     }
 
     buffer->raw = recordThread->mRsmpInBuffer + front * recordThread->mChannelCount;
     buffer->frameCount = part1;
-    activeTrack->mRsmpInUnrel = part1;
+    mRsmpInUnrel = part1;
     return NO_ERROR;
 }
 
 // AudioBufferProvider interface
-void AudioFlinger::RecordThread::ResamplerBufferProvider::releaseBuffer(
+void AudioFlinger::RecordThread::ResampleGroup::releaseBuffer(
         AudioBufferProvider::Buffer* buffer)
 {
-    RecordTrack *activeTrack = mRecordTrack;
     size_t stepCount = buffer->frameCount;
     if (stepCount == 0) {
         return;
     }
-    ALOG_ASSERT(stepCount <= activeTrack->mRsmpInUnrel);
-    activeTrack->mRsmpInUnrel -= stepCount;
-    activeTrack->mRsmpInFront += stepCount;
+    ALOG_ASSERT(stepCount <= mRsmpInUnrel);
+    mRsmpInUnrel -= stepCount;
+    mRsmpInFront += stepCount;
     buffer->raw = NULL;
     buffer->frameCount = 0;
 }
 
+AudioFlinger::RecordThread::ResampleGroup* AudioFlinger::RecordThread::getResampleGroup_l(
+        uint32_t sampleRate, uint32_t cycle)
+{
+    ResampleGroup *group;
+    ssize_t index = mResampleGroups.indexOfKey(sampleRate);
+    if (index >= 0) {
+        group = mResampleGroups.valueAt(index);
+    } else {
+        group = new ResampleGroup(this, sampleRate);
+        mResampleGroups.add(sampleRate, group);
+    }
+    group->use(cycle);
+    return group;
+}
+
+void AudioFlinger::RecordThread::clearResampleGroups_l()
+{
+    for (size_t i = 0; i < mTracks.size(); i++) {
+        mTracks[i]->mResampleGroup = NULL;
+    }
+    for (size_t i = 0; i < mResampleGroups.size(); i++) {
+        delete mResampleGroups.valueAt(i);
+    }
+    mResampleGroups.clear();
+}
+
 bool AudioFlinger::RecordThread::checkForNewParameter_l(const String8& keyValuePair,
                                                         status_t& status)
 {
@@ -6133,6 +6256,8 @@ void AudioFlinger::RecordThread::readInputParameters_l()
     mRsmpInFrames = mFrameCount * 7;
     mRsmpInFramesP2 = roundup(mRsmpInFrames);
     delete[] mRsmpInBuffer;
+    // the resample groups depend on the HAL sample rate and channel count
+    clearResampleGroups_l();
 
     // TODO optimize audio capture buffer sizes ...
     // Here we calculate the size of the sliding buffer used as a source
@@ -590,6 +590,10 @@ public:
 
                 status_t    getTimestamp_l(AudioTimestamp& timestamp);
 
+                // estimated CLOCK_MONOTONIC time at which the first frame of the next mix period
+                // will be presented, used to schedule track start and stop times
+                int64_t     nextPresentationTimeNs_l() const;
+
                 void        addPatchTrack(const sp<PatchTrack>& track);
                 void        deletePatchTrack(const sp<PatchTrack>& track);
 
@@ -1031,17 +1035,52 @@ class RecordThread : public ThreadBase
 public:
 
     class RecordTrack;
-    class ResamplerBufferProvider : public AudioBufferProvider
+
+    // Converts the HAL input to one client sample rate on behalf of all the tracks capturing
+    // at that rate, so that concurrent clients share the cost of resampling. The output is kept
+    // in a ring of stereo 16-bit frames which each track reads at its own pace through a private
+    // rolling index, the same way tracks at the HAL rate read mRsmpInBuffer.
+    // Only used by the record thread loop, no locks required.
+    class ResampleGroup : public AudioBufferProvider
                         // derives from AudioBufferProvider interface for use by resampler
     {
     public:
-        ResamplerBufferProvider(RecordTrack* recordTrack) : mRecordTrack(recordTrack) { }
-        virtual ~ResamplerBufferProvider() { }
+        ResampleGroup(RecordThread *thread, uint32_t sampleRate);
+        virtual ~ResampleGroup();
+
+        // mark the group as used by thread loop cycle 'cycle'; a group which was not used
+        // by the previous cycle restarts from the most recent HAL input
+        void        use(uint32_t cycle);
+        bool        isUsedBy(uint32_t cycle) const { return mCycle == cycle; }
+        // convert all the HAL input received since the previous call
+        void        resample();
+
+        int32_t         rear() const { return mRear; }
+        size_t          framesP2() const { return mFramesP2; }
+        const int16_t  *buffer() const { return mBuffer; }
+
         // AudioBufferProvider interface
         virtual status_t    getNextBuffer(AudioBufferProvider::Buffer* buffer, int64_t pts);
         virtual void        releaseBuffer(AudioBufferProvider::Buffer* buffer);
+
     private:
-        RecordTrack * const mRecordTrack;
+        // discard the unconverted input and the resampler history, keep the output
+        void        reset();
+
+        RecordThread * const    mThread;
+        const uint32_t          mSampleRate;    // output sample rate
+        AudioResampler         *mResampler;
+        // rolling counter that is never cleared
+        int32_t                 mRsmpInFront;   // next input frame in mThread->mRsmpInBuffer
+        size_t                  mRsmpInUnrel;   // unreleased frames from most recent getNextBuffer
+        int16_t                *mBuffer;        // ring of interleaved stereo frames
+        size_t                  mFramesP2;      // size of mBuffer in frames, a power of 2
+        // rolling counter that is never cleared
+        int32_t                 mRear;          // last filled frame + 1
+        // interleaved stereo pairs of fixed-point Q4.27, accumulated by the resampler
+        int32_t                *mRsmpOutBuffer;
+        size_t                  mRsmpOutFrameCount;
+        uint32_t                mCycle;         // last thread loop cycle using this group
     };
 
 #include "RecordTracks.h"
@@ -1139,6 +1178,11 @@ private:
             // Enter standby if not already in standby, and set mStandby flag
             void    standbyIfNotAlreadyInStandby();
 
+            // return the resample group converting to sampleRate, creating it if needed,
+            // and mark it as used by thread loop cycle 'cycle'
+            ResampleGroup*  getResampleGroup_l(uint32_t sampleRate, uint32_t cycle);
+            void            clearResampleGroups_l();
+
             // Call the HAL standby method unconditionally, and don't change mStandby flag
             void    inputStandBy();
 
@@ -1159,6 +1203,9 @@ private:
             // rolling index that is never cleared
             int32_t                             mRsmpInRear;    // last filled frame + 1
 
+            // one group per client sample rate that differs from the HAL rate, see ResampleGroup
+            KeyedVector<uint32_t, ResampleGroup*> mResampleGroups;
+
             // For dumpsys
             const sp<NBAIO_Sink>                mTeeSink;
 
@@ -1198,5 +1245,6 @@ private:
             static const size_t                 kFastCaptureLogSize = 4 * 1024;
             sp<NBLog::Writer>                   mFastCaptureNBLogWriter;
 
-            bool                                mFastTrackAvail;    // true if fast track available
+            // bit i set if FastCaptureState::mCblks[i] is available for a fast track
+            unsigned                            mFastTrackAvailMask;
 };
@@ -361,6 +361,16 @@ void AudioFlinger::TrackHandle::signal()
     return mTrack->signal();
 }
 
+status_t AudioFlinger::TrackHandle::setStartTime(int64_t presentationTimeNs)
+{
+    return mTrack->setStartTime(presentationTimeNs);
+}
+
+status_t AudioFlinger::TrackHandle::setStopTime(int64_t presentationTimeNs)
+{
+    return mTrack->setStopTime(presentationTimeNs);
+}
+
 status_t AudioFlinger::TrackHandle::onTransact(
     uint32_t code, const Parcel& data, Parcel* reply, uint32_t flags)
 {
@@ -405,8 +415,17 @@ AudioFlinger::PlaybackThread::Track::Track(
     mResumeToStopping(false),
     mFlushHwPending(false),
     mPreviousValid(false),
-    mPreviousFramesWritten(0)
+    mPreviousFramesWritten(0),
     // mPreviousTimestamp
+    mStartTimeNs(0),
+    mStopTimeNs(0),
+    mSilenceFrames(0),
+    mTrimFrames(0),
+    mFramesUntilStop(-1),
+    mResetStartFrames(false),
+    mResetStopFrames(false),
+    mScheduledStopDone(false),
+    mSilenceBuffer(NULL)
 {
     // client == 0 implies sharedBuffer == 0
     ALOG_ASSERT(!(client == 0 && sharedBuffer != 0));
@@ -460,6 +479,7 @@ AudioFlinger::PlaybackThread::Track::~Track()
     if (mSharedBuffer != 0) {
         mSharedBuffer.clear();
     }
+    free(mSilenceBuffer);
 }
 
 status_t AudioFlinger::PlaybackThread::Track::initCheck() const
@@ -597,6 +617,33 @@ status_t AudioFlinger::PlaybackThread::Track::getNextBuffer(
 {
     ServerProxy::Buffer buf;
     size_t desiredFrames = buffer->frameCount;
+
+    // zero padding before a scheduled start, or after a scheduled stop
+    if (mSilenceFrames > 0 || mFramesUntilStop == 0) {
+        size_t frames = desiredFrames;
+        if (mSilenceFrames > 0 && frames > mSilenceFrames) {
+            frames = mSilenceFrames;
+        }
+        if (frames > kSilenceFrames) {
+            frames = kSilenceFrames;
+        }
+        buffer->frameCount = frames;
+        buffer->raw = mSilenceBuffer;
+        return NO_ERROR;
+    }
+    // trimming of the frames that should have been presented before a late scheduled start
+    while (mTrimFrames > 0) {
+        buf.mFrameCount = mTrimFrames;
+        if (mServerProxy->obtainBuffer(&buf) != NO_ERROR || buf.mFrameCount == 0) {
+            break;
+        }
+        mTrimFrames -= buf.mFrameCount;
+        mServerProxy->releaseBuffer(&buf);
+    }
+    if (mFramesUntilStop > 0 && desiredFrames > (size_t) mFramesUntilStop) {
+        desiredFrames = mFramesUntilStop;
+    }
+
     buf.mFrameCount = desiredFrames;
     status_t status = mServerProxy->obtainBuffer(&buf);
     buffer->frameCount = buf.mFrameCount;
@@ -607,7 +654,21 @@ status_t AudioFlinger::PlaybackThread::Track::getNextBuffer(
     return status;
 }
 
-// releaseBuffer() is not overridden
+void AudioFlinger::PlaybackThread::Track::releaseBuffer(AudioBufferProvider::Buffer* buffer)
+{
+    if (buffer->raw != NULL && buffer->raw == mSilenceBuffer) {
+        if (mSilenceFrames > 0) {
+            mSilenceFrames -= buffer->frameCount;
+        }
+        buffer->frameCount = 0;
+        buffer->raw = NULL;
+        return;
+    }
+    if (mFramesUntilStop > 0) {
+        mFramesUntilStop -= buffer->frameCount;
+    }
+    TrackBase::releaseBuffer(buffer);
+}
 
 // ExtendedAudioBufferProvider interface
 
@@ -630,6 +691,11 @@ size_t AudioFlinger::PlaybackThread::Track::framesReleased() const
 
 // Don't call for fast tracks; the framesReady() could result in priority inversion
 bool AudioFlinger::PlaybackThread::Track::isReady() const {
+    // the frames written after a scheduled stop are only played once the track is restarted
+    if (mScheduledStopDone) {
+        return false;
+    }
+
     if (mFillingUpStatus != FS_FILLING || isStopped() || isPausing()) {
         return true;
     }
@@ -680,6 +746,7 @@ status_t AudioFlinger::PlaybackThread::Track::start(AudioSystem::sync_event_t ev
         track_state state = mState;
         // here the track could be either new, or restarted
         // in both cases "unstop" the track
+        mScheduledStopDone = false;
 
         // initial state-stopping. next state-pausing.
         // What if resume is called ?
@@ -793,6 +860,10 @@ void AudioFlinger::PlaybackThread::Track::flush()
         Mutex::Autolock _l(thread->mLock);
         PlaybackThread *playbackThread = (PlaybackThread *)thread.get();
 
+        // padding and trimming of a scheduled start or stop apply to the flushed data
+        mResetStartFrames = true;
+        mResetStopFrames = true;
+
         if (isOffloaded()) {
             // If offloaded we allow flush during any state except terminated
             // and keep the track active to avoid problems if user is seeking
@@ -853,6 +924,116 @@ void AudioFlinger::PlaybackThread::Track::flushAck()
     mFlushHwPending = false;
 }
 
+status_t AudioFlinger::PlaybackThread::Track::setStartTime(int64_t presentationTimeNs)
+{
+    if (isFastTrack() || isOffloaded() || isDirect() || isTimedTrack() || isPatchTrack()) {
+        return INVALID_OPERATION;
+    }
+    sp<ThreadBase> thread = mThread.promote();
+    if (thread == 0) {
+        return BAD_VALUE;
+    }
+    Mutex::Autolock _l(thread->mLock);
+    if (presentationTimeNs != 0 && mSilenceBuffer == NULL) {
+        mSilenceBuffer = calloc(kSilenceFrames, mFrameSize);
+        if (mSilenceBuffer == NULL) {
+            return NO_MEMORY;
+        }
+    }
+    mStartTimeNs = presentationTimeNs;
+    mResetStartFrames = true;
+    return NO_ERROR;
+}
+
+status_t AudioFlinger::PlaybackThread::Track::setStopTime(int64_t presentationTimeNs)
+{
+    if (isFastTrack() || isOffloaded() || isDirect() || isTimedTrack() || isPatchTrack()) {
+        return INVALID_OPERATION;
+    }
+    sp<ThreadBase> thread = mThread.promote();
+    if (thread == 0) {
+        return BAD_VALUE;
+    }
+    Mutex::Autolock _l(thread->mLock);
+    if (presentationTimeNs != 0 && mSilenceBuffer == NULL) {
+        mSilenceBuffer = calloc(kSilenceFrames, mFrameSize);
+        if (mSilenceBuffer == NULL) {
+            return NO_MEMORY;
+        }
+    }
+    mStopTimeNs = presentationTimeNs;
+    mResetStopFrames = true;
+    return NO_ERROR;
+}
+
+void AudioFlinger::PlaybackThread::Track::applyScheduledTimes_l(int64_t nextPresentationNs,
+        uint32_t sinkSampleRate, size_t sinkFrameCount)
+{
+    const uint32_t sampleRate = this->sampleRate();
+    // the start time is only meaningful for the first mix period after start()
+    if (mStartTimeNs != 0 && mFillingUpStatus == FS_FILLED) {
+        const int64_t deltaNs = mStartTimeNs - nextPresentationNs;
+        if (deltaNs >= 0) {
+            mSilenceFrames = (size_t) ((deltaNs * sampleRate) / 1000000000LL);
+        } else {
+            mTrimFrames = (size_t) ((-deltaNs * sampleRate) / 1000000000LL);
+        }
+        ALOGV("track %d scheduled start in %lld ns: %zu frames of silence, %zu trimmed",
+                mName, (long long) deltaNs, mSilenceFrames, mTrimFrames);
+        mStartTimeNs = 0;
+    }
+    if (mStopTimeNs != 0) {
+        const int64_t periodNs = ((int64_t) sinkFrameCount * 1000000000LL) / sinkSampleRate;
+        const int64_t deltaNs = mStopTimeNs - nextPresentationNs;
+        if (deltaNs < periodNs) {
+            // stop falls in this period: the silence before a scheduled start is played first
+            mFramesUntilStop = deltaNs <= 0 ? 0 :
+                    (ssize_t) ((deltaNs * sampleRate) / 1000000000LL);
+            if (mFramesUntilStop > (ssize_t) mSilenceFrames) {
+                mFramesUntilStop -= mSilenceFrames;
+            } else {
+                mSilenceFrames = 0;
+                mFramesUntilStop = 0;
+            }
+            ALOGV("track %d scheduled stop after %zd frames", mName, mFramesUntilStop);
+            mStopTimeNs = 0;
+        }
+    }
+}
+
+void AudioFlinger::PlaybackThread::Track::resetScheduledFrames_l()
+{
+    if (mResetStartFrames) {
+        mSilenceFrames = 0;
+        mTrimFrames = 0;
+        mResetStartFrames = false;
+    }
+    if (mResetStopFrames) {
+        mFramesUntilStop = -1;
+        mResetStopFrames = false;
+    }
+}
+
+void AudioFlinger::PlaybackThread::Track::completeScheduledStop_l()
+{
+    // the data written after the stop time is never played
+    ServerProxy::Buffer buf;
+    for (;;) {
+        buf.mFrameCount = mFrameCount;
+        if (mServerProxy->obtainBuffer(&buf) != NO_ERROR || buf.mFrameCount == 0) {
+            break;
+        }
+        mServerProxy->releaseBuffer(&buf);
+    }
+    mFramesUntilStop = -1;
+    mSilenceFrames = 0;
+    mTrimFrames = 0;
+    mState = STOPPED;
+    mScheduledStopDone = true;
+    // let the client know, it would otherwise keep writing to a track that no longer plays
+    android_atomic_or(CBLK_STOP_DONE, &mCblk->mFlags);
+}
+
 void AudioFlinger::PlaybackThread::Track::reset()
 {
     // Do not reset twice to avoid discarding data written just after a flush and before
@@ -2000,9 +2181,10 @@ AudioFlinger::RecordThread::RecordTrack::RecordTrack(
                           ((flags & IAudioFlinger::TRACK_FAST) ? ALLOC_PIPE : ALLOC_CBLK) :
                           ((buffer == NULL) ? ALLOC_LOCAL : ALLOC_NONE),
                   type),
-        mOverflow(false), mResampler(NULL), mRsmpOutBuffer(NULL), mRsmpOutFrameCount(0),
+        mOverflow(false), mResampleGroup(NULL),
         // See real initialization of mRsmpInFront at RecordThread::start()
-        mRsmpInUnrel(0), mRsmpInFront(0), mFramesToDrop(0), mResamplerBufferProvider(NULL)
+        // and of mRsmpOutFront at RecordThread::threadLoop()
+        mRsmpInFront(0), mRsmpOutFront(0), mFramesToDrop(0), mFastIndex(-1)
 {
     if (mCblk == NULL) {
         return;
@@ -2011,31 +2193,16 @@ AudioFlinger::RecordThread::RecordTrack::RecordTrack(
     mServerProxy = new AudioRecordServerProxy(mCblk, mBuffer, frameCount,
                                               mFrameSize, !isExternalTrack());
 
-    uint32_t channelCount = audio_channel_count_from_in_mask(channelMask);
-    // FIXME I don't understand either of the channel count checks
-    if (thread->mSampleRate != sampleRate && thread->mChannelCount <= FCC_2 &&
-            channelCount <= FCC_2) {
-        // sink SR
-        mResampler = AudioResampler::create(AUDIO_FORMAT_PCM_16_BIT,
-                thread->mChannelCount, sampleRate);
-        // source SR
-        mResampler->setSampleRate(thread->mSampleRate);
-        mResampler->setVolume(AudioMixer::UNITY_GAIN_FLOAT, AudioMixer::UNITY_GAIN_FLOAT);
-        mResamplerBufferProvider = new ResamplerBufferProvider(this);
-    }
-
     if (flags & IAudioFlinger::TRACK_FAST) {
-        ALOG_ASSERT(thread->mFastTrackAvail);
-        thread->mFastTrackAvail = false;
+        ALOG_ASSERT(thread->mFastTrackAvailMask != 0);
+        mFastIndex = __builtin_ctz(thread->mFastTrackAvailMask);
+        thread->mFastTrackAvailMask &= ~(1 << mFastIndex);
     }
 }
 
 AudioFlinger::RecordThread::RecordTrack::~RecordTrack()
 {
     ALOGV("%s", __func__);
-    delete mResampler;
-    delete[] mRsmpOutBuffer;
-    delete mResamplerBufferProvider;
 }
 
 // AudioBufferProvider interface
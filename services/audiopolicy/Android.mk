@@ -53,7 +53,8 @@ ifneq ($(USE_LEGACY_AUDIO_POLICY), 1)
 include $(CLEAR_VARS)
 
 LOCAL_SRC_FILES:= \
-    AudioPolicyManager.cpp
+    AudioPolicyManager.cpp \
+    AudioPolicyConfigCache.cpp
 
 ifeq ($(ENABLE_BACKGROUND_MUSIC),true)
   LOCAL_CFLAGS += -DBGM_ENABLED
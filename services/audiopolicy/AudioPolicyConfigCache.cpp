@@ -0,0 +1,244 @@
+/*
+ * Copyright (C) 2015 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#define LOG_TAG "AudioPolicyConfigCache"
+//#define LOG_NDEBUG 0
+
+#include <errno.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <utils/Log.h>
+#include "AudioPolicyConfigCache.h"
+
+namespace android {
+
+// Layout of a compiled file, all fields in native byte order:
+//  Header
+//  Node[mNodeCount], in depth-first order with the root first
+//  string table of mStringsSize bytes, NUL-terminated strings
+static const uint32_t kMagic = 0x43435041;  // "APCC"
+static const uint32_t kVersion = 2;
+static const uint32_t kNone = 0xFFFFFFFF;   // no child or sibling
+
+struct Header {
+    uint32_t mMagic;
+    uint32_t mVersion;
+    uint32_t mSourceSize;
+    uint32_t mNodeCount;
+    uint32_t mStringsSize;
+};
+
+struct Node {
+    uint32_t mName;         // offsets in the string table
+    uint32_t mValue;
+    uint32_t mFirstChild;   // node indices or kNone
+    uint32_t mNext;
+};
+
+AudioPolicyConfigCache::AudioPolicyConfigCache() :
+    mData(NULL), mSize(0), mNodes(NULL)
+{
+}
+
+AudioPolicyConfigCache::~AudioPolicyConfigCache()
+{
+    unload();
+}
+
+static void measure(const cnode *node, uint32_t *nodeCount, uint32_t *stringsSize)
+{
+    for (; node != NULL; node = node->next) {
+        (*nodeCount)++;
+        *stringsSize += strlen(node->name) + 1 + strlen(node->value) + 1;
+        measure(node->first_child, nodeCount, stringsSize);
+    }
+}
+
+// Fills the nodes of the list starting at 'node' from index *nodeIndex, depth first.
+static void flatten(const cnode *node, Node *nodes, char *strings,
+                    uint32_t *nodeIndex, uint32_t *stringsOffset)
+{
+    while (node != NULL) {
+        Node *out = &nodes[(*nodeIndex)++];
+        size_t len = strlen(node->name) + 1;
+        memcpy(strings + *stringsOffset, node->name, len);
+        out->mName = *stringsOffset;
+        *stringsOffset += len;
+        len = strlen(node->value) + 1;
+        memcpy(strings + *stringsOffset, node->value, len);
+        out->mValue = *stringsOffset;
+        *stringsOffset += len;
+        out->mFirstChild = node->first_child != NULL ? *nodeIndex : kNone;
+        flatten(node->first_child, nodes, strings, nodeIndex, stringsOffset);
+        node = node->next;
+        out->mNext = node != NULL ? *nodeIndex : kNone;
+    }
+}
+
+/*static*/
+status_t AudioPolicyConfigCache::compile(const char *path, const cnode *root, uint32_t sourceSize)
+{
+    // the root has no siblings of interest
+    uint32_t nodeCount = 1;
+    uint32_t stringsSize = strlen(root->name) + 1 + strlen(root->value) + 1;
+    measure(root->first_child, &nodeCount, &stringsSize);
+
+    const size_t size = sizeof(Header) + nodeCount * sizeof(Node) + stringsSize;
+    char *data = (char *) calloc(1, size);
+    if (data == NULL) {
+        return NO_MEMORY;
+    }
+    Header *header = (Header *) data;
+    header->mMagic = kMagic;
+    header->mVersion = kVersion;
+    header->mSourceSize = sourceSize;
+    header->mNodeCount = nodeCount;
+    header->mStringsSize = stringsSize;
+    Node *nodes = (Node *) (header + 1);
+    char *strings = (char *) (nodes + nodeCount);
+
+    cnode rootOnly = *root;
+    rootOnly.next = NULL;
+    uint32_t nodeIndex = 0;
+    uint32_t stringsOffset = 0;
+    flatten(&rootOnly, nodes, strings, &nodeIndex, &stringsOffset);
+    ALOG_ASSERT(nodeIndex == nodeCount && stringsOffset == stringsSize);
+
+    // write to a temporary file first so that a reader never sees a partial file
+    char tmpPath[PATH_MAX];
+    snprintf(tmpPath, sizeof(tmpPath), "%s.tmp", path);
+    status_t status = NO_ERROR;
+    int fd = open(tmpPath, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (fd < 0) {
+        status = -errno;
+    } else {
+        ssize_t written = write(fd, data, size);
+        if (written != (ssize_t) size) {
+            status = written < 0 ? -errno : NOT_ENOUGH_DATA;
+        }
+        if (close(fd) != 0 && status == NO_ERROR) {
+            status = -errno;
+        }
+        if (status == NO_ERROR && rename(tmpPath, path) != 0) {
+            status = -errno;
+        }
+        if (status != NO_ERROR) {
+            unlink(tmpPath);
+        }
+    }
+    free(data);
+    ALOGW_IF(status != NO_ERROR, "compile() could not write %s: %d", path, status);
+    return status;
+}
+
+cnode *AudioPolicyConfigCache::load(const char *path, uint32_t sourceSize)
+{
+    unload();
+
+    int fd = open(path, O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+        return NULL;
+    }
+    struct stat st;
+    if (fstat(fd, &st) != 0 || st.st_size < (off_t) sizeof(Header)) {
+        close(fd);
+        return NULL;
+    }
+    mSize = st.st_size;
+    // writable private mapping: the loaders tokenize values in place as they do with the buffer
+    // given to config_load(), which only copies the pages they touch
+    mData = mmap(NULL, mSize, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (mData == MAP_FAILED) {
+        mData = NULL;
+        return NULL;
+    }
+
+    const Header *header = (const Header *) mData;
+    if (header->mMagic != kMagic || header->mVersion != kVersion ||
+            header->mSourceSize != sourceSize || header->mNodeCount == 0 ||
+            header->mNodeCount > (mSize - sizeof(Header)) / sizeof(Node) ||
+            header->mStringsSize !=
+                    mSize - sizeof(Header) - header->mNodeCount * sizeof(Node) ||
+            header->mStringsSize == 0) {
+        ALOGV("load() %s is stale or malformed", path);
+        unload();
+        return NULL;
+    }
+    const uint32_t nodeCount = header->mNodeCount;
+    const uint32_t stringsSize = header->mStringsSize;
+    const Node *nodes = (const Node *) (header + 1);
+    const char *strings = (const char *) (nodes + nodeCount);
+    if (strings[stringsSize - 1] != '\0') {
+        unload();
+        return NULL;
+    }
+
+    mNodes = (cnode *) calloc(nodeCount, sizeof(cnode));
+    if (mNodes == NULL) {
+        unload();
+        return NULL;
+    }
+    for (uint32_t i = 0; i < nodeCount; i++) {
+        const Node& in = nodes[i];
+        // links only go forward in depth-first order, which also excludes cycles
+        if (in.mName >= stringsSize || in.mValue >= stringsSize ||
+                (in.mFirstChild != kNone && (in.mFirstChild <= i || in.mFirstChild >= nodeCount)) ||
+                (in.mNext != kNone && (in.mNext <= i || in.mNext >= nodeCount))) {
+            ALOGW("load() %s has an invalid node %u", path, i);
+            unload();
+            return NULL;
+        }
+        cnode *out = &mNodes[i];
+        out->name = strings + in.mName;
+        out->value = strings + in.mValue;
+        if (in.mFirstChild != kNone) {
+            out->first_child = &mNodes[in.mFirstChild];
+        }
+        if (in.mNext != kNone) {
+            out->next = &mNodes[in.mNext];
+        }
+    }
+    // last_child is only used by config_load() to append, but keep the tree consistent
+    for (uint32_t i = 0; i < nodeCount; i++) {
+        cnode *child = mNodes[i].first_child;
+        while (child != NULL && child->next != NULL) {
+            child = child->next;
+        }
+        mNodes[i].last_child = child;
+    }
+    ALOGV("load() mapped %s, %u nodes", path, nodeCount);
+    return &mNodes[0];
+}
+
+void AudioPolicyConfigCache::unload()
+{
+    free(mNodes);
+    mNodes = NULL;
+    if (mData != NULL) {
+        munmap(mData, mSize);
+        mData = NULL;
+    }
+    mSize = 0;
+}
+
+}; // namespace android
@@ -0,0 +1,65 @@
+/*
+ * Copyright (C) 2015 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef ANDROID_AUDIO_POLICY_CONFIG_CACHE_H
+#define ANDROID_AUDIO_POLICY_CONFIG_CACHE_H
+
+#include <stdint.h>
+#include <sys/types.h>
+#include <cutils/config_utils.h>
+#include <utils/Errors.h>
+
+namespace android {
+
+// Compiled form of an audio_policy.conf file, so that audio policy initialization after an
+// audio server restart does not need to tokenize the text configuration again.
+//
+// The compiled file holds the configuration tree as an array of nodes referring to a string table,
+// and the size of the source text it was compiled from. It is mapped privately and the cnode tree
+// handed to the loaders points directly into the mapping.
+// Compiled files are produced at build time by the audio_policy_compile host tool, and installed
+// in the same read-only partition as their source, which the build regenerates them from whenever
+// it changes. So the source size is only a cheap check against a mismatched install, which spares
+// reading the source at all.
+class AudioPolicyConfigCache {
+public:
+                AudioPolicyConfigCache();
+                ~AudioPolicyConfigCache();
+
+    // Writes the compiled form of the tree 'root' parsed from a source of the given size.
+    // The file is replaced atomically.
+    static status_t compile(const char *path, const cnode *root, uint32_t sourceSize);
+
+    // Maps a compiled file and returns the root of its tree, or NULL if the file is missing,
+    // malformed, or was compiled from a source of another size. The tree is valid until the next
+    // load() or the destruction of this object. As with config_load(), node values may be modified
+    // in place, but the tree must not be passed to config_free().
+    cnode       *load(const char *path, uint32_t sourceSize);
+
+private:
+                AudioPolicyConfigCache(const AudioPolicyConfigCache&);
+                AudioPolicyConfigCache& operator=(const AudioPolicyConfigCache&);
+
+    void        unload();
+
+    void        *mData;     // mapping of the compiled file, or NULL
+    size_t      mSize;
+    cnode       *mNodes;    // nodes linked from the mapping, mNodes[0] is the root
+};
+
+}; // namespace android
+
+#endif // ANDROID_AUDIO_POLICY_CONFIG_CACHE_H
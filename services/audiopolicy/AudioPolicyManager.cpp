@@ -36,6 +36,7 @@
 
 #include <inttypes.h>
 #include <math.h>
+#include <sys/stat.h>
 
 #include <cutils/properties.h>
 #include <utils/Log.h>
@@ -44,6 +45,7 @@
 #include <media/AudioParameter.h>
 #include <soundtrigger/SoundTrigger.h>
 #include "AudioPolicyManager.h"
+#include "AudioPolicyConfigCache.h"
 #include "audio_policy_conf.h"
 
 namespace android {
@@ -227,6 +229,7 @@ bool AudioPolicyManager::IsRemoteBGMSupported(audio_stream_type_t stream) {
         AudioParameter param = AudioParameter(reply);
         String8 value;
 
+        const bool wasBGMEnabled = mIsBGMEnabled;
         if (param.get(String8(AUDIO_PARAMETER_KEY_REMOTE_BGM_STATE), value) == NO_ERROR) {
             mIsBGMEnabled  = (value == "true");
         }
@@ -236,6 +239,9 @@ bool AudioPolicyManager::IsRemoteBGMSupported(audio_stream_type_t stream) {
         }
 
         ALOGV("%s mIsBGMEnabled= %d",__func__, mIsBGMEnabled);
+        if (mIsBGMEnabled != wasBGMEnabled) {
+            invalidateRouting();
+        }
 
         return mIsBGMEnabled;
     }
@@ -279,12 +285,14 @@ status_t AudioPolicyManager::setDeviceConnectionState(audio_devices_t device,
 
             // register new device as available
             index = mAvailableOutputDevices.add(devDesc);
+            invalidateRouting();
             if (index >= 0) {
                 sp<HwModule> module = getModuleForDevice(device);
                 if (module == 0) {
                     ALOGD("setDeviceConnectionState() could not find HW module for device %08x",
                           device);
                     mAvailableOutputDevices.remove(devDesc);
+                    invalidateRouting();
                     return INVALID_OPERATION;
                 }
                 mAvailableOutputDevices[index]->mId = nextUniqueId();
@@ -295,6 +303,7 @@ status_t AudioPolicyManager::setDeviceConnectionState(audio_devices_t device,
 
             if (checkOutputsForDevice(devDesc, state, outputs, address) != NO_ERROR) {
                 mAvailableOutputDevices.remove(devDesc);
+                invalidateRouting();
                 return INVALID_OPERATION;
             }
             // outputs should never be empty here
@@ -317,6 +326,7 @@ status_t AudioPolicyManager::setDeviceConnectionState(audio_devices_t device,
             if (device & AUDIO_DEVICE_OUT_REMOTE_SUBMIX) {
                 mBGMOutput = 0;
                 mIsBGMEnabled = 0;
+                invalidateRouting();
                 ALOGV("[BGMUSIC] BGM device becomes unavailable mIsBGMEnabled = %d", mIsBGMEnabled);
             }
 #endif //BGM_ENABLED
@@ -327,6 +337,7 @@ status_t AudioPolicyManager::setDeviceConnectionState(audio_devices_t device,
 
             // remove device from available output devices
             mAvailableOutputDevices.remove(devDesc);
+            invalidateRouting();
             checkOutputsForDevice(devDesc, state, outputs, address);
             } break;
 
@@ -406,6 +417,7 @@ status_t AudioPolicyManager::setDeviceConnectionState(audio_devices_t device,
             }
 
             index = mAvailableInputDevices.add(devDesc);
+            invalidateRouting();
             if (index >= 0) {
                 mAvailableInputDevices[index]->mId = nextUniqueId();
                 mAvailableInputDevices[index]->mModule = module;
@@ -430,6 +442,7 @@ status_t AudioPolicyManager::setDeviceConnectionState(audio_devices_t device,
 
             checkInputsForDevice(device, state, inputs, address);
             mAvailableInputDevices.remove(devDesc);
+            invalidateRouting();
 
         } break;
 
@@ -623,6 +636,7 @@ void AudioPolicyManager::setPhoneState(audio_mode_t state)
     // store previous phone state for management of sonification strategy below
     int oldState = mPhoneState;
     mPhoneState = state;
+    invalidateRouting();
     bool force = false;
 
     // are we entering or starting a call
@@ -792,6 +806,7 @@ void AudioPolicyManager::setForceUse(audio_policy_force_use_t usage,
         ALOGW("setForceUse() invalid usage %d", usage);
         break;
     }
+    invalidateRouting();
 
     // check for device and output changes triggered by new force usage
     checkA2dpSuspend();
@@ -1348,6 +1363,7 @@ void AudioPolicyManager::releaseOutput(audio_io_handle_t output)
         if (outputDesc->isActive()) {
             mpClientInterface->closeOutput(output);
             mOutputs.removeItem(output);
+            invalidateRouting();
             mTestOutputs[testIndex] = 0;
         }
         return;
@@ -1961,6 +1977,9 @@ status_t AudioPolicyManager::dump(int fd)
     snprintf(buffer, SIZE, " Force use for hdmi system audio %d\n",
             mForceUse[AUDIO_POLICY_FORCE_FOR_HDMI_SYSTEM_AUDIO]);
     result.append(buffer);
+    snprintf(buffer, SIZE, " Routing cache: generation %u hits %u misses %u\n",
+             mRoutingGeneration, mRoutingCacheHits, mRoutingCacheMisses);
+    result.append(buffer);
 
     snprintf(buffer, SIZE, " Available output devices:\n");
     result.append(buffer);
@@ -2754,7 +2773,10 @@ AudioPolicyManager::AudioPolicyManager(AudioPolicyClientInterface *clientInterfa
 #endif //AUDIO_POLICY_TEST
     mPrimaryOutput((audio_io_handle_t)0),
     mPhoneState(AUDIO_MODE_NORMAL),
-    mLimitRingtoneVolume(false), mLastVoiceVolume(-1.0f),
+    mLimitRingtoneVolume(false),
+    mRoutingGeneration(1), mMemoOutputsForDeviceGeneration(0),
+    mRoutingCacheHits(0), mRoutingCacheMisses(0),
+    mLastVoiceVolume(-1.0f),
     mTotalEffectsCpuLoad(0), mTotalEffectsMemory(0),
     mA2dpSuspended(false),
     mSpeakerDrcEnabled(false), mNextUniqueId(1),
@@ -2771,6 +2793,9 @@ AudioPolicyManager::AudioPolicyManager(AudioPolicyClientInterface *clientInterfa
     for (int i = 0; i < AUDIO_POLICY_FORCE_USE_CNT; i++) {
         mForceUse[i] = AUDIO_POLICY_FORCE_NONE;
     }
+    for (int i = 0; i < NUM_STRATEGIES; i++) {
+        mMemoDeviceForStrategyGeneration[i] = 0;
+    }
 
     mDefaultOutputDevice = new DeviceDescriptor(String8(""), AUDIO_DEVICE_OUT_SPEAKER);
     if (loadAudioPolicyConfig(AUDIO_POLICY_VENDOR_CONFIG_FILE) != NO_ERROR) {
@@ -2863,6 +2888,7 @@ AudioPolicyManager::AudioPolicyManager(AudioPolicyClientInterface *clientInterfa
                 if (mPrimaryOutput == 0 &&
                         outProfile->mFlags & AUDIO_OUTPUT_FLAG_PRIMARY) {
                     mPrimaryOutput = output;
+                    invalidateRouting();
                 }
                 addOutput(output, outputDesc);
                 setOutputDevice(output,
@@ -2934,6 +2960,7 @@ AudioPolicyManager::AudioPolicyManager(AudioPolicyClientInterface *clientInterfa
         if (mAvailableOutputDevices[i]->mId == 0) {
             ALOGW("Input device %08x unreachable", mAvailableOutputDevices[i]->mDeviceType);
             mAvailableOutputDevices.remove(mAvailableOutputDevices[i]);
+            invalidateRouting();
             continue;
         }
         i++;
@@ -2942,6 +2969,7 @@ AudioPolicyManager::AudioPolicyManager(AudioPolicyClientInterface *clientInterfa
         if (mAvailableInputDevices[i]->mId == 0) {
             ALOGW("Input device %08x unreachable", mAvailableInputDevices[i]->mDeviceType);
             mAvailableInputDevices.remove(mAvailableInputDevices[i]);
+            invalidateRouting();
             continue;
         }
         i++;
@@ -3105,6 +3133,7 @@ bool AudioPolicyManager::threadLoop()
                 audio_module_handle_t moduleHandle = outputDesc->mModule->mHandle;
 
                 mOutputs.removeItem(mPrimaryOutput);
+                invalidateRouting();
 
                 sp<AudioOutputDescriptor> outputDesc = new AudioOutputDescriptor(NULL);
                 outputDesc->mDevice = AUDIO_DEVICE_OUT_SPEAKER;
@@ -3167,6 +3196,7 @@ void AudioPolicyManager::addOutput(audio_io_handle_t output, sp<AudioOutputDescr
     outputDesc->mIoHandle = output;
     outputDesc->mId = nextUniqueId();
     mOutputs.add(output, outputDesc);
+    invalidateRouting();
     nextAudioPortGeneration();
 }
 
@@ -3400,6 +3430,7 @@ status_t AudioPolicyManager::checkOutputsForDevice(const sp<DeviceDescriptor> de
                                     mPrimaryOutput, output);
                             mpClientInterface->closeOutput(output);
                             mOutputs.removeItem(output);
+                            invalidateRouting();
                             nextAudioPortGeneration();
                             output = AUDIO_IO_HANDLE_NONE;
                         }
@@ -3701,6 +3732,7 @@ void AudioPolicyManager::closeOutput(audio_io_handle_t output)
 
             mpClientInterface->closeOutput(duplicatedOutput);
             mOutputs.removeItem(duplicatedOutput);
+            invalidateRouting();
         }
     }
 
@@ -3726,6 +3758,7 @@ void AudioPolicyManager::closeOutput(audio_io_handle_t output)
     }
 #endif //BGM_ENABLED
     mOutputs.removeItem(output);
+    invalidateRouting();
     mPreviousOutputs = mOutputs;
 }
 
@@ -3754,8 +3787,24 @@ void AudioPolicyManager::closeInput(audio_io_handle_t input)
 }
 
 SortedVector<audio_io_handle_t> AudioPolicyManager::getOutputsForDevice(audio_devices_t device,
-                        DefaultKeyedVector<audio_io_handle_t, sp<AudioOutputDescriptor> > openOutputs)
-{
+                const DefaultKeyedVector<audio_io_handle_t, sp<AudioOutputDescriptor> >& openOutputs)
+{
+    // only the current outputs are memoized, mPreviousOutputs is a snapshot used once
+    const bool memoize = &openOutputs == &mOutputs;
+    if (memoize) {
+        if (mMemoOutputsForDeviceGeneration != mRoutingGeneration) {
+            mMemoOutputsForDevice.clear();
+            mMemoOutputsForDeviceGeneration = mRoutingGeneration;
+        } else {
+            ssize_t index = mMemoOutputsForDevice.indexOfKey(device);
+            if (index >= 0) {
+                mRoutingCacheHits++;
+                return mMemoOutputsForDevice.valueAt(index);
+            }
+        }
+        mRoutingCacheMisses++;
+    }
+
     SortedVector<audio_io_handle_t> outputs;
 
     ALOGVV("getOutputsForDevice() device %04x", device);
@@ -3767,6 +3816,9 @@ SortedVector<audio_io_handle_t> AudioPolicyManager::getOutputsForDevice(audio_de
             outputs.add(openOutputs.keyAt(i));
         }
     }
+    if (memoize) {
+        mMemoOutputsForDevice.add(device, outputs);
+    }
     return outputs;
 }
 
@@ -3864,7 +3916,10 @@ void AudioPolicyManager::checkA2dpSuspend()
 {
     audio_io_handle_t a2dpOutput = getA2dpOutput();
     if (a2dpOutput == 0) {
-        mA2dpSuspended = false;
+        if (mA2dpSuspended) {
+            mA2dpSuspended = false;
+            invalidateRouting();
+        }
         return;
     }
 
@@ -3891,6 +3946,7 @@ void AudioPolicyManager::checkA2dpSuspend()
 
             mpClientInterface->restoreOutput(a2dpOutput);
             mA2dpSuspended = false;
+            invalidateRouting();
         }
     } else {
         if ((isScoConnected &&
@@ -3901,6 +3957,7 @@ void AudioPolicyManager::checkA2dpSuspend()
 
             mpClientInterface->suspendOutput(a2dpOutput);
             mA2dpSuspended = true;
+            invalidateRouting();
         }
     }
 }
@@ -4139,13 +4196,42 @@ void AudioPolicyManager::handleNotificationRoutingForStream(audio_stream_type_t
 audio_devices_t AudioPolicyManager::getDeviceForStrategy(routing_strategy strategy,
                                                              bool fromCache)
 {
-    uint32_t device = AUDIO_DEVICE_NONE;
-
     if (fromCache) {
         ALOGVV("getDeviceForStrategy() from cache strategy %d, device %x",
               strategy, mDeviceForStrategy[strategy]);
         return mDeviceForStrategy[strategy];
     }
+    if (!isRoutingMemoizable(strategy)) {
+        return getDeviceForStrategyInt(strategy);
+    }
+    if (mMemoDeviceForStrategyGeneration[strategy] == mRoutingGeneration) {
+        mRoutingCacheHits++;
+        return mMemoDeviceForStrategy[strategy];
+    }
+    mRoutingCacheMisses++;
+    audio_devices_t device = getDeviceForStrategyInt(strategy);
+    mMemoDeviceForStrategy[strategy] = device;
+    mMemoDeviceForStrategyGeneration[strategy] = mRoutingGeneration;
+    return device;
+}
+
+/*static*/
+bool AudioPolicyManager::isRoutingMemoizable(routing_strategy strategy)
+{
+    switch (strategy) {
+    // these depend on recent stream activity, which does not invalidate the memo
+    case STRATEGY_SONIFICATION_RESPECTFUL:
+    case STRATEGY_BACKGROUND_MUSIC:
+        return false;
+    default:
+        return strategy < NUM_STRATEGIES;
+    }
+}
+
+audio_devices_t AudioPolicyManager::getDeviceForStrategyInt(routing_strategy strategy)
+{
+    uint32_t device = AUDIO_DEVICE_NONE;
+
     audio_devices_t availableOutputDeviceTypes = mAvailableOutputDevices.types();
     switch (strategy) {
 
@@ -7494,23 +7580,37 @@ void AudioPolicyManager::loadGlobalConfig(cnode *root, const sp<HwModule>& modul
 status_t AudioPolicyManager::loadAudioPolicyConfig(const char *path)
 {
     cnode *root;
-    char *data;
+    char *data = NULL;
+    struct stat st;
 
-    data = (char *)load_file(path, NULL);
-    if (data == NULL) {
+    if (stat(path, &st) != 0) {
         return -ENODEV;
     }
-    root = config_node("", "");
-    config_load(root, data);
+    // use the form compiled at build time if it was installed with the file, rather than
+    // reading and parsing the text
+    AudioPolicyConfigCache cache;
+    const String8 compiledPath = String8(path) + AUDIO_POLICY_COMPILED_CONFIG_SUFFIX;
+    root = cache.load(compiledPath.string(), st.st_size);
+    const bool compiled = root != NULL;
+    if (!compiled) {
+        data = (char *)load_file(path, NULL);
+        if (data == NULL) {
+            return -ENODEV;
+        }
+        root = config_node("", "");
+        config_load(root, data);
+    }
 
     loadHwModules(root);
     // legacy audio_policy.conf files have one global_configuration section
     loadGlobalConfig(root, getModuleFromName(AUDIO_HARDWARE_MODULE_ID_PRIMARY));
-    config_free(root);
-    free(root);
-    free(data);
+    if (!compiled) {
+        config_free(root);
+        free(root);
+        free(data);
+    }
 
-    ALOGI("loadAudioPolicyConfig() loaded %s\n", path);
+    ALOGI("loadAudioPolicyConfig() loaded %s%s\n", path, compiled ? " (compiled)" : "");
 
     return NO_ERROR;
 }
@@ -563,6 +563,13 @@ protected:
         //  before updateDevicesAndOutputs() is called.
         virtual audio_devices_t getDeviceForStrategy(routing_strategy strategy,
                                                      bool fromCache);
+        // getDeviceForStrategy() with fromCache false memoizes its result until the next
+        // invalidateRouting(), which must follow any change of the state it depends on:
+        // available devices, phone state, forced use, open outputs, A2DP suspend.
+        // Strategies that also depend on stream activity are not memoized.
+        void invalidateRouting() { mRoutingGeneration++; }
+        static bool isRoutingMemoizable(routing_strategy strategy);
+        audio_devices_t getDeviceForStrategyInt(routing_strategy strategy);
 
         // change the route of the specified output. Returns the number of ms we have slept to
         // allow new routing to take effect in certain cases.
@@ -700,8 +707,9 @@ protected:
         // extract one device relevant for volume control from multiple device selection
         static audio_devices_t getDeviceForVolume(audio_devices_t device);
 
+        // memoized like getDeviceForStrategy() when openOutputs is mOutputs
         SortedVector<audio_io_handle_t> getOutputsForDevice(audio_devices_t device,
-                        DefaultKeyedVector<audio_io_handle_t, sp<AudioOutputDescriptor> > openOutputs);
+                const DefaultKeyedVector<audio_io_handle_t, sp<AudioOutputDescriptor> >& openOutputs);
         bool vectorsEqual(SortedVector<audio_io_handle_t>& outputs1,
                                            SortedVector<audio_io_handle_t>& outputs2);
 
@@ -782,6 +790,14 @@ protected:
         StreamDescriptor mStreams[AUDIO_STREAM_CNT];           // stream descriptors for volume control
         bool    mLimitRingtoneVolume;                                       // limit ringtone volume to music volume if headset connected
         audio_devices_t mDeviceForStrategy[NUM_STRATEGIES];
+        // routing memo, see invalidateRouting()
+        uint32_t mRoutingGeneration;
+        audio_devices_t mMemoDeviceForStrategy[NUM_STRATEGIES];
+        uint32_t mMemoDeviceForStrategyGeneration[NUM_STRATEGIES];
+        DefaultKeyedVector<audio_devices_t, SortedVector<audio_io_handle_t> > mMemoOutputsForDevice;
+        uint32_t mMemoOutputsForDeviceGeneration;
+        uint32_t mRoutingCacheHits;
+        uint32_t mRoutingCacheMisses;
         float   mLastVoiceVolume;                                           // last voice volume value sent to audio HAL
 
         // Maximum CPU load allocated to audio effects in 0.1 MIPS (ARMv5TE, 0 WS memory) units
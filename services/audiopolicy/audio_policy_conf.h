@@ -27,6 +27,9 @@
 
 #define AUDIO_POLICY_CONFIG_FILE "/system/etc/audio_policy.conf"
 #define AUDIO_POLICY_VENDOR_CONFIG_FILE "/vendor/etc/audio_policy.conf"
+// compiled form of a configuration file (see AudioPolicyConfigCache), installed next to the file
+// with this suffix when BOARD_AUDIO_POLICY_CONF is set
+#define AUDIO_POLICY_COMPILED_CONFIG_SUFFIX ".bin"
 
 // global configuration
 #define GLOBAL_CONFIG_TAG "global_configuration"
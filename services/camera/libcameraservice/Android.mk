@@ -65,7 +65,8 @@ LOCAL_SHARED_LIBRARIES:= \
     libhardware \
     libsync \
     libcamera_metadata \
-    libjpeg
+    libjpeg \
+    libcpustats_registry
 
 LOCAL_C_INCLUDES += \
     system/media/camera/include \
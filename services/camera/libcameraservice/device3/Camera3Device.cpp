@@ -42,6 +42,7 @@
 #include <utils/Log.h>
 #include <utils/Trace.h>
 #include <utils/Timers.h>
+#include <cpustats/ThreadCpuRegistry.h>
 
 #include "utils/CameraTraces.h"
 #include "device3/Camera3Device.h"
@@ -2515,6 +2516,11 @@ void Camera3Device::RequestThread::requestExit() {
     mRequestSignal.signal();
 }
 
+status_t Camera3Device::RequestThread::readyToRun() {
+    ThreadCpuRegistry::registerThread("camera");
+    return Thread::readyToRun();
+}
+
 bool Camera3Device::RequestThread::threadLoop() {
 
     status_t res;
@@ -429,6 +429,7 @@ class Camera3Device :
 
       protected:
 
+        virtual status_t readyToRun();
         virtual bool threadLoop();
 
       private:
@@ -54,7 +54,7 @@ void MediaLogService::unregisterWriter(const sp<IMemory>& shared)
     }
 }
 
-status_t MediaLogService::dump(int fd, const Vector<String16>& args __unused)
+status_t MediaLogService::dump(int fd, const Vector<String16>& args)
 {
     // FIXME merge with similar but not identical code at services/audioflinger/ServiceUtilities.cpp
     static const String16 sDump("android.permission.DUMP");
@@ -66,6 +66,18 @@ status_t MediaLogService::dump(int fd, const Vector<String16>& args __unused)
         return NO_ERROR;
     }
 
+    // --trace: binary events only, in the input format of the host decoder tools/nblog_trace
+    // --stats: aggregated view of the binary events after the log
+    bool trace = false;
+    bool stats = false;
+    for (size_t i = 0; i < args.size(); i++) {
+        if (args[i] == String16("--trace")) {
+            trace = true;
+        } else if (args[i] == String16("--stats")) {
+            stats = true;
+        }
+    }
+
     Vector<NamedReader> namedReaders;
     {
         Mutex::Autolock _l(mLock);
@@ -73,12 +85,25 @@ status_t MediaLogService::dump(int fd, const Vector<String16>& args __unused)
     }
     for (size_t i = 0; i < namedReaders.size(); i++) {
         const NamedReader& namedReader = namedReaders[i];
+        if (trace) {
+            if (fd >= 0) {
+                dprintf(fd, "writer\t%s\n", namedReader.name());
+                namedReader.reader()->dump(fd, 0 /*indent*/, true /*trace*/);
+            }
+            continue;
+        }
         if (fd >= 0) {
             dprintf(fd, "\n%s:\n", namedReader.name());
         } else {
             ALOGI("%s:", namedReader.name());
         }
         namedReader.reader()->dump(fd, 0 /*indent*/);
+        if (stats) {
+            if (fd >= 0) {
+                dprintf(fd, "  binary event statistics:\n");
+            }
+            namedReader.reader()->dumpStats(fd, 4 /*indent*/);
+        }
     }
     return NO_ERROR;
 }
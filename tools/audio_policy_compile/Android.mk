@@ -0,0 +1,51 @@
+# Copyright 2015 The Android Open Source Project
+#
+# Android.mk for audio_policy_compile
+#
+
+
+LOCAL_PATH:= $(call my-dir)
+include $(CLEAR_VARS)
+
+LOCAL_SRC_FILES := \
+	audio_policy_compile.cpp \
+	../../services/audiopolicy/AudioPolicyConfigCache.cpp
+
+LOCAL_C_INCLUDES := \
+	$(LOCAL_PATH)/../../services/audiopolicy
+
+LOCAL_STATIC_LIBRARIES := \
+	libcutils \
+	liblog
+
+LOCAL_MODULE := audio_policy_compile
+
+include $(BUILD_HOST_EXECUTABLE)
+
+# Compiled form of the board's audio_policy.conf, installed next to it. The board sets
+# BOARD_AUDIO_POLICY_CONF to the source file it copies to the device, optionally
+# BOARD_AUDIO_POLICY_CONF_VENDOR := true if it copies it to /vendor/etc rather than /system/etc,
+# and adds audio_policy.conf.bin to PRODUCT_PACKAGES.
+ifneq ($(BOARD_AUDIO_POLICY_CONF),)
+
+include $(CLEAR_VARS)
+
+LOCAL_MODULE := audio_policy.conf.bin
+LOCAL_MODULE_CLASS := ETC
+ifeq ($(BOARD_AUDIO_POLICY_CONF_VENDOR),true)
+LOCAL_MODULE_PATH := $(TARGET_OUT_VENDOR)/etc
+else
+LOCAL_MODULE_PATH := $(TARGET_OUT_ETC)
+endif
+
+include $(BUILD_SYSTEM)/base_rules.mk
+
+AUDIO_POLICY_COMPILE := $(HOST_OUT_EXECUTABLES)/audio_policy_compile$(HOST_EXECUTABLE_SUFFIX)
+
+$(LOCAL_BUILT_MODULE): PRIVATE_TOOL := $(AUDIO_POLICY_COMPILE)
+$(LOCAL_BUILT_MODULE): $(BOARD_AUDIO_POLICY_CONF) $(AUDIO_POLICY_COMPILE)
+	@echo "Compile audio policy: $@"
+	@mkdir -p $(dir $@)
+	$(hide) $(PRIVATE_TOOL) $< $@
+
+endif
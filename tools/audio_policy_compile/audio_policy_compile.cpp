@@ -0,0 +1,56 @@
+/*
+ * Copyright (C) 2015 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+// Compiles an audio_policy.conf file into the binary form loaded by AudioPolicyManager, so that
+// the audio server does not parse the text configuration when it starts.
+// The output must be installed next to the source with the ".bin" suffix, for example
+// /vendor/etc/audio_policy.conf.bin, and be regenerated whenever the source changes. This is
+// done by the audio_policy.conf.bin module when the board sets BOARD_AUDIO_POLICY_CONF.
+//
+// usage: audio_policy_compile audio_policy.conf audio_policy.conf.bin
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <cutils/config_utils.h>
+#include <cutils/misc.h>
+#include "AudioPolicyConfigCache.h"
+
+using namespace android;
+
+int main(int argc, char **argv)
+{
+    if (argc != 3) {
+        fprintf(stderr, "usage: %s audio_policy.conf output.bin\n", argv[0]);
+        return EXIT_FAILURE;
+    }
+    unsigned size;
+    char *data = (char *) load_file(argv[1], &size);
+    if (data == NULL) {
+        fprintf(stderr, "%s: cannot read %s\n", argv[0], argv[1]);
+        return EXIT_FAILURE;
+    }
+    cnode *root = config_node("", "");
+    config_load(root, data);
+    status_t status = AudioPolicyConfigCache::compile(argv[2], root, size);
+    config_free(root);
+    free(root);
+    free(data);
+    if (status != NO_ERROR) {
+        fprintf(stderr, "%s: cannot write %s: %d\n", argv[0], argv[2], status);
+        return EXIT_FAILURE;
+    }
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,15 @@
+# Copyright 2015 The Android Open Source Project
+#
+# Android.mk for nblog_trace
+#
+
+
+LOCAL_PATH:= $(call my-dir)
+include $(CLEAR_VARS)
+
+LOCAL_SRC_FILES := \
+	nblog_trace.cpp
+
+LOCAL_MODULE := nblog_trace
+
+include $(BUILD_HOST_EXECUTABLE)
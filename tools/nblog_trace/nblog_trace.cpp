@@ -0,0 +1,121 @@
+/*
+ * Copyright (C) 2015 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+// Converts the binary NBLog events printed by "adb shell dumpsys media.log --trace" into the
+// Chrome trace event JSON format, which can be loaded in chrome://tracing or Perfetto.
+// Each NBLog writer becomes a thread of a single process.
+//
+// usage: nblog_trace [input] > trace.json
+
+#include <inttypes.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// split line at tabs in place, return number of fields
+static int split(char *line, char **fields, int maxFields) {
+    int count = 0;
+    char *p = line;
+    while (count < maxFields) {
+        fields[count++] = p;
+        p = strchr(p, '\t');
+        if (p == NULL) {
+            break;
+        }
+        *p++ = '\0';
+    }
+    return count;
+}
+
+static void printString(FILE *out, const char *s) {
+    fputc('"', out);
+    for (; *s != '\0'; s++) {
+        unsigned char c = *s;
+        if (c == '"' || c == '\\') {
+            fprintf(out, "\\%c", c);
+        } else if (c < 0x20) {
+            fprintf(out, "\\u%04x", c);
+        } else {
+            fputc(c, out);
+        }
+    }
+    fputc('"', out);
+}
+
+int main(int argc, char **argv) {
+    FILE *in = stdin;
+    if (argc > 2 || (argc == 2 && !strcmp(argv[1], "-h"))) {
+        fprintf(stderr, "usage: %s [input] > trace.json\n"
+                "input is the output of \"dumpsys media.log --trace\", default stdin\n", argv[0]);
+        return EXIT_FAILURE;
+    }
+    if (argc == 2 && (in = fopen(argv[1], "r")) == NULL) {
+        perror(argv[1]);
+        return EXIT_FAILURE;
+    }
+
+    FILE *out = stdout;
+    char line[1024];
+    int tid = 0;
+    bool first = true;
+    unsigned lineNumber = 0;
+    fprintf(out, "{\"traceEvents\":[\n");
+    while (fgets(line, sizeof(line), in) != NULL) {
+        lineNumber++;
+        size_t length = strlen(line);
+        while (length > 0 && (line[length - 1] == '\n' || line[length - 1] == '\r')) {
+            line[--length] = '\0';
+        }
+        if (length == 0) {
+            continue;
+        }
+        char *fields[5];
+        int count = split(line, fields, 5);
+        if (count == 2 && !strcmp(fields[0], "writer")) {
+            // thread name metadata event for the following events
+            tid++;
+            fprintf(out, "%s{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":%d,"
+                    "\"args\":{\"name\":", first ? "" : ",\n", tid);
+            printString(out, fields[1]);
+            fprintf(out, "}}");
+            first = false;
+            continue;
+        }
+        char *end;
+        long long ns = strtoll(fields[0], &end, 10);
+        if (count != 5 || *end != '\0' || strlen(fields[1]) != 1) {
+            fprintf(stderr, "line %u: ignored\n", lineNumber);
+            continue;
+        }
+        // events are named after their format so that occurrences are grouped together
+        fprintf(out, "%s{\"name\":", first ? "" : ",\n");
+        printString(out, fields[3]);
+        fprintf(out, ",\"ph\":\"%c\",\"ts\":%lld.%03lld,\"pid\":1,\"tid\":%d",
+                fields[1][0], ns / 1000, ns % 1000, tid);
+        if (fields[1][0] == 'i') {
+            fprintf(out, ",\"s\":\"t\"");
+        }
+        fprintf(out, ",\"args\":{\"id\":%s,\"text\":", fields[2]);
+        printString(out, fields[4]);
+        fprintf(out, "}}");
+        first = false;
+    }
+    fprintf(out, "\n]}\n");
+    if (in != stdin) {
+        fclose(in);
+    }
+    return EXIT_SUCCESS;
+}